@@ -0,0 +1,14 @@
+// `g2 = iv - 1` stores an affine value of `iv` to memory, `iv` is used
+// outside its own update cycle and must stay: exits with 60 (-40 + 100)
+int g2;
+
+int main(void) {
+    int it2 = 0;
+    int iv = 0;
+    do {
+        it2 = it2 + 1;
+        g2 = iv - 1;
+        iv = iv - 1;
+    } while (it2 < 40);
+    return g2 + 100;
+}
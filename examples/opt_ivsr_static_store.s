@@ -0,0 +1,46 @@
+    .globl main
+    .text
+main:
+    pushq %rbp
+    movq %rsp, %rbp
+    subq $32, %rsp
+    movl $0, -4(%rbp)
+    movl $0, -8(%rbp)
+  start_do_while.0:
+    movl -4(%rbp), %r10d
+    movl %r10d, -12(%rbp)
+    addl $1, -12(%rbp)
+    movl -12(%rbp), %r10d
+    movl %r10d, -4(%rbp)
+    movl -8(%rbp), %r10d
+    movl %r10d, -16(%rbp)
+    subl $1, -16(%rbp)
+    movl -16(%rbp), %r10d
+    movl %r10d, g2(%rip)
+    movl -8(%rbp), %r10d
+    movl %r10d, -20(%rbp)
+    subl $1, -20(%rbp)
+    movl -20(%rbp), %r10d
+    movl %r10d, -8(%rbp)
+    cmpl $40, -4(%rbp)
+    jl start_do_while.0
+    movl g2(%rip), %r10d
+    movl %r10d, -24(%rbp)
+    addl $100, -24(%rbp)
+    movl -24(%rbp), %eax
+    movq %rbp, %rsp
+    popq %rbp
+    ret
+
+    movl $0, %eax
+    movq %rbp, %rsp
+    popq %rbp
+    ret
+
+    .globl g2
+    .bss
+    .align 4
+g2:
+    .zero 4
+
+    .section .note.GNU-stack, "",@progbits
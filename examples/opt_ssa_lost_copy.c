@@ -0,0 +1,14 @@
+// Once `y` is propagated, the copy back into `x` belongs on the back edge of
+// the loop only: the exit still reads the old `x`. The jump ending the loop
+// is redirected to a block of its own that holds the copy. Exits with 45
+int lost_copy(int n) {
+  int x = 0;
+  int y;
+  do {
+    y = x;
+    x = x + 1;
+  } while (x < n);
+  return y * 10 + x;
+}
+
+int main(void) { return lost_copy(5); }
@@ -0,0 +1,59 @@
+    .globl lost_copy
+    .text
+lost_copy:
+    pushq %rbp
+    movq %rsp, %rbp
+    subq $32, %rsp
+    movl %edi, -4(%rbp)
+    movl $0, -8(%rbp)
+  start_do_while.0:
+    movl -8(%rbp), %r10d
+    movl %r10d, -12(%rbp)
+    addl $1, -12(%rbp)
+    movl -4(%rbp), %r10d
+    cmpl %r10d, -12(%rbp)
+    jl split.lost_copy.5
+    movl -8(%rbp), %r10d
+    movl %r10d, -16(%rbp)
+    movl -16(%rbp), %r11d
+    imull $10, %r11d
+    movl %r11d, -16(%rbp)
+    movl -16(%rbp), %r10d
+    movl %r10d, -20(%rbp)
+    movl -12(%rbp), %r10d
+    addl %r10d, -20(%rbp)
+    movl -20(%rbp), %eax
+    movq %rbp, %rsp
+    popq %rbp
+    ret
+
+    movl $0, %eax
+    movq %rbp, %rsp
+    popq %rbp
+    ret
+
+  split.lost_copy.5:
+    movl -12(%rbp), %r10d
+    movl %r10d, -8(%rbp)
+    jmp start_do_while.0
+    .globl main
+    .text
+main:
+    pushq %rbp
+    movq %rsp, %rbp
+    subq $16, %rsp
+    movl $5, %edi
+    call lost_copy
+    movl %eax, -4(%rbp)
+    movl -4(%rbp), %eax
+    movq %rbp, %rsp
+    popq %rbp
+    ret
+
+    movl $0, %eax
+    movq %rbp, %rsp
+    popq %rbp
+    ret
+
+
+    .section .note.GNU-stack, "",@progbits
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <bitset>
+#include <memory>
+#include <unordered_map>
+
+#include "nanocc/Analysis/Dominators.hpp"
+#include "nanocc/Analysis/Liveness.hpp"
+#include "nanocc/Analysis/LoopInfo.hpp"
+#include "nanocc/IR/BasicBlock.hpp"
+#include "nanocc/IR/IR.hpp"
+
+enum class AnalysisKind {
+  CFG,
+  DominatorTree,
+  LoopInfo,
+  Liveness,
+  NumAnalysisKinds
+};
+
+/// @brief The analyses a pass left valid on the function it ran on.
+class PreservedAnalyses {
+public:
+  static constexpr size_t NumKinds =
+      static_cast<size_t>(AnalysisKind::NumAnalysisKinds);
+
+  /// @brief the function wasn't touched
+  static PreservedAnalyses all() {
+    PreservedAnalyses PA;
+    PA.preserved.set();
+    return PA;
+  }
+  static PreservedAnalyses none() { return PreservedAnalyses(); }
+  /// @brief Instructions were rewritten in place but no block was split,
+  /// merged or re-linked: the CFG and what depends only on it survive.
+  /// Blocks are iterator ranges, so this needs every block's first
+  /// instruction and every branch/label to be left alone.
+  static PreservedAnalyses cfgOnly() {
+    return none()
+        .preserve(AnalysisKind::CFG)
+        .preserve(AnalysisKind::DominatorTree)
+        .preserve(AnalysisKind::LoopInfo);
+  }
+
+  PreservedAnalyses& preserve(AnalysisKind kind) {
+    preserved.set(static_cast<size_t>(kind));
+    return *this;
+  }
+  bool isPreserved(AnalysisKind kind) const {
+    return preserved.test(static_cast<size_t>(kind));
+  }
+  bool areAllPreserved() const { return preserved.all(); }
+
+private:
+  std::bitset<NumKinds> preserved;
+};
+
+/// @brief Lazily computed, cached per-function analyses. Passes ask for what
+/// they need, the pass manager drops what a pass didn't preserve, so an
+/// analysis is only recomputed after its function changed. Everything here
+/// points into the CFG, so losing the CFG loses every other analysis, and
+/// the loops go with the dominator tree.
+class AnalysisManager {
+public:
+  const ControlFlowGraph& getCFG(IRFunctionNode& IRFunc);
+  const DominatorTree& getDomTree(IRFunctionNode& IRFunc);
+  const LoopInfo& getLoopInfo(IRFunctionNode& IRFunc);
+  const Liveness& getLiveness(IRFunctionNode& IRFunc);
+
+  void invalidate(IRFunctionNode& IRFunc, const PreservedAnalyses& PA);
+
+private:
+  struct FunctionAnalyses {
+    std::unique_ptr<ControlFlowGraph> CFG;
+    std::unique_ptr<DominatorTree> DT;
+    std::unique_ptr<LoopInfo> LI;
+    std::unique_ptr<Liveness> Live;
+  };
+
+  std::unordered_map<const IRFunctionNode*, FunctionAnalyses> cache;
+};
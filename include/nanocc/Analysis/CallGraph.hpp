@@ -0,0 +1,56 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "nanocc/IR/IR.hpp"
+
+/// @brief A function defined in the program and who it calls and is called
+/// by, calls to functions defined elsewhere aside.
+class CallGraphNode {
+public:
+  IRFunctionNode* function;
+  std::vector<CallGraphNode*> callees; // without duplicates
+  std::vector<CallGraphNode*> callers; // without duplicates
+  bool callsItself = false;
+  size_t sccId = 0; // index into `CallGraph::getSCCs()`
+};
+
+/// @brief The calls between the functions of a program, built from its
+/// `IRFunctionCallNode`s, and its strongly connected components (Tarjan):
+/// functions calling each other, directly or through others, share one.
+/// Taken before any function is changed: inlining only adds calls to
+/// functions the caller reached already and other passes only remove calls,
+/// so a callee's component still never comes after its caller's.
+class CallGraph {
+public:
+  explicit CallGraph(IRProgramNode& IRProgram);
+
+  /// @return nullptr for functions not defined in the program
+  CallGraphNode* getNode(const std::string& funcName) const;
+  const std::vector<std::unique_ptr<CallGraphNode>>& getNodes() const {
+    return nodes;
+  }
+  /// @return the components bottom-up, every callee's before its callers'
+  const std::vector<std::vector<CallGraphNode*>>& getSCCs() const {
+    return sccs;
+  }
+  /// @return 0 for a component calling no other, one more than the highest
+  /// component it calls otherwise; components of one height never call each
+  /// other
+  unsigned getHeight(size_t sccId) const { return heights[sccId]; }
+  /// @return true if `Node` may call itself, directly or not
+  bool isRecursive(const CallGraphNode* Node) const {
+    return Node->callsItself || sccs[Node->sccId].size() > 1;
+  }
+
+  void print() const;
+
+private:
+  std::vector<std::unique_ptr<CallGraphNode>> nodes; // in program order
+  std::unordered_map<std::string, CallGraphNode*> byName;
+  std::vector<std::vector<CallGraphNode*>> sccs;
+  std::vector<unsigned> heights; // by sccId
+};
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "nanocc/IR/BasicBlock.hpp"
+#include "nanocc/Utils/BitVector.hpp"
+
+/*
+Iterative dataflow over a `ControlFlowGraph`. A problem supplies the lattice
+and the block transfer function:
+    struct Problem {
+      using Domain = ...;
+      static constexpr DataflowDirection Direction = ...;
+      Domain getBoundary() const;  // value entering the entry (forward) or
+                                   // leaving the exits (backward)
+      Domain getTop() const;       // identity of meet
+      void meet(Domain& Acc, const Domain& V) const;
+      void transfer(const BasicBlock* BB, Domain& V) const;
+    };
+Forward problems flow from a block's start to its end, backward ones the other
+way. Blocks are visited in reverse postorder of the flow direction (RPO for
+forward, postorder for backward) and the sweeps repeat over the blocks whose
+neighbours changed, so an acyclic region settles in one sweep and a loop costs
+one more sweep per level of nesting.
+*/
+
+enum class DataflowDirection { Forward, Backward };
+
+/// @brief Block transfer of a gen/kill problem, `out = gen U (in - kill)`.
+/// `set` and `reset` mirror `BitVector`, applying them in order to a
+/// `GenKillTransfer` records what applying them to a set would do, so a block
+/// is summarized with the same code that walks it instruction by instruction.
+struct GenKillTransfer {
+  BitVector gen;
+  BitVector kill;
+
+  GenKillTransfer() = default;
+  explicit GenKillTransfer(size_t numBits) : gen(numBits), kill(numBits) {}
+
+  void set(size_t idx) { gen.set(idx); }
+  void reset(size_t idx) {
+    gen.reset(idx);
+    kill.set(idx);
+  }
+  void reset(const BitVector& Mask) {
+    gen.reset(Mask);
+    kill |= Mask;
+  }
+  void apply(BitVector& V) const {
+    V.reset(kill);
+    V |= gen;
+  }
+};
+
+/// @brief A gen/kill problem over `BitVector`s, union (may) or intersection
+/// (must) meet, one transfer per block indexed by blockId.
+template <DataflowDirection Dir, bool IsUnion> class BitVectorProblem {
+public:
+  using Domain = BitVector;
+  static constexpr DataflowDirection Direction = Dir;
+
+  BitVectorProblem(const ControlFlowGraph& CFG, size_t numBits)
+      : boundary(numBits), transfers(CFG.size(), GenKillTransfer(numBits)) {}
+
+  BitVector& getBoundary() { return boundary; }
+  const BitVector& getBoundary() const { return boundary; }
+  GenKillTransfer& getTransfer(const BasicBlock* BB) {
+    return transfers[BB->blockId];
+  }
+
+  BitVector getTop() const { return BitVector(boundary.size(), !IsUnion); }
+  void meet(BitVector& Acc, const BitVector& V) const {
+    if constexpr (IsUnion)
+      Acc |= V;
+    else
+      Acc &= V;
+  }
+  void transfer(const BasicBlock* BB, BitVector& V) const {
+    transfers[BB->blockId].apply(V);
+  }
+
+private:
+  BitVector boundary;
+  std::vector<GenKillTransfer> transfers;
+};
+
+template <DataflowDirection Dir>
+using UnionProblem = BitVectorProblem<Dir, true>;
+template <DataflowDirection Dir>
+using IntersectionProblem = BitVectorProblem<Dir, false>;
+
+/// @brief Solves `Problem` to its maximal fixed point. `getIn` is the value at
+/// the start of a block and `getOut` at its end whatever the direction.
+/// Blocks without predecessors (forward) or successors (backward) start from
+/// the boundary, so unreachable code gets the same facts as the entry instead
+/// of top.
+template <typename Problem> class DataflowSolver {
+public:
+  using Domain = typename Problem::Domain;
+  static constexpr bool IsForward =
+      Problem::Direction == DataflowDirection::Forward;
+
+  DataflowSolver(const ControlFlowGraph& CFG, const Problem& P)
+      : in(CFG.size(), P.getTop()), out(CFG.size(), P.getTop()) {
+    solve(CFG, P);
+  }
+
+  const Domain& getIn(const BasicBlock* BB) const { return in[BB->blockId]; }
+  const Domain& getOut(const BasicBlock* BB) const {
+    return out[BB->blockId];
+  }
+  /// @return blocks transferred until the fixed point, for tuning
+  size_t getNumVisits() const { return numVisits; }
+
+  /// @brief Moves the solution out, (in, out) by blockId.
+  std::vector<Domain> takeIn() { return std::move(in); }
+  std::vector<Domain> takeOut() { return std::move(out); }
+
+private:
+  std::vector<Domain> in, out; // by blockId
+  size_t numVisits = 0;
+
+  static const std::vector<BasicBlock*>& upstream(const BasicBlock* BB) {
+    return IsForward ? BB->predecessors : BB->successors;
+  }
+  static const std::vector<BasicBlock*>& downstream(const BasicBlock* BB) {
+    return IsForward ? BB->successors : BB->predecessors;
+  }
+
+  // RPO then the unreachable blocks in layout order, reversed for backward
+  // problems
+  static std::vector<BasicBlock*> getOrder(const ControlFlowGraph& CFG) {
+    std::vector<BasicBlock*> order = CFG.getReversePostOrder();
+    std::vector<bool> inOrder(CFG.size(), false);
+    for (auto* BB : order) {
+      inOrder[BB->blockId] = true;
+    }
+    for (auto& BB : CFG.blocks) {
+      if (!inOrder[BB->blockId])
+        order.push_back(BB.get());
+    }
+    if constexpr (!IsForward)
+      std::reverse(order.begin(), order.end());
+    return order;
+  }
+
+  void solve(const ControlFlowGraph& CFG, const Problem& P) {
+    if (CFG.empty())
+      return;
+    // meet side and transfer side of every block
+    auto& Entering = IsForward ? in : out;
+    auto& Leaving = IsForward ? out : in;
+    BasicBlock* Entry = CFG.getEntry();
+
+    std::vector<BasicBlock*> order = getOrder(CFG);
+    std::vector<bool> pending(CFG.size(), true);
+    size_t numPending = CFG.size();
+    while (numPending) {
+      for (auto* BB : order) {
+        if (!pending[BB->blockId])
+          continue;
+        pending[BB->blockId] = false;
+        numPending--;
+        numVisits++;
+
+        auto& Enter = Entering[BB->blockId];
+        bool isBoundary = upstream(BB).empty() || (IsForward && BB == Entry);
+        Enter = isBoundary ? P.getBoundary() : P.getTop();
+        for (auto* Up : upstream(BB)) {
+          P.meet(Enter, Leaving[Up->blockId]);
+        }
+        Domain Leave = Enter;
+        P.transfer(BB, Leave);
+        if (Leave == Leaving[BB->blockId])
+          continue;
+        Leaving[BB->blockId] = std::move(Leave);
+        for (auto* Down : downstream(BB)) {
+          if (!pending[Down->blockId]) {
+            pending[Down->blockId] = true;
+            numPending++;
+          }
+        }
+      }
+    }
+  }
+};
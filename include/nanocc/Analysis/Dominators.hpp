@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+
+#include "nanocc/IR/BasicBlock.hpp"
+
+/// @brief Dominator tree of a `ControlFlowGraph`, computed with the iterative
+/// algorithm of Cooper, Harvey and Kennedy, "A Simple, Fast Dominance
+/// Algorithm": idoms are refined in reverse postorder until they stop changing,
+/// two candidates are intersected by walking up the tree by postorder number.
+/// The tree is numbered with a DFS afterwards, so `dominates` is O(1).
+/// Blocks unreachable from the entry are not in the tree.
+class DominatorTree {
+public:
+  explicit DominatorTree(const ControlFlowGraph& CFG);
+
+  bool isReachable(const BasicBlock* BB) const {
+    return postNumber[BB->blockId] != Unreachable;
+  }
+  /// @return immediate dominator, nullptr for the entry and unreachable blocks
+  BasicBlock* getIDom(const BasicBlock* BB) const;
+  /// @return blocks immediately dominated by `BB`, in reverse postorder
+  const std::vector<BasicBlock*>& getChildren(const BasicBlock* BB) const {
+    return children[BB->blockId];
+  }
+  /// @brief Every block dominates itself and unreachable blocks (they are
+  /// never executed), an unreachable block dominates nothing else.
+  bool dominates(const BasicBlock* A, const BasicBlock* B) const;
+  bool properlyDominates(const BasicBlock* A, const BasicBlock* B) const {
+    return A != B && dominates(A, B);
+  }
+  /// @return reachable blocks, entry first, every block before its successors
+  /// except along back edges
+  const std::vector<BasicBlock*>& getReversePostOrder() const { return rpo; }
+
+  void print() const;
+
+private:
+  static constexpr size_t Unreachable = static_cast<size_t>(-1);
+
+  BasicBlock* entry = nullptr;
+  std::vector<BasicBlock*> rpo;
+  std::vector<size_t> postNumber;     // by blockId
+  std::vector<BasicBlock*> idom;      // by blockId, entry is its own idom
+  std::vector<std::vector<BasicBlock*>> children; // by blockId
+  std::vector<size_t> dfsIn, dfsOut;  // by blockId, DFS over the tree
+
+  void computePostOrder(const ControlFlowGraph& CFG);
+  void computeIDoms();
+  void numberTree();
+};
+
+/// @brief DF(X): blocks where X's dominance ends, i.e. Y has a predecessor
+/// dominated by X but Y isn't strictly dominated by X. Computed with the
+/// "runner" walk from the same paper: from every predecessor of a join block
+/// up to the join block's idom.
+class DominanceFrontier {
+public:
+  DominanceFrontier(const ControlFlowGraph& CFG, const DominatorTree& DT);
+
+  const std::vector<BasicBlock*>& get(const BasicBlock* BB) const {
+    return frontier[BB->blockId];
+  }
+
+  void print() const;
+
+private:
+  std::vector<std::vector<BasicBlock*>> frontier; // by blockId
+};
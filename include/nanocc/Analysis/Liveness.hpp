@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "nanocc/IR/BasicBlock.hpp"
+#include "nanocc/Utils/BitVector.hpp"
+
+/// @brief Block level liveness of the non-static variables of a function,
+/// solved backwards over the `ControlFlowGraph`:
+///     liveOut(B) = U liveIn(S) for S in succs(B)
+///     liveIn(B)  = uses(B) U (liveOut(B) - defs(B))
+/// `uses(B)` are the variables read before being written in B. Static
+/// variables may be read by any callee and are never considered dead.
+/// Not meant for SSA form, phis would be treated as plain instructions.
+class Liveness {
+public:
+  static constexpr size_t NoVar = static_cast<size_t>(-1);
+
+  Liveness(IRFunctionNode& IRFunc, const ControlFlowGraph& CFG);
+
+  size_t getNumVars() const { return varNames.size(); }
+  /// @return the index of `var` in the live sets, `NoVar` if it isn't tracked
+  size_t getVarIndex(const std::string& var) const;
+  size_t getVarIndex(const std::shared_ptr<IRValNode>& val) const;
+  const std::string& getVarName(size_t idx) const { return varNames[idx]; }
+
+  const BitVector& getLiveIn(const BasicBlock* BB) const {
+    return liveIn[BB->blockId];
+  }
+  const BitVector& getLiveOut(const BasicBlock* BB) const {
+    return liveOut[BB->blockId];
+  }
+  bool isLiveIn(const BasicBlock* BB, const std::string& var) const;
+  /// @brief Turns the variables live after `IRInstr` into those live before
+  /// it, for walking a block backwards from `getLiveOut`.
+  void stepBackward(IRInstructionNode* IRInstr, BitVector& Live) const;
+  bool isLiveOut(const BasicBlock* BB, const std::string& var) const;
+
+  void print() const;
+
+private:
+  std::unordered_map<std::string, size_t> varIndex;
+  std::vector<std::string> varNames;
+  std::vector<BitVector> liveIn;  // by blockId
+  std::vector<BitVector> liveOut; // by blockId
+
+  size_t lookupOrAdd(const IRValNode* val);
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "nanocc/Analysis/Dominators.hpp"
+#include "nanocc/IR/BasicBlock.hpp"
+
+/// @brief A natural loop: the header plus every block that reaches one of the
+/// latches (sources of back edges to the header) without going through the
+/// header. Back edges to the same header form a single loop.
+class Loop {
+public:
+  BasicBlock* header;
+  std::vector<BasicBlock*> latches;
+  std::vector<BasicBlock*> blocks; // sorted by blockId, header included
+  Loop* parent = nullptr;
+  std::vector<Loop*> subLoops;
+
+  /// @brief O(log n), `blocks` is sorted
+  bool contains(const BasicBlock* BB) const;
+  bool contains(const Loop* L) const;
+  /// @return 1 for outermost loops
+  unsigned getDepth() const;
+  /// @return the only block outside the loop that enters it, nullptr if there
+  /// are several or it has other successors too
+  BasicBlock* getPreheader() const;
+  /// @return blocks outside the loop reached from inside, without duplicates
+  std::vector<BasicBlock*> getExitBlocks() const;
+};
+
+class LoopInfo {
+public:
+  LoopInfo(const ControlFlowGraph& CFG, const DominatorTree& DT);
+
+  /// @return all loops, inner loops before the loops containing them
+  const std::vector<std::unique_ptr<Loop>>& getLoops() const { return loops; }
+  const std::vector<Loop*>& getTopLevelLoops() const { return topLevel; }
+  /// @return innermost loop containing `BB`, nullptr if it isn't in one
+  Loop* getLoopFor(const BasicBlock* BB) const {
+    return innermost[BB->blockId];
+  }
+  unsigned getLoopDepth(const BasicBlock* BB) const {
+    Loop* L = getLoopFor(BB);
+    return L ? L->getDepth() : 0;
+  }
+  bool empty() const { return loops.empty(); }
+
+  void print() const;
+
+private:
+  std::vector<std::unique_ptr<Loop>> loops;
+  std::vector<Loop*> topLevel;
+  std::vector<Loop*> innermost; // by blockId
+};
@@ -25,9 +25,12 @@ class AsmBinaryNode; // all bin ops except "/" and "%"
 class AsmCmpNode;
 class AsmIdivNode; // for "/" and "%"
 class AsmCdqNode;  // for sign extension before idiv
+class AsmShiftNode; // shifts by an immediate count
+class AsmMulHiNode; // one operand `imul`, for division by a constant
 class AsmJmpNode;
 class AsmJmpCCNode;
 class AsmSetCCNode;
+class AsmCMovNode; // for `IRSelectNode`
 class AsmLabelNode;
 class AsmAllocateStackNode;
 class AsmDeallocateStackNode;
@@ -248,6 +251,45 @@ public:
   void generateAsm(std::ostream& os) override;
 };
 
+class AsmShiftNode : public AsmInstructionNode {
+public:
+  std::string op; // "sar" (arithmetic), "shr" (logical) or "shl"
+  int count = 0;
+  std::shared_ptr<AsmOperandNode> dest;
+
+  AsmShiftNode() = default;
+  AsmShiftNode(std::string op, int count, std::shared_ptr<AsmOperandNode> dest)
+      : op(std::move(op)), count(count), dest(std::move(dest)) {}
+
+  static bool classof(const AsmInstructionNode* node) {
+    return dynamic_cast<const AsmShiftNode*>(node) != nullptr;
+  }
+  void
+  resolvePseudoRegisters(std::unordered_map<std::string, int>& pseudo_reg_map,
+                         int& nxt_offset) override;
+  void generateAsm(std::ostream& os) override;
+};
+
+/// @brief `EDX:EAX = EAX * factor`, signed; `EDX` holds the high half.
+class AsmMulHiNode : public AsmInstructionNode {
+public:
+  std::shared_ptr<AsmOperandNode> factor;
+
+  AsmMulHiNode() = default;
+  explicit AsmMulHiNode(std::shared_ptr<AsmOperandNode> factor)
+      : factor(std::move(factor)) {}
+
+  static bool classof(const AsmInstructionNode* node) {
+    return dynamic_cast<const AsmMulHiNode*>(node) != nullptr;
+  }
+  void
+  resolvePseudoRegisters(std::unordered_map<std::string, int>& pseudo_reg_map,
+                         int& nxt_offset) override;
+  void fixUpInstructions(
+      std::vector<std::unique_ptr<AsmInstructionNode>>& instructions) override;
+  void generateAsm(std::ostream& os) override;
+};
+
 class AsmJmpNode : public AsmInstructionNode {
 public:
   std::string label;
@@ -295,6 +337,32 @@ public:
   void generateAsm(std::ostream& os) override;
 };
 
+/// @brief `dest = src` if the flags satisfy `cond_code`, dest untouched
+/// otherwise
+class AsmCMovNode : public AsmInstructionNode {
+public:
+  std::string cond_code;
+  std::shared_ptr<AsmOperandNode> src;
+  std::shared_ptr<AsmOperandNode> dest;
+
+  AsmCMovNode() = default;
+  AsmCMovNode(std::string cond_code, std::shared_ptr<AsmOperandNode> src,
+              std::shared_ptr<AsmOperandNode> dest)
+      : cond_code(std::move(cond_code)), src(std::move(src)),
+        dest(std::move(dest)) {}
+
+  static bool classof(const AsmInstructionNode* node) {
+    return dynamic_cast<const AsmCMovNode*>(node) != nullptr;
+  }
+
+  void
+  resolvePseudoRegisters(std::unordered_map<std::string, int>& pseudo_reg_map,
+                         int& nxt_offset) override;
+  void fixUpInstructions(
+      std::vector<std::unique_ptr<AsmInstructionNode>>& instructions) override;
+  void generateAsm(std::ostream& os) override;
+};
+
 class AsmLabelNode : public AsmInstructionNode {
 public:
   std::string label;
@@ -355,10 +423,12 @@ public:
 class AsmCallNode : public AsmInstructionNode {
 public:
   std::string func_name;
+  // epilogue + `jmp func`, the callee returns straight to our caller
+  bool tail = false;
 
   AsmCallNode() = default;
-  explicit AsmCallNode(std::string func_name)
-      : func_name(std::move(func_name)) {}
+  explicit AsmCallNode(std::string func_name, bool tail = false)
+      : func_name(std::move(func_name)), tail(tail) {}
   void generateAsm(std::ostream& os) override;
 };
 
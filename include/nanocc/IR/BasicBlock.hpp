@@ -1,67 +1,80 @@
 #pragma once
 
-#include <deque>
 #include <list>
 #include <memory>
 #include <print>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 #include "nanocc/IR/IR.hpp"
 #include "nanocc/IR/IRDump.hpp"
+#include "nanocc/Utils/Utils.hpp"
 
+/// @brief A maximal straight-line run of instructions of an `IRFunctionNode`.
+/// Blocks don't own their instructions, they are [begin, end) views into
+/// `IRFunctionNode::IRInstructions`, so passes keep editing the linear list and
+/// rebuild the `ControlFlowGraph` afterwards.
 class BasicBlock {
 public:
-  size_t blockId;
-  std::deque<std::unique_ptr<IRInstructionNode>> IRInstructions;
-  using Iter = std::list<std::shared_ptr<BasicBlock>>::iterator;
+  using InstrIter = std::list<std::unique_ptr<IRInstructionNode>>::iterator;
 
-  static void printBasicBlocks(std::list<std::shared_ptr<BasicBlock>>& BBList) {
-    std::println("--------- Basic Blocks --------");
-    for (auto& BB : BBList) {
-      std::println("Basic Block ID: {}", BB->blockId);
-      for (auto& IRInstr : BB->IRInstructions) {
-        IRGen::instructionNodeIRDump(*IRInstr, 2);
-      }
-      std::println();
-    }
-    std::println("-------------------------------");
-  }
-
-  static std::list<std::shared_ptr<BasicBlock>>
-  getBasicBlocks(std::list<std::unique_ptr<IRInstructionNode>>& Instructions);
+  size_t blockId;
+  InstrIter first;
+  InstrIter last; // one past the last instruction of the block
+  std::vector<BasicBlock*> successors;
+  std::vector<BasicBlock*> predecessors;
 
-  static std::vector<BasicBlock::Iter>
-  getSuccessors(BasicBlock::Iter BBIter,
-                std::list<std::shared_ptr<BasicBlock>>& BBList);
+  InstrIter begin() const { return first; }
+  InstrIter end() const { return last; }
+  IRInstructionNode* front() const { return first->get(); }
+  IRInstructionNode* back() const { return std::prev(last)->get(); }
 
-  static std::vector<BasicBlock::Iter>
-  getPredecessor(BasicBlock::Iter BBIter,
-                 std::list<std::shared_ptr<BasicBlock>>& BBList);
+  /// @return the label that starts this block, nullptr if it has none
+  IRLabelNode* getLabel() const { return dyn_cast<IRLabelNode>(front()); }
 };
 
-class LabelBBMap {
-private:
-  std::unordered_map<std::string, BasicBlock::Iter> map;
-
+/// @brief Per-function CFG. Labels are resolved through `labelToBlock` which is
+/// indexed by `IRLabelNode::labelId`, so no state is shared between functions
+/// and successor queries don't hash strings.
+class ControlFlowGraph {
 public:
-  static LabelBBMap& obj() {
-    static LabelBBMap instance;
-    return instance;
+  /// @brief blocks in layout order, `blocks[i]->blockId == i`
+  std::vector<std::unique_ptr<BasicBlock>> blocks;
+  /// @brief label id => block starting with that label (nullptr if deleted)
+  std::vector<BasicBlock*> labelToBlock;
+
+  explicit ControlFlowGraph(IRFunctionNode& IRFunc);
+
+  size_t size() const { return blocks.size(); }
+  bool empty() const { return blocks.empty(); }
+  BasicBlock* getEntry() const {
+    return blocks.empty() ? nullptr : blocks.front().get();
   }
-  void insert(const std::string& labelName, BasicBlock::Iter BBIter) {
-    map[labelName] = BBIter;
+  BasicBlock* getBlockForLabel(size_t labelId) const {
+    return labelId < labelToBlock.size() ? labelToBlock[labelId] : nullptr;
   }
-  void erase(const std::string& labelName) { map.erase(labelName); }
-  void clear() { map.clear(); }
-  BasicBlock::Iter& at(const std::string& labelName) {
-    return map.at(labelName);
+  /// @return the block physically following `BB`, nullptr for the last one
+  BasicBlock* getLayoutSuccessor(const BasicBlock* BB) const {
+    return BB->blockId + 1 < blocks.size() ? blocks[BB->blockId + 1].get()
+                                           : nullptr;
   }
-  BasicBlock::Iter* find(const std::string& labelName) {
-    auto it = map.find(labelName);
-    if (it == map.end())
-      return nullptr;
-    return &it->second;
+  /// @return blocks reachable from the entry, entry first, every block before
+  /// its successors except along back edges
+  std::vector<BasicBlock*> getReversePostOrder() const;
+
+  void print() const {
+    std::println("--------- Basic Blocks --------");
+    for (auto& BB : blocks) {
+      std::print("Basic Block ID: {} | succs:", BB->blockId);
+      for (auto* Succ : BB->successors) {
+        std::print(" {}", Succ->blockId);
+      }
+      std::println();
+      for (auto& IRInstr : *BB) {
+        IRGen::instructionNodeIRDump(*IRInstr, 2);
+      }
+      std::println();
+    }
+    std::println("-------------------------------");
   }
 };
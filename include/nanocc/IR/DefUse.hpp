@@ -0,0 +1,97 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "nanocc/IR/IR.hpp"
+
+/// @brief Def-use chains of the non-static variables of one function.
+/// Every variable keeps the list of its uses and every instruction its
+/// operands, so `replaceAllUsesWith` touches exactly the users, and
+/// `hasOneUse` / `use_empty` are O(1). Meant for functions in SSA form, where
+/// `getDef` is the single definition.
+///
+/// All edits to the function while the chains are alive must go through
+/// `replaceAllUsesWith`, `setOperand`, `insert`, `replace` and `erase`.
+/// Operand slots are stored, so a registered `IRPhiNode` must not get or lose
+/// incoming values.
+class DefUseChains {
+public:
+  using InstrIter = std::list<std::unique_ptr<IRInstructionNode>>::iterator;
+
+  struct Use {
+    IRInstructionNode* user;
+    size_t operandNo; // index into `user->operands()`
+  };
+
+  explicit DefUseChains(IRFunctionNode& IRFunc);
+
+  /// @return true for the values def-use chains are kept for
+  static bool isTracked(const IRValNode* val);
+
+  const std::vector<Use>& getUses(const std::string& var) const;
+  size_t getNumUses(const std::string& var) const {
+    return getUses(var).size();
+  }
+  bool use_empty(const std::string& var) const { return getUses(var).empty(); }
+  bool hasOneUse(const std::string& var) const {
+    return getUses(var).size() == 1;
+  }
+  /// @return the defining instruction, nullptr if `var` has zero or several
+  /// definitions (parameters, undefined values, non-SSA code)
+  IRInstructionNode* getDef(const std::string& var) const;
+  IRValSlot getSlot(const Use& U) const;
+  /// @return false once `IRInstr` was erased or replaced
+  bool contains(IRInstructionNode* IRInstr) const {
+    return instrs.contains(IRInstr);
+  }
+  InstrIter getPosition(IRInstructionNode* IRInstr) const;
+
+  /// @brief Rewrites every use of `var` to read `val`, O(uses of var).
+  /// @return the rewritten instructions, without duplicates
+  std::vector<IRInstructionNode*>
+  replaceAllUsesWith(const std::string& var,
+                     const std::shared_ptr<IRValNode>& val);
+  void setOperand(IRInstructionNode* user, size_t operandNo,
+                  std::shared_ptr<IRValNode> val);
+
+  IRInstructionNode* insert(InstrIter pos,
+                            std::unique_ptr<IRInstructionNode> IRInstr);
+  /// @brief Puts `NewInstr` where `Old` was, `Old` is destroyed.
+  IRInstructionNode* replace(IRInstructionNode* Old,
+                             std::unique_ptr<IRInstructionNode> NewInstr);
+  /// @brief Unlinks and destroys `IRInstr`; its operands lose a use each.
+  void erase(IRInstructionNode* IRInstr);
+
+private:
+  struct ValueInfo;
+  struct Operand {
+    IRValSlot slot;
+    ValueInfo* value; // nullptr for constants and static variables
+    size_t useIdx;    // position in `value->uses`
+  };
+  struct InstrInfo {
+    InstrIter pos;
+    std::vector<Operand> operands;
+    ValueInfo* def = nullptr;
+  };
+  struct ValueInfo {
+    std::vector<Use> uses;
+    IRInstructionNode* def = nullptr;
+    size_t numDefs = 0;
+  };
+
+  IRFunctionNode& IRFunc;
+  // node based: `ValueInfo*` and `InstrInfo&` stay valid on insertion
+  std::unordered_map<std::string, ValueInfo> values;
+  std::unordered_map<IRInstructionNode*, InstrInfo> instrs;
+
+  ValueInfo* lookupValue(const std::shared_ptr<IRValNode>& val);
+  void addUse(IRInstructionNode* user, size_t operandNo, ValueInfo* value);
+  void removeUse(const Operand& Op);
+  void registerInstruction(InstrIter pos);
+  void unregisterInstruction(IRInstructionNode* IRInstr);
+};
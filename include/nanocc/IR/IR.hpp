@@ -3,6 +3,7 @@
 #include <list>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "nanocc/AST/AST.hpp"
@@ -24,11 +25,15 @@ class IRRetNode;
 class IRUnaryNode;
 class IRBinaryNode;
 class IRCopyNode;
+class IRBranchNode; // base class of the four jumps below
 class IRJumpNode;
 class IRJumpIfZeroNode;
 class IRJumpIfNotZeroNode;
+class IRJumpIfCmpNode; // compare and branch, for conditions in IR generation
 class IRLabelNode;
 class IRFunctionCallNode;
+class IRSelectNode; // branch free choice between two values, if-conversion
+class IRPhiNode; // only while the function is in SSA form
 
 // base class; use `shared_ptr` for this and its derived classes
 class IRValNode;
@@ -55,6 +60,16 @@ public:
   bool global;
   std::vector<std::string> parameters;
   std::list<std::unique_ptr<IRInstructionNode>> IRInstructions;
+  /// @brief Labels are numbered per function (`IRLabelNode::labelId`) at IR
+  /// generation, so label lookups are vector indexing instead of string
+  /// hashing. Ids are never reused, holes left by deleted labels are fine.
+  size_t numLabels = 0;
+  /// @brief true between `nanocc::constructSSA` and `nanocc::destructSSA`,
+  /// the function may then contain `IRPhiNode`s
+  bool inSSAForm = false;
+  /// @brief SSA value name => the variable it is a version of. Lets
+  /// `nanocc::destructSSA` give versions their old name back.
+  std::unordered_map<std::string, std::string> ssaOrigin;
 
   IRFunctionNode() = default;
   virtual ~IRFunctionNode() = default;
@@ -66,6 +81,18 @@ public:
   static bool classof(const IRTopLevelNode* node) {
     return dynamic_cast<const IRFunctionNode*>(node) != nullptr;
   }
+
+  /// @brief Counter behind `createName`, per function like the labels.
+  size_t numNames = 0;
+
+  /// @brief Make a new label local to this function, for passes that
+  /// introduce control flow after IR generation.
+  std::unique_ptr<IRLabelNode> createLabel(const std::string& prefix);
+  /// @brief A variable name no other function can produce,
+  /// `<prefix>.<funcName>.<n>`. Passes use this instead of `getUniqueName`,
+  /// functions are optimized concurrently and names must not depend on the
+  /// order they're processed in.
+  std::string createName(const std::string& prefix);
 };
 
 class IRStaticVarNode : public IRTopLevelNode {
@@ -85,12 +112,19 @@ public:
   }
 };
 
+using IRValSlot = std::shared_ptr<IRValNode>*;
+
 class IRInstructionNode : public IRNode {
 public:
   virtual ~IRInstructionNode() = default;
   /// @brief Used in basic block construction for IR Optimization
   /// @return boolean true/false
   virtual bool isTerminator() const { return false; }
+  /// @brief Slots of the values read by this instruction; writing through a
+  /// slot rewrites the operand in place.
+  virtual std::vector<IRValSlot> operands() { return {}; }
+  /// @brief Slot of the value written by this instruction, nullptr if none
+  virtual IRValSlot result() { return nullptr; }
 };
 
 class IRRetNode : public IRInstructionNode {
@@ -105,6 +139,11 @@ public:
     return dynamic_cast<const IRRetNode*>(u) != nullptr;
   }
   bool isTerminator() const override { return true; }
+  std::vector<IRValSlot> operands() override {
+    if (!retValue)
+      return {};
+    return {&retValue};
+  }
 };
 
 class IRUnaryNode : public IRInstructionNode {
@@ -122,6 +161,8 @@ public:
   static bool classof(const IRInstructionNode* u) {
     return dynamic_cast<const IRUnaryNode*>(u) != nullptr;
   }
+  std::vector<IRValSlot> operands() override { return {&valSrc}; }
+  IRValSlot result() override { return &valDest; }
 };
 
 class IRBinaryNode : public IRInstructionNode {
@@ -140,6 +181,8 @@ public:
   static bool classof(const IRInstructionNode* u) {
     return dynamic_cast<const IRBinaryNode*>(u) != nullptr;
   }
+  std::vector<IRValSlot> operands() override { return {&valSrcL, &valSrcR}; }
+  IRValSlot result() override { return &valDest; }
 };
 
 /// @brief val_src => val_dest
@@ -155,57 +198,104 @@ public:
   static bool classof(const IRInstructionNode* u) {
     return dynamic_cast<const IRCopyNode*>(u) != nullptr;
   }
+  std::vector<IRValSlot> operands() override { return {&ValSrc}; }
+  IRValSlot result() override { return &ValDest; }
 };
 
-class IRJumpNode : public IRInstructionNode {
+/// @brief Common part of all jumps. `labelId` indexes the labels of the
+/// enclosing `IRFunctionNode`; `labelName` is what gets emitted.
+class IRBranchNode : public IRInstructionNode {
 public:
+  static constexpr size_t NoLabel = static_cast<size_t>(-1);
+
   std::string labelName;
+  size_t labelId = NoLabel;
 
+  IRBranchNode() = default;
+  IRBranchNode(std::string label, size_t id)
+      : labelName(std::move(label)), labelId(id) {}
+
+  static bool classof(const IRInstructionNode* u) {
+    return dynamic_cast<const IRBranchNode*>(u) != nullptr;
+  }
+  bool isTerminator() const override { return true; }
+  /// @brief true if control may also fall through to the next instruction
+  virtual bool isConditional() const { return false; }
+};
+
+class IRJumpNode : public IRBranchNode {
+public:
   IRJumpNode() = default;
-  explicit IRJumpNode(std::string label) : labelName(std::move(label)) {}
+  explicit IRJumpNode(std::string label, size_t id = NoLabel)
+      : IRBranchNode(std::move(label), id) {}
 
   static bool classof(const IRInstructionNode* u) {
     return dynamic_cast<const IRJumpNode*>(u) != nullptr;
   }
-  bool isTerminator() const override { return true; }
 };
 
-class IRJumpIfZeroNode : public IRInstructionNode {
+class IRJumpIfZeroNode : public IRBranchNode {
 public:
   std::shared_ptr<IRValNode> condition;
-  std::string labelName;
 
   IRJumpIfZeroNode() = default;
-  IRJumpIfZeroNode(std::shared_ptr<IRValNode> cond, std::string label)
-      : condition(std::move(cond)), labelName(std::move(label)) {}
+  IRJumpIfZeroNode(std::shared_ptr<IRValNode> cond, std::string label,
+                   size_t id = NoLabel)
+      : IRBranchNode(std::move(label), id), condition(std::move(cond)) {}
 
   static bool classof(const IRInstructionNode* u) {
     return dynamic_cast<const IRJumpIfZeroNode*>(u) != nullptr;
   }
-  bool isTerminator() const override { return true; }
+  bool isConditional() const override { return true; }
+  std::vector<IRValSlot> operands() override { return {&condition}; }
 };
 
-class IRJumpIfNotZeroNode : public IRInstructionNode {
+class IRJumpIfNotZeroNode : public IRBranchNode {
 public:
   std::shared_ptr<IRValNode> condition;
-  std::string labelName;
 
   IRJumpIfNotZeroNode() = default;
-  IRJumpIfNotZeroNode(std::shared_ptr<IRValNode> cond, std::string label)
-      : condition(std::move(cond)), labelName(std::move(label)) {}
+  IRJumpIfNotZeroNode(std::shared_ptr<IRValNode> cond, std::string label,
+                      size_t id = NoLabel)
+      : IRBranchNode(std::move(label), id), condition(std::move(cond)) {}
 
   static bool classof(const IRInstructionNode* u) {
     return dynamic_cast<const IRJumpIfNotZeroNode*>(u) != nullptr;
   }
-  bool isTerminator() const override { return true; }
+  bool isConditional() const override { return true; }
+  std::vector<IRValSlot> operands() override { return {&condition}; }
+};
+
+/// @brief jump if `val_src_l op_type val_src_r` holds, `op_type` being one of
+/// the relational operators; the comparison's 0/1 result is never stored.
+class IRJumpIfCmpNode : public IRBranchNode {
+public:
+  TokenType opType;
+  std::shared_ptr<IRValNode> valSrcL;
+  std::shared_ptr<IRValNode> valSrcR;
+
+  IRJumpIfCmpNode() = default;
+  IRJumpIfCmpNode(TokenType op, std::shared_ptr<IRValNode> srcL,
+                  std::shared_ptr<IRValNode> srcR, std::string label,
+                  size_t id = NoLabel)
+      : IRBranchNode(std::move(label), id), opType(op),
+        valSrcL(std::move(srcL)), valSrcR(std::move(srcR)) {}
+
+  static bool classof(const IRInstructionNode* u) {
+    return dynamic_cast<const IRJumpIfCmpNode*>(u) != nullptr;
+  }
+  bool isConditional() const override { return true; }
+  std::vector<IRValSlot> operands() override { return {&valSrcL, &valSrcR}; }
 };
 
 class IRLabelNode : public IRInstructionNode {
 public:
   std::string labelName;
+  size_t labelId = IRBranchNode::NoLabel;
 
   IRLabelNode() = default;
-  explicit IRLabelNode(std::string name) : labelName(std::move(name)) {}
+  explicit IRLabelNode(std::string name, size_t id = IRBranchNode::NoLabel)
+      : labelName(std::move(name)), labelId(id) {}
 
   static bool classof(const IRInstructionNode* u) {
     return dynamic_cast<const IRLabelNode*>(u) != nullptr;
@@ -217,6 +307,9 @@ public:
   std::string funcName;
   std::vector<std::shared_ptr<IRValNode>> arguments;
   std::shared_ptr<IRValNode> returnDest;
+  /// @brief set by tail call elimination: the result is returned right away
+  /// and nothing goes on the stack, codegen may jump to the callee instead
+  bool tail = false;
 
   IRFunctionCallNode() = default;
   explicit IRFunctionCallNode(std::string name,
@@ -228,6 +321,75 @@ public:
   static bool classof(const IRInstructionNode* u) {
     return dynamic_cast<const IRFunctionCallNode*>(u) != nullptr;
   }
+  std::vector<IRValSlot> operands() override {
+    std::vector<IRValSlot> slots;
+    for (auto& arg : arguments) {
+      slots.push_back(&arg);
+    }
+    return slots;
+  }
+  IRValSlot result() override { return &returnDest; }
+};
+
+/// @brief dest = val_src_l op_type val_src_r ? val_true : val_false, with
+/// `op_type` a relational operator as in `IRJumpIfCmpNode`. Both values are
+/// computed before, only the choice depends on the comparison.
+class IRSelectNode : public IRInstructionNode {
+public:
+  TokenType opType;
+  std::shared_ptr<IRValNode> valSrcL;
+  std::shared_ptr<IRValNode> valSrcR;
+  std::shared_ptr<IRValNode> valTrue;
+  std::shared_ptr<IRValNode> valFalse;
+  std::shared_ptr<IRValNode> valDest;
+
+  IRSelectNode() = default;
+  IRSelectNode(TokenType op, std::shared_ptr<IRValNode> srcL,
+               std::shared_ptr<IRValNode> srcR,
+               std::shared_ptr<IRValNode> valTrue,
+               std::shared_ptr<IRValNode> valFalse,
+               std::shared_ptr<IRValNode> dest)
+      : opType(op), valSrcL(std::move(srcL)), valSrcR(std::move(srcR)),
+        valTrue(std::move(valTrue)), valFalse(std::move(valFalse)),
+        valDest(std::move(dest)) {}
+
+  static bool classof(const IRInstructionNode* u) {
+    return dynamic_cast<const IRSelectNode*>(u) != nullptr;
+  }
+  std::vector<IRValSlot> operands() override {
+    return {&valSrcL, &valSrcR, &valTrue, &valFalse};
+  }
+  IRValSlot result() override { return &valDest; }
+};
+
+/// @brief dest = phi [val_0, label_0], [val_1, label_1], ...
+/// `val_i` flows in from the predecessor block starting with `label_i`. Phis
+/// sit right after the label of their block and are read in parallel.
+class IRPhiNode : public IRInstructionNode {
+public:
+  struct Incoming {
+    std::shared_ptr<IRValNode> value;
+    std::string labelName;
+    size_t labelId;
+  };
+  std::shared_ptr<IRValNode> valDest;
+  std::vector<Incoming> incoming;
+
+  IRPhiNode() = default;
+  explicit IRPhiNode(std::shared_ptr<IRValNode> dest)
+      : valDest(std::move(dest)) {}
+
+  static bool classof(const IRInstructionNode* u) {
+    return dynamic_cast<const IRPhiNode*>(u) != nullptr;
+  }
+  std::vector<IRValSlot> operands() override {
+    std::vector<IRValSlot> slots;
+    for (auto& in : incoming) {
+      slots.push_back(&in.value);
+    }
+    return slots;
+  }
+  IRValSlot result() override { return &valDest; }
 };
 
 class IRValNode : public IRNode {
@@ -260,6 +422,18 @@ public:
 };
 
 namespace nanocc {
+/// @brief true for variables living in .data/.bss (file scope and block scope
+/// `static`/`extern`). Any function call may read or write them, and they are
+/// never renamed into SSA form.
+bool hasStaticStorage(const IRValNode& val);
+
+/// @return true for the relational operators, `<` `<=` `>` `>=` `==` `!=`
+bool isComparison(TokenType opType);
+/// @return the comparison with the operands swapped, `a < b` is `b > a`
+TokenType getSwappedComparison(TokenType opType);
+/// @return the comparison that is true when `opType` is false
+TokenType getNegatedComparison(TokenType opType);
+
 std::unique_ptr<IRProgramNode> generateIntermRepr(const ProgramNode& ast,
                                                   bool debug = false);
 } // namespace nanocc
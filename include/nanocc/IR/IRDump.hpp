@@ -14,9 +14,12 @@ void copyNodeIRDump(const IRCopyNode& copy_node, int indent);
 void jumpNodeIRDump(const IRJumpNode& jump_node, int indent);
 void jumpIfZeroNodeIRDump(const IRJumpIfZeroNode& jump_node, int indent);
 void jumpIfNotZeroNodeIRDump(const IRJumpIfNotZeroNode& jump_node, int indent);
+void jumpIfCmpNodeIRDump(const IRJumpIfCmpNode& jump_node, int indent);
 void labelNodeIRDump(const IRLabelNode& label_node, int indent);
 void functionCallNodeIRDump(const IRFunctionCallNode& func_call_node,
                             int indent);
+void selectNodeIRDump(const IRSelectNode& select_node, int indent);
+void phiNodeIRDump(const IRPhiNode& phi_node, int indent);
 std::string valNodeIRDump(const IRValNode& val_node);
 void instructionNodeIRDump(const IRInstructionNode& instr_node, int indent);
 } // namespace IRGen
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "nanocc/IR/IR.hpp"
+
+namespace nanocc {
+/// @brief Rename every non-static variable of `IRFunc` so that it has a single
+/// definition, inserting `IRPhiNode`s where control flow merges.
+/// Uses the on-the-fly construction of Braun et al., "Simple and Efficient
+/// Construction of Static Single Assignment Form" (CC 2013): blocks are filled
+/// in layout order, phis of blocks whose predecessors aren't all filled yet
+/// stay incomplete until the block is sealed, trivial phis are removed.
+/// Every block gets a label (phis name their predecessors by label) and the
+/// entry block is guaranteed to have no predecessors.
+void constructSSA(IRFunctionNode& IRFunc);
+
+/// @brief Leave SSA form: versions are coalesced back into one variable when
+/// their live ranges don't interfere, remaining phis become copies on the
+/// edges they come from; critical edges whose copies can't be hoisted above
+/// the conditional jump are split. Must run before `intermReprToPseudoAsm`.
+void destructSSA(IRFunctionNode& IRFunc);
+} // namespace nanocc
@@ -1,7 +1,21 @@
 #pragma once
 
+#include <optional>
+#include <vector>
+
 #include "nanocc/IR/IR.hpp"
+#include "nanocc/Transforms/PassManager.hpp"
 
 namespace nanocc {
-bool ConstantFoldInstructions(IRProgramNode& IRProgram);
+PassResult ConstantFoldInstructions(IRFunctionNode& IRFunc, AnalysisManager& AM);
+
+/// @brief Evaluates `opType val` as the target would.
+/// @return std::nullopt if `opType` isn't a unary IR op
+std::optional<int> foldUnaryOp(TokenType opType, int val);
+/// @brief Evaluates `val1 opType val2` as the target would.
+/// @return std::nullopt for unknown ops and for divisions that trap at run time
+std::optional<int> foldBinaryOp(TokenType opType, int val1, int val2);
+/// @brief Whether the conditional `Branch` jumps when its operands, in
+/// `operands()` order, hold `vals`.
+bool takesBranch(const IRBranchNode& Branch, const std::vector<int>& vals);
 } // namespace nanocc
@@ -1,7 +1,8 @@
 #pragma once
 
 #include "nanocc/IR/IR.hpp"
+#include "nanocc/Transforms/PassManager.hpp"
 
 namespace nanocc {
-bool CopyPropagate(IRProgramNode& IRProgram);
+PassResult CopyPropagate(IRFunctionNode& IRFunc, AnalysisManager& AM);
 } // namespace nanocc
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "nanocc/IR/IR.hpp"
+
+namespace nanocc {
+/// @brief Removes the `static` functions and variables nothing reachable from
+/// a `global` function or variable (or `main`) uses. Runs on the whole
+/// program once the function passes are done, inlining leaves most of them.
+/// @return true if something was removed
+bool EliminateDeadGlobals(IRProgramNode& IRProgram, bool debug = false);
+} // namespace nanocc
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "nanocc/IR/IR.hpp"
+#include "nanocc/Transforms/PassManager.hpp"
+
+namespace nanocc {
+/// @brief most work, in instructions (a multiplication counts 3, a select 2),
+/// if-conversion runs on both paths to save one branch; roughly what a branch
+/// the predictor gets wrong half the time costs
+constexpr unsigned IfConversionBudget = 8;
+
+/// @brief Replaces branches around small side effect free code by selects,
+/// and tests of `&&` / `||` operands by one branch on a select.
+PassResult IfConversion(IRFunctionNode& IRFunc, AnalysisManager& AM);
+} // namespace nanocc
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "nanocc/Analysis/CallGraph.hpp"
+#include "nanocc/IR/IR.hpp"
+
+namespace nanocc {
+/// @brief largest callee, in instructions, inlined at a call that saves
+/// nothing but the call itself; what the call sequence and constant
+/// arguments save is added to it
+constexpr size_t InlineSizeBudget = 16;
+/// @brief nothing is inlined into a function once it has this many
+/// instructions
+constexpr size_t InlineFunctionBudget = 1024;
+
+/// @brief Replaces the calls the functions of `SCC` make to small functions
+/// of components below it by a copy of their body. An SCC pass, callees must
+/// be done with.
+/// @return true if a call was inlined
+bool InlineCalls(const std::vector<CallGraphNode*>& SCC, const CallGraph& CG);
+} // namespace nanocc
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "nanocc/IR/IR.hpp"
+#include "nanocc/Transforms/PassManager.hpp"
+
+namespace nanocc {
+/// @brief most instructions a loop may have once unrolled
+constexpr size_t UnrollSizeBudget = 128;
+
+/// @brief Unrolls innermost loops with a constant trip count, fully when all
+/// the iterations fit `UnrollSizeBudget`, else `factor` times with the
+/// original loop left behind for the remaining iterations.
+PassResult LoopUnroll(IRFunctionNode& IRFunc, AnalysisManager& AM,
+                      unsigned factor);
+} // namespace nanocc
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "nanocc/IR/IR.hpp"
+#include "nanocc/Transforms/PassManager.hpp"
+
+namespace nanocc {
+/// @brief largest loop, in instructions, unswitching copies
+constexpr size_t UnswitchSizeBudget = 64;
+/// @brief no loop is copied once the function has this many instructions
+constexpr size_t UnswitchFunctionBudget = 1024;
+
+/// @brief Moves a branch on a loop invariant condition in front of the loop
+/// and gives each outcome its own copy of the loop without the branch.
+PassResult LoopUnswitch(IRFunctionNode& IRFunc, AnalysisManager& AM);
+} // namespace nanocc
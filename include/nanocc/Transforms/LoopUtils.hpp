@@ -0,0 +1,47 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "nanocc/Analysis/LoopInfo.hpp"
+#include "nanocc/IR/BasicBlock.hpp"
+#include "nanocc/IR/IR.hpp"
+
+namespace nanocc {
+/// @brief Gives the loops of `LI` without a preheader a new block right before
+/// the header that every entry from outside goes through. Loops whose header
+/// is only reached by falling through, or whose layout predecessor is a block
+/// of the loop falling into the header, are left alone.
+/// @return true if a block was added; `CFG` and `LI` are stale then
+bool insertLoopPreheaders(IRFunctionNode& IRFunc, const ControlFlowGraph& CFG,
+                          const LoopInfo& LI);
+
+/// @return true if control can run off the end of `BB` into the next block
+bool fallsThrough(const BasicBlock* BB);
+
+/// @return a copy of `val`, nullptr for nullptr
+std::shared_ptr<IRValNode> cloneValue(const std::shared_ptr<IRValNode>& val);
+
+/// @return a copy of `IRInstr` sharing no values with it
+std::unique_ptr<IRInstructionNode> cloneInstruction(IRInstructionNode* IRInstr);
+
+/// @return true if `A` and `B` are the same kind of instruction with the same
+/// operator, values, labels and callee, e.g. `A` and its clone
+bool isSameInstruction(IRInstructionNode* A, IRInstructionNode* B);
+
+/// @brief Copies the instructions in [first, last) of `IRFunc`. Labels in the
+/// range get new `createLabel(prefix)` labels and branches and phis naming
+/// them follow, references to labels outside the range are kept.
+std::list<std::unique_ptr<IRInstructionNode>>
+cloneRange(IRFunctionNode& IRFunc, BasicBlock::InstrIter first,
+           BasicBlock::InstrIter last, const std::string& prefix);
+
+/// @brief How many times a loop tests `v opType bound` with v = first,
+/// first + step, first + 2 * step, ... until the test fails, the failing
+/// test included.
+/// @return nullopt if v would wrap around before the test fails
+std::optional<long long> getTripCount(TokenType opType, long long first,
+                                      long long step, long long bound);
+} // namespace nanocc
@@ -1,20 +1,135 @@
 #pragma once
 
+#include <bitset>
 #include <functional>
+#include <initializer_list>
+#include <string>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
+#include "nanocc/Analysis/AnalysisManager.hpp"
+#include "nanocc/Analysis/CallGraph.hpp"
 #include "nanocc/IR/IR.hpp"
 
+/// @brief What a function pass did: `changed` drives the fixpoint loop,
+/// `preserved` the analysis cache. They are separate because a pass may
+/// rewrite a function without making progress (an SSA round trip renames
+/// values and relabels blocks).
+struct PassResult {
+  bool changed = false;
+  PreservedAnalyses preserved = PreservedAnalyses::all();
+
+  static PassResult unchanged() { return {}; }
+  /// @brief made progress and kept nothing but `PA`
+  static PassResult modified(PreservedAnalyses PA = PreservedAnalyses::none()) {
+    return {true, PA};
+  }
+};
+
+enum class ChangeKind {
+  Values,      // operands replaced or instructions rewritten in place
+  Removal,     // instructions erased
+  Insertion,   // instructions added or moved
+  ControlFlow, // branches, labels or blocks added, removed or retargeted
+  NumChangeKinds
+};
+
+/// @brief The kinds of change a function pass makes, or the kinds that can
+/// give it new work.
+class ChangeKinds {
+public:
+  static constexpr size_t NumKinds =
+      static_cast<size_t>(ChangeKind::NumChangeKinds);
+
+  ChangeKinds() = default;
+  ChangeKinds(std::initializer_list<ChangeKind> list) {
+    for (ChangeKind kind : list)
+      kinds.set(static_cast<size_t>(kind));
+  }
+  static ChangeKinds all() {
+    ChangeKinds CK;
+    CK.kinds.set();
+    return CK;
+  }
+
+  ChangeKinds& remove(ChangeKind kind) {
+    kinds.reset(static_cast<size_t>(kind));
+    return *this;
+  }
+  bool intersects(const ChangeKinds& Other) const {
+    return (kinds & Other.kinds).any();
+  }
+
+private:
+  std::bitset<NumKinds> kinds;
+};
+
+/// @brief How a function pass relates to the others: a pass that changed the
+/// function re-enables the passes whose `enabledBy` has a kind of change in
+/// its `makes`, and itself unless it's idempotent. The defaults re-enable
+/// everything.
+struct PassTraits {
+  ChangeKinds makes = ChangeKinds::all();
+  ChangeKinds enabledBy = ChangeKinds::all();
+  // running it right after itself can't find anything new
+  bool idempotent = true;
+};
+
+/// @brief Runs the program's strongly connected components of the call graph
+/// bottom-up: on each one the SCC passes (interprocedural, inlining) once,
+/// then the function passes on every function of it. A caller is only looked
+/// at once its callees are optimized. Components of the same height don't
+/// call each other and run on a work stealing `ThreadPool`, one task each.
+/// Function passes run to a fixpoint per function, and every function has a
+/// worklist of pending passes: a pass that changes the function re-enables
+/// the passes its kind of change can give work (see `PassTraits`), a pass
+/// that doesn't stays off until such a change. A function no pass reports a
+/// change on costs one sweep. Running out of the iteration budget means
+/// passes keep undoing each other's work; it is reported as a warning and
+/// the function is left as is. Analyses are cached per function and dropped
+/// according to what each pass preserved.
+/// Passes only change the functions they're given, read nothing but callees
+/// besides, and name things through `IRFunctionNode::createName`, so the
+/// output doesn't depend on threads.
 class PassManager {
+public:
+  using PassFn = std::function<PassResult(IRFunctionNode&, AnalysisManager&)>;
+  /// @brief runs on one component, returns true if it changed a function
+  using SCCPassFn = std::function<bool(const std::vector<CallGraphNode*>& SCC,
+                                       const CallGraph& CG)>;
+  static constexpr unsigned DefaultIterationBudget = 32;
+
 private:
-  std::vector<std::function<bool(IRProgramNode&)>> Passes;
+  struct PassEntry {
+    std::string name;
+    PassFn run;
+    PassTraits traits;
+  };
+  std::vector<PassEntry> Passes;
+  std::vector<std::pair<std::string, SCCPassFn>> SCCPasses;
+  unsigned iterationBudget = DefaultIterationBudget;
+  unsigned numThreads = 0;
+
+  void runOnFunction(IRFunctionNode& IRFunc, bool debug);
+  void runOnSCC(const std::vector<CallGraphNode*>& SCC, const CallGraph& CG,
+                bool debug);
 
 public:
   PassManager() = default;
   ~PassManager() = default;
 
-  template <typename PassType> void AddPass(PassType Pass);
+  template <typename PassType>
+  void AddPass(std::string name, PassType Pass, PassTraits traits = {});
+  /// @brief SCC passes run in the order they're added, before the function
+  /// passes of the component
+  void AddSCCPass(std::string name, SCCPassFn Pass);
+  /// @brief Caps the sweeps over the pending passes of one function, the
+  /// function is left as is, with a warning, once it runs out.
+  void setIterationBudget(unsigned budget) { iterationBudget = budget; }
+  /// @brief 0 for one thread per hardware thread; -fdump runs on one thread
+  /// so the dumps come out in program order.
+  void setNumThreads(unsigned threads) { numThreads = threads; }
 
   void run(IRProgramNode& IRProgram, bool debug = false);
 };
@@ -24,13 +139,35 @@ enum class OptPass {
   ConstantFolding,
   UnreachableCodeElim,
   CopyPropagation,
-  DeadStoreElim
+  DeadStoreElim,
+  SSAPropagation,
+  SCCP,
+  GVN,
+  InstCombine,
+  LICM,
+  LoopUnswitch,
+  IVStrengthReduction,
+  LoopUnroll,
+  IfConversion,
+  Inline,
+  TailCallElim,
+  GlobalDCE
 };
 // dev flags, no to be used by users
 struct OptFlags {
   std::unordered_set<OptPass> optPasses;
+  unsigned iterationBudget = PassManager::DefaultIterationBudget;
+  unsigned numThreads = 0; // 0: one per hardware thread
+  unsigned unrollFactor = 4;
 };
 
+/// @brief Adds the pass enabled by a `-fopt-*` dev flag to `flags`,
+/// `-fopt-budget=N` sets the per-function iteration budget and
+/// `-fopt-threads=N` the number of threads optimizing functions and
+/// `-fopt-unroll-factor=N` how many copies of the body partial unrolling makes.
+/// @return false if `flag` isn't an optimization flag
+bool parseOptFlag(const std::string& flag, OptFlags& flags);
+
 void runIROptimizationPipeline(IRProgramNode& IRProgram, const OptFlags& flags,
                                bool debug = false);
-} // namespace nanocc
\ No newline at end of file
+} // namespace nanocc
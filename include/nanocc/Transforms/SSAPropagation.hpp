@@ -0,0 +1,8 @@
+#pragma once
+
+#include "nanocc/IR/IR.hpp"
+#include "nanocc/Transforms/PassManager.hpp"
+
+namespace nanocc {
+PassResult SSAPropagate(IRFunctionNode& IRFunc, AnalysisManager& AM);
+} // namespace nanocc
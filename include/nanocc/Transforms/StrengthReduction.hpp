@@ -0,0 +1,9 @@
+#pragma once
+
+#include "nanocc/IR/IR.hpp"
+#include "nanocc/Transforms/PassManager.hpp"
+
+namespace nanocc {
+PassResult InductionVariableStrengthReduction(IRFunctionNode& IRFunc,
+                                              AnalysisManager& AM);
+} // namespace nanocc
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "nanocc/IR/IR.hpp"
+#include "nanocc/Transforms/PassManager.hpp"
+
+namespace nanocc {
+/// @brief Turns recursive calls whose result is returned, as is or added to
+/// or multiplied by a value, into jumps back to the start of the function,
+/// and marks the other calls whose result is returned `tail`.
+PassResult TailCallElimination(IRFunctionNode& IRFunc, AnalysisManager& AM);
+} // namespace nanocc
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace bitvector_detail {
+// Word kernels of the set operations: 256 bits at a time with AVX2
+// (-DNANOCC_ENABLE_AVX2=ON), 128 with SSE2 (always there on x86-64), then
+// the scalar tail. `Op` sees the same words in all three forms.
+template <typename Op256, typename Op128, typename Op64>
+inline void applyWords(uint64_t* Dst, const uint64_t* Src, size_t n,
+                       [[maybe_unused]] Op256 op256,
+                       [[maybe_unused]] Op128 op128, Op64 op64) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 4 <= n; i += 4) {
+    __m256i A = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Dst + i));
+    __m256i B = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(Dst + i), op256(A, B));
+  }
+#endif
+#if defined(__SSE2__)
+  for (; i + 2 <= n; i += 2) {
+    __m128i A = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Dst + i));
+    __m128i B = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(Dst + i), op128(A, B));
+  }
+#endif
+  for (; i < n; i++)
+    Dst[i] = op64(Dst[i], Src[i]);
+}
+
+#if defined(__AVX2__)
+#define NANOCC_OP256(expr) [](__m256i A, __m256i B) { return expr; }
+#else
+#define NANOCC_OP256(expr) nullptr
+#endif
+#if defined(__SSE2__)
+#define NANOCC_OP128(expr) [](__m128i A, __m128i B) { return expr; }
+#else
+#define NANOCC_OP128(expr) nullptr
+#endif
+
+inline void orWords(uint64_t* Dst, const uint64_t* Src, size_t n) {
+  applyWords(Dst, Src, n, NANOCC_OP256(_mm256_or_si256(A, B)),
+             NANOCC_OP128(_mm_or_si128(A, B)),
+             [](uint64_t A, uint64_t B) { return A | B; });
+}
+inline void andWords(uint64_t* Dst, const uint64_t* Src, size_t n) {
+  applyWords(Dst, Src, n, NANOCC_OP256(_mm256_and_si256(A, B)),
+             NANOCC_OP128(_mm_and_si128(A, B)),
+             [](uint64_t A, uint64_t B) { return A & B; });
+}
+// Dst &= ~Src, andnot(X, Y) is ~X & Y
+inline void andNotWords(uint64_t* Dst, const uint64_t* Src, size_t n) {
+  applyWords(Dst, Src, n, NANOCC_OP256(_mm256_andnot_si256(B, A)),
+             NANOCC_OP128(_mm_andnot_si128(B, A)),
+             [](uint64_t A, uint64_t B) { return A & ~B; });
+}
+
+#undef NANOCC_OP256
+#undef NANOCC_OP128
+} // namespace bitvector_detail
+
+/// @brief Fixed size dense bit set for dataflow facts, 64 bits per word.
+/// Bits past `size()` in the last word are kept zero, so whole-word
+/// comparisons and counts need no masking. Union, intersection and
+/// difference run on SIMD registers where the target has them.
+class BitVector {
+public:
+  static constexpr size_t NoBit = static_cast<size_t>(-1);
+
+  BitVector() = default;
+  explicit BitVector(size_t numBits, bool value = false)
+      : numBits(numBits), words((numBits + 63) / 64, value ? ~0ull : 0ull) {
+    clearUnusedBits();
+  }
+
+  size_t size() const { return numBits; }
+
+  bool test(size_t idx) const {
+    assert(idx < numBits && "BitVector index out of range");
+    return (words[idx / 64] >> (idx % 64)) & 1;
+  }
+  void set(size_t idx) {
+    assert(idx < numBits && "BitVector index out of range");
+    words[idx / 64] |= 1ull << (idx % 64);
+  }
+  void reset(size_t idx) {
+    assert(idx < numBits && "BitVector index out of range");
+    words[idx / 64] &= ~(1ull << (idx % 64));
+  }
+  void set() {
+    for (auto& W : words)
+      W = ~0ull;
+    clearUnusedBits();
+  }
+  void reset() {
+    for (auto& W : words)
+      W = 0;
+  }
+
+  bool any() const {
+    for (auto W : words) {
+      if (W)
+        return true;
+    }
+    return false;
+  }
+  size_t count() const {
+    size_t n = 0;
+    for (auto W : words)
+      n += std::popcount(W);
+    return n;
+  }
+  /// @return the first set bit at or after `idx`, `NoBit` if there is none
+  size_t findNext(size_t idx) const {
+    if (idx >= numBits)
+      return NoBit;
+    size_t w = idx / 64;
+    uint64_t W = words[w] & (~0ull << (idx % 64));
+    while (true) {
+      if (W)
+        return w * 64 + std::countr_zero(W);
+      if (++w == words.size())
+        return NoBit;
+      W = words[w];
+    }
+  }
+  size_t findFirst() const { return findNext(0); }
+
+  BitVector& operator&=(const BitVector& RHS) {
+    assert(numBits == RHS.numBits && "BitVector size mismatch");
+    bitvector_detail::andWords(words.data(), RHS.words.data(), words.size());
+    return *this;
+  }
+  BitVector& operator|=(const BitVector& RHS) {
+    assert(numBits == RHS.numBits && "BitVector size mismatch");
+    bitvector_detail::orWords(words.data(), RHS.words.data(), words.size());
+    return *this;
+  }
+  /// @brief this &= ~RHS
+  BitVector& reset(const BitVector& RHS) {
+    assert(numBits == RHS.numBits && "BitVector size mismatch");
+    bitvector_detail::andNotWords(words.data(), RHS.words.data(),
+                                  words.size());
+    return *this;
+  }
+  bool operator==(const BitVector& RHS) const = default;
+
+private:
+  size_t numBits = 0;
+  std::vector<uint64_t> words;
+
+  void clearUnusedBits() {
+    if (numBits % 64)
+      words.back() &= (1ull << (numBits % 64)) - 1;
+  }
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/// @brief Work stealing pool for a fixed batch of independent tasks. Every
+/// worker owns a deque of task indices, seeded with a contiguous slice of
+/// the batch; it takes tasks from the front of its own deque and, once that
+/// is empty, steals from the back of the others. Tasks don't spawn tasks, so
+/// a worker that finds every deque empty is done.
+class ThreadPool {
+public:
+  /// @param numThreads workers including the calling thread, 0 for one per
+  /// hardware thread
+  explicit ThreadPool(unsigned numThreads = 0);
+
+  unsigned getNumThreads() const { return numThreads; }
+
+  /// @brief Runs `body(i)` for every i in [0, n) and waits for all of them.
+  /// The first exception thrown by a task is rethrown here once the rest
+  /// have finished.
+  void parallelFor(size_t n, const std::function<void(size_t)>& body);
+
+private:
+  struct WorkQueue {
+    std::mutex lock;
+    std::deque<size_t> tasks;
+  };
+
+  unsigned numThreads;
+  std::vector<std::unique_ptr<WorkQueue>> queues;
+
+  bool popOwn(unsigned worker, size_t& task);
+  bool steal(unsigned thief, size_t& task);
+  void work(unsigned worker, const std::function<void(size_t)>& body,
+            std::exception_ptr& error, std::mutex& errorLock);
+};
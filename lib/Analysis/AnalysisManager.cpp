@@ -0,0 +1,56 @@
+#include <memory>
+
+#include "nanocc/Analysis/AnalysisManager.hpp"
+
+const ControlFlowGraph& AnalysisManager::getCFG(IRFunctionNode& IRFunc) {
+  auto& Cached = cache[&IRFunc];
+  if (!Cached.CFG)
+    Cached.CFG = std::make_unique<ControlFlowGraph>(IRFunc);
+  return *Cached.CFG;
+}
+
+const DominatorTree& AnalysisManager::getDomTree(IRFunctionNode& IRFunc) {
+  const ControlFlowGraph& CFG = getCFG(IRFunc);
+  auto& Cached = cache[&IRFunc];
+  if (!Cached.DT)
+    Cached.DT = std::make_unique<DominatorTree>(CFG);
+  return *Cached.DT;
+}
+
+const LoopInfo& AnalysisManager::getLoopInfo(IRFunctionNode& IRFunc) {
+  const DominatorTree& DT = getDomTree(IRFunc);
+  auto& Cached = cache[&IRFunc];
+  if (!Cached.LI)
+    Cached.LI = std::make_unique<LoopInfo>(*Cached.CFG, DT);
+  return *Cached.LI;
+}
+
+const Liveness& AnalysisManager::getLiveness(IRFunctionNode& IRFunc) {
+  const ControlFlowGraph& CFG = getCFG(IRFunc);
+  auto& Cached = cache[&IRFunc];
+  if (!Cached.Live)
+    Cached.Live = std::make_unique<Liveness>(IRFunc, CFG);
+  return *Cached.Live;
+}
+
+void AnalysisManager::invalidate(IRFunctionNode& IRFunc,
+                                 const PreservedAnalyses& PA) {
+  if (PA.areAllPreserved())
+    return;
+  auto it = cache.find(&IRFunc);
+  if (it == cache.end())
+    return;
+  if (!PA.isPreserved(AnalysisKind::CFG)) {
+    cache.erase(it);
+    return;
+  }
+  // drop the dependents before what they depend on
+  auto& Cached = it->second;
+  bool keepDT = PA.isPreserved(AnalysisKind::DominatorTree);
+  if (!keepDT || !PA.isPreserved(AnalysisKind::LoopInfo))
+    Cached.LI.reset();
+  if (!keepDT)
+    Cached.DT.reset();
+  if (!PA.isPreserved(AnalysisKind::Liveness))
+    Cached.Live.reset();
+}
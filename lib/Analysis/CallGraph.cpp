@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <functional>
+#include <print>
+#include <vector>
+
+#include "nanocc/Analysis/CallGraph.hpp"
+#include "nanocc/Utils/Utils.hpp"
+
+CallGraph::CallGraph(IRProgramNode& IRProgram) {
+  for (auto& TopLvl : IRProgram.topLevel) {
+    if (auto* IRFunc = dyn_cast<IRFunctionNode>(TopLvl.get())) {
+      nodes.push_back(std::make_unique<CallGraphNode>());
+      nodes.back()->function = IRFunc;
+      byName[IRFunc->funcName] = nodes.back().get();
+    }
+  }
+  for (auto& Node : nodes) {
+    for (auto& IRInstr : Node->function->IRInstructions) {
+      auto* Call = dyn_cast<IRFunctionCallNode>(IRInstr.get());
+      CallGraphNode* Callee = Call ? getNode(Call->funcName) : nullptr;
+      if (!Callee)
+        continue;
+      if (Callee == Node.get())
+        Node->callsItself = true;
+      auto& Callees = Node->callees;
+      if (std::find(Callees.begin(), Callees.end(), Callee) != Callees.end())
+        continue;
+      Callees.push_back(Callee);
+      Callee->callers.push_back(Node.get());
+    }
+  }
+
+  // Tarjan: a component is done when the DFS leaves its first node, after
+  // everything it calls, so they come out bottom-up
+  std::unordered_map<const CallGraphNode*, size_t> index, lowLink;
+  std::unordered_map<const CallGraphNode*, bool> onStack;
+  std::vector<CallGraphNode*> stack;
+  size_t nextIndex = 0;
+  std::function<void(CallGraphNode*)> visit = [&](CallGraphNode* Node) {
+    index[Node] = lowLink[Node] = nextIndex++;
+    stack.push_back(Node);
+    onStack[Node] = true;
+    for (auto* Callee : Node->callees) {
+      if (!index.contains(Callee)) {
+        visit(Callee);
+        lowLink[Node] = std::min(lowLink[Node], lowLink[Callee]);
+      } else if (onStack[Callee]) {
+        lowLink[Node] = std::min(lowLink[Node], index[Callee]);
+      }
+    }
+    if (lowLink[Node] != index[Node])
+      return;
+    size_t sccId = sccs.size();
+    auto& SCC = sccs.emplace_back();
+    unsigned height = 0;
+    CallGraphNode* Member = nullptr;
+    while (Member != Node) {
+      Member = stack.back();
+      stack.pop_back();
+      onStack[Member] = false;
+      Member->sccId = sccId;
+      SCC.push_back(Member);
+    }
+    // the components called are all done, ids below `sccId`
+    for (auto* Caller : SCC) {
+      for (auto* Callee : Caller->callees) {
+        if (Callee->sccId != sccId)
+          height = std::max(height, heights[Callee->sccId] + 1);
+      }
+    }
+    heights.push_back(height);
+    // in the order the search reached them
+    std::reverse(SCC.begin(), SCC.end());
+  };
+  for (auto& Node : nodes) {
+    if (!index.contains(Node.get()))
+      visit(Node.get());
+  }
+}
+
+CallGraphNode* CallGraph::getNode(const std::string& funcName) const {
+  auto it = byName.find(funcName);
+  return it == byName.end() ? nullptr : it->second;
+}
+
+void CallGraph::print() const {
+  std::println("----------- Call Graph -------------");
+  for (size_t id = 0; id < sccs.size(); id++) {
+    std::print("SCC {} | height: {} | functions:", id, heights[id]);
+    for (auto* Node : sccs[id]) {
+      std::print(" {}", Node->function->funcName);
+    }
+    std::print(" | calls:");
+    for (auto* Node : sccs[id]) {
+      for (auto* Callee : Node->callees) {
+        std::print(" {}->{}", Node->function->funcName,
+                   Callee->function->funcName);
+      }
+    }
+    std::println();
+  }
+  std::println("------------------------------------");
+}
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <print>
+#include <utility>
+#include <vector>
+
+#include "nanocc/Analysis/Dominators.hpp"
+#include "nanocc/IR/BasicBlock.hpp"
+
+DominatorTree::DominatorTree(const ControlFlowGraph& CFG)
+    : postNumber(CFG.size(), Unreachable), idom(CFG.size(), nullptr),
+      children(CFG.size()), dfsIn(CFG.size(), 0), dfsOut(CFG.size(), 0) {
+  if (CFG.empty())
+    return;
+  entry = CFG.getEntry();
+  computePostOrder(CFG);
+  computeIDoms();
+  numberTree();
+}
+
+void DominatorTree::computePostOrder(const ControlFlowGraph& CFG) {
+  rpo = CFG.getReversePostOrder();
+  for (size_t i = 0; i < rpo.size(); i++) {
+    postNumber[rpo[i]->blockId] = rpo.size() - 1 - i;
+  }
+}
+
+void DominatorTree::computeIDoms() {
+  auto intersect = [&](BasicBlock* Finger1, BasicBlock* Finger2) {
+    while (Finger1 != Finger2) {
+      while (postNumber[Finger1->blockId] < postNumber[Finger2->blockId])
+        Finger1 = idom[Finger1->blockId];
+      while (postNumber[Finger2->blockId] < postNumber[Finger1->blockId])
+        Finger2 = idom[Finger2->blockId];
+    }
+    return Finger1;
+  };
+
+  idom[entry->blockId] = entry;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t i = 1; i < rpo.size(); i++) { // rpo[0] is the entry
+      BasicBlock* BB = rpo[i];
+      BasicBlock* NewIDom = nullptr;
+      for (auto* Pred : BB->predecessors) {
+        if (!idom[Pred->blockId]) // unreachable or not processed yet
+          continue;
+        NewIDom = NewIDom ? intersect(Pred, NewIDom) : Pred;
+      }
+      if (idom[BB->blockId] != NewIDom) {
+        idom[BB->blockId] = NewIDom;
+        changed = true;
+      }
+    }
+  }
+
+  for (size_t i = 1; i < rpo.size(); i++) {
+    children[idom[rpo[i]->blockId]->blockId].push_back(rpo[i]);
+  }
+}
+
+void DominatorTree::numberTree() {
+  size_t counter = 0;
+  std::vector<std::pair<BasicBlock*, size_t>> stack;
+  stack.push_back({entry, 0});
+  dfsIn[entry->blockId] = counter++;
+  while (!stack.empty()) {
+    auto& [BB, nextChild] = stack.back();
+    auto& Children = children[BB->blockId];
+    if (nextChild < Children.size()) {
+      BasicBlock* Child = Children[nextChild++];
+      dfsIn[Child->blockId] = counter++;
+      stack.push_back({Child, 0});
+      continue;
+    }
+    dfsOut[BB->blockId] = counter++;
+    stack.pop_back();
+  }
+}
+
+BasicBlock* DominatorTree::getIDom(const BasicBlock* BB) const {
+  if (BB == entry)
+    return nullptr;
+  return idom[BB->blockId];
+}
+
+bool DominatorTree::dominates(const BasicBlock* A, const BasicBlock* B) const {
+  if (A == B || !isReachable(B))
+    return true;
+  if (!isReachable(A))
+    return false;
+  return dfsIn[A->blockId] <= dfsIn[B->blockId] &&
+         dfsOut[B->blockId] <= dfsOut[A->blockId];
+}
+
+void DominatorTree::print() const {
+  std::println("-------- Dominator Tree -------");
+  for (auto* BB : rpo) {
+    std::print("Basic Block ID: {} | idom:", BB->blockId);
+    if (auto* IDom = getIDom(BB))
+      std::print(" {}", IDom->blockId);
+    std::print(" | children:");
+    for (auto* Child : getChildren(BB)) {
+      std::print(" {}", Child->blockId);
+    }
+    std::println();
+  }
+  std::println("-------------------------------");
+}
+
+DominanceFrontier::DominanceFrontier(const ControlFlowGraph& CFG,
+                                     const DominatorTree& DT)
+    : frontier(CFG.size()) {
+  for (auto* BB : DT.getReversePostOrder()) {
+    if (BB->predecessors.size() < 2)
+      continue;
+    for (auto* Pred : BB->predecessors) {
+      if (!DT.isReachable(Pred))
+        continue;
+      BasicBlock* Runner = Pred;
+      while (Runner != DT.getIDom(BB)) {
+        auto& DF = frontier[Runner->blockId];
+        // BB is added by all runners before moving on, so it can only be last
+        if (DF.empty() || DF.back() != BB)
+          DF.push_back(BB);
+        Runner = DT.getIDom(Runner);
+      }
+    }
+  }
+}
+
+void DominanceFrontier::print() const {
+  std::println("------ Dominance Frontier -----");
+  for (size_t i = 0; i < frontier.size(); i++) {
+    std::print("Basic Block ID: {} | DF:", i);
+    for (auto* BB : frontier[i]) {
+      std::print(" {}", BB->blockId);
+    }
+    std::println();
+  }
+  std::println("-------------------------------");
+}
@@ -0,0 +1,105 @@
+#include <print>
+#include <vector>
+
+#include "nanocc/Analysis/DataflowFramework.hpp"
+#include "nanocc/Analysis/Liveness.hpp"
+#include "nanocc/IR/DefUse.hpp"
+
+size_t Liveness::lookupOrAdd(const IRValNode* val) {
+  if (!DefUseChains::isTracked(val))
+    return NoVar;
+  auto& Name = cast<IRVariableNode>(val)->varName;
+  auto [it, inserted] = varIndex.try_emplace(Name, varNames.size());
+  if (inserted)
+    varNames.push_back(Name);
+  return it->second;
+}
+
+Liveness::Liveness(IRFunctionNode& IRFunc, const ControlFlowGraph& CFG) {
+  for (auto& Param : IRFunc.parameters) {
+    if (varIndex.try_emplace(Param, varNames.size()).second)
+      varNames.push_back(Param);
+  }
+
+  for (auto& IRInstr : IRFunc.IRInstructions) {
+    for (IRValSlot Slot : IRInstr->operands())
+      lookupOrAdd(Slot->get());
+    if (IRValSlot Result = IRInstr->result())
+      lookupOrAdd(Result->get());
+  }
+
+  // uses(B) are the gen set and defs(B) the kill set, but a variable
+  // read and written in B is only in uses(B) if the read comes first
+  UnionProblem<DataflowDirection::Backward> Problem(CFG, varNames.size());
+  for (auto& BB : CFG.blocks) {
+    auto& Transfer = Problem.getTransfer(BB.get());
+    for (auto& IRInstr : *BB) {
+      for (IRValSlot Slot : IRInstr->operands()) {
+        size_t idx = getVarIndex(*Slot);
+        if (idx != NoVar && !Transfer.kill.test(idx))
+          Transfer.gen.set(idx);
+      }
+      if (IRValSlot Result = IRInstr->result()) {
+        size_t idx = getVarIndex(*Result);
+        if (idx != NoVar)
+          Transfer.kill.set(idx);
+      }
+    }
+  }
+
+  DataflowSolver Solver(CFG, Problem);
+  liveIn = Solver.takeIn();
+  liveOut = Solver.takeOut();
+}
+
+size_t Liveness::getVarIndex(const std::shared_ptr<IRValNode>& val) const {
+  if (!DefUseChains::isTracked(val.get()))
+    return NoVar;
+  return getVarIndex(cast<IRVariableNode>(val.get())->varName);
+}
+
+size_t Liveness::getVarIndex(const std::string& var) const {
+  auto it = varIndex.find(var);
+  return it == varIndex.end() ? NoVar : it->second;
+}
+
+bool Liveness::isLiveIn(const BasicBlock* BB, const std::string& var) const {
+  size_t idx = getVarIndex(var);
+  return idx != NoVar && liveIn[BB->blockId].test(idx);
+}
+
+bool Liveness::isLiveOut(const BasicBlock* BB, const std::string& var) const {
+  size_t idx = getVarIndex(var);
+  return idx != NoVar && liveOut[BB->blockId].test(idx);
+}
+
+void Liveness::stepBackward(IRInstructionNode* IRInstr, BitVector& Live) const {
+  if (IRValSlot Result = IRInstr->result()) {
+    size_t idx = getVarIndex(*Result);
+    if (idx != NoVar)
+      Live.reset(idx);
+  }
+  for (IRValSlot Slot : IRInstr->operands()) {
+    size_t idx = getVarIndex(*Slot);
+    if (idx != NoVar)
+      Live.set(idx);
+  }
+}
+
+void Liveness::print() const {
+  std::println("----------- Liveness ----------");
+  for (size_t i = 0; i < liveIn.size(); i++) {
+    std::print("Basic Block ID: {} | in:", i);
+    for (size_t idx = 0; idx < varNames.size(); idx++) {
+      if (liveIn[i].test(idx))
+        std::print(" {}", varNames[idx]);
+    }
+    std::print(" | out:");
+    for (size_t idx = 0; idx < varNames.size(); idx++) {
+      if (liveOut[i].test(idx))
+        std::print(" {}", varNames[idx]);
+    }
+    std::println();
+  }
+  std::println("-------------------------------");
+}
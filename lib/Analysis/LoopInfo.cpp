@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <print>
+#include <vector>
+
+#include "nanocc/Analysis/LoopInfo.hpp"
+
+bool Loop::contains(const BasicBlock* BB) const {
+  return std::binary_search(blocks.begin(), blocks.end(), BB,
+                            [](const BasicBlock* A, const BasicBlock* B) {
+                              return A->blockId < B->blockId;
+                            });
+}
+
+bool Loop::contains(const Loop* L) const {
+  for (; L; L = L->parent) {
+    if (L == this)
+      return true;
+  }
+  return false;
+}
+
+unsigned Loop::getDepth() const {
+  unsigned depth = 1;
+  for (Loop* L = parent; L; L = L->parent) {
+    depth++;
+  }
+  return depth;
+}
+
+BasicBlock* Loop::getPreheader() const {
+  BasicBlock* Preheader = nullptr;
+  for (auto* Pred : header->predecessors) {
+    if (contains(Pred))
+      continue;
+    if (Preheader)
+      return nullptr;
+    Preheader = Pred;
+  }
+  if (!Preheader || Preheader->successors.size() != 1)
+    return nullptr;
+  return Preheader;
+}
+
+std::vector<BasicBlock*> Loop::getExitBlocks() const {
+  std::vector<BasicBlock*> exits;
+  for (auto* BB : blocks) {
+    for (auto* Succ : BB->successors) {
+      if (!contains(Succ) &&
+          std::find(exits.begin(), exits.end(), Succ) == exits.end())
+        exits.push_back(Succ);
+    }
+  }
+  return exits;
+}
+
+LoopInfo::LoopInfo(const ControlFlowGraph& CFG, const DominatorTree& DT)
+    : innermost(CFG.size(), nullptr) {
+  // index of the last loop that claimed the block, avoids one bitvector of
+  // every block per loop
+  std::vector<size_t> inLoop(CFG.size(), static_cast<size_t>(-1));
+  // headers in reverse postorder, so an outer header comes before the
+  // headers nested in it
+  for (auto* Header : DT.getReversePostOrder()) {
+    std::vector<BasicBlock*> Latches;
+    for (auto* Pred : Header->predecessors) {
+      if (DT.isReachable(Pred) && DT.dominates(Header, Pred))
+        Latches.push_back(Pred);
+    }
+    if (Latches.empty())
+      continue;
+
+    auto L = std::make_unique<Loop>();
+    L->header = Header;
+    L->latches = Latches;
+    // walk backwards from the latches, the header stops the walk
+    size_t LoopIdx = loops.size();
+    inLoop[Header->blockId] = LoopIdx;
+    L->blocks.push_back(Header);
+    std::vector<BasicBlock*> worklist(Latches.begin(), Latches.end());
+    while (!worklist.empty()) {
+      BasicBlock* BB = worklist.back();
+      worklist.pop_back();
+      if (inLoop[BB->blockId] == LoopIdx)
+        continue;
+      inLoop[BB->blockId] = LoopIdx;
+      L->blocks.push_back(BB);
+      for (auto* Pred : BB->predecessors) {
+        if (DT.isReachable(Pred))
+          worklist.push_back(Pred);
+      }
+    }
+    std::sort(L->blocks.begin(), L->blocks.end(),
+              [](const BasicBlock* A, const BasicBlock* B) {
+                return A->blockId < B->blockId;
+              });
+    loops.push_back(std::move(L));
+  }
+
+  // the parent of a loop is the innermost of the earlier loops that contains
+  // its header; later loops overwrite `innermost` for their blocks
+  for (auto& L : loops) {
+    L->parent = innermost[L->header->blockId];
+    if (L->parent)
+      L->parent->subLoops.push_back(L.get());
+    else
+      topLevel.push_back(L.get());
+    for (auto* BB : L->blocks) {
+      innermost[BB->blockId] = L.get();
+    }
+  }
+
+  // inner loops first
+  std::stable_sort(loops.begin(), loops.end(), [](auto& A, auto& B) {
+    return A->getDepth() > B->getDepth();
+  });
+}
+
+void LoopInfo::print() const {
+  std::println("----------- Loops -------------");
+  for (auto& L : loops) {
+    std::print("Loop header: {} | depth: {} | blocks:", L->header->blockId,
+               L->getDepth());
+    for (auto* BB : L->blocks) {
+      std::print(" {}", BB->blockId);
+    }
+    std::print(" | latches:");
+    for (auto* Latch : L->latches) {
+      std::print(" {}", Latch->blockId);
+    }
+    std::println();
+  }
+  std::println("-------------------------------");
+}
@@ -31,7 +31,14 @@ jumpIfZeroLowerIRToAsm(IRJumpIfZeroNode& node);
 std::vector<std::unique_ptr<AsmInstructionNode>>
 jumpIfNotZeroLowerIRToAsm(IRJumpIfNotZeroNode& node);
 std::vector<std::unique_ptr<AsmInstructionNode>>
+jumpIfCmpLowerIRToAsm(IRJumpIfCmpNode& node);
+std::vector<std::unique_ptr<AsmInstructionNode>>
 labelLowerIRToAsm(IRLabelNode& node);
+bool isTailCall(const IRFunctionCallNode& node, const IRInstructionNode& next);
+std::vector<std::unique_ptr<AsmInstructionNode>>
+tailCallLowerIRToAsm(IRFunctionCallNode& node);
 std::vector<std::unique_ptr<AsmInstructionNode>>
 functionCallLowerIRToAsm(IRFunctionCallNode& node);
+std::vector<std::unique_ptr<AsmInstructionNode>>
+selectLowerIRToAsm(IRSelectNode& node);
 } // namespace AsmGen
@@ -1,4 +1,8 @@
 #include <algorithm>
+#include <bit>
+#include <climits>
+#include <cstdint>
+#include <iterator>
 #include <memory>
 #include <stdexcept>
 #include <unordered_map>
@@ -82,9 +86,18 @@ std::unique_ptr<AsmFunctionNode> functionLowerIRToAsm(IRFunctionNode& func) {
         std::make_unique<AsmMovNode>(stack_loc, psedo_reg));
   }
 
-  for (const auto& instr : func.IRInstructions) {
+  auto& ir_instrs = func.IRInstructions;
+  for (auto it = ir_instrs.begin(); it != ir_instrs.end(); ++it) {
     // every IR instruction can emit multiple ASM instructions
-    auto asm_instrs = instructionLowerIRToAsm(instr);
+    std::vector<std::unique_ptr<AsmInstructionNode>> asm_instrs;
+    auto* call = dyn_cast<IRFunctionCallNode>(it->get());
+    if (call && std::next(it) != ir_instrs.end() &&
+        isTailCall(*call, **std::next(it))) {
+      asm_instrs = tailCallLowerIRToAsm(*call);
+      ++it; // the `ret`, the callee returns for us
+    } else {
+      asm_instrs = instructionLowerIRToAsm(*it);
+    }
     for (auto& asm_instr : asm_instrs) {
       asm_func->instructions.push_back(std::move(asm_instr));
     }
@@ -114,10 +127,17 @@ instructionLowerIRToAsm(const std::unique_ptr<IRInstructionNode>& instr) {
     return jumpIfZeroLowerIRToAsm(*node);
   if (auto* node = dyn_cast<IRJumpIfNotZeroNode>(instr.get()))
     return jumpIfNotZeroLowerIRToAsm(*node);
+  if (auto* node = dyn_cast<IRJumpIfCmpNode>(instr.get()))
+    return jumpIfCmpLowerIRToAsm(*node);
   if (auto* node = dyn_cast<IRLabelNode>(instr.get()))
     return labelLowerIRToAsm(*node);
   if (auto* node = dyn_cast<IRFunctionCallNode>(instr.get()))
     return functionCallLowerIRToAsm(*node);
+  if (auto* node = dyn_cast<IRSelectNode>(instr.get()))
+    return selectLowerIRToAsm(*node);
+  if (isa<IRPhiNode>(instr.get()))
+    throw std::runtime_error(
+        "instructionLowerIRToAsm: phi reached codegen, call destructSSA first");
 
   throw std::runtime_error(
       "instructionLowerIRToAsm: unknown IR instruction type");
@@ -175,6 +195,140 @@ unaryLowerIRToAsm(IRUnaryNode& node) {
   return instructions;
 }
 
+namespace {
+/*
+`idiv` takes tens of cycles, so a constant divisor `d` (|d| >= 2, not INT_MIN)
+is divided by with shifts and a multiply instead. For `d = ±2^k` the dividend
+is biased by `2^k - 1` when negative so the arithmetic shift rounds to zero:
+```asm
+movl x, %eax
+movl %eax, %edx
+sarl $31, %edx      # -1 if x < 0, else 0
+shrl $(32-k), %edx  # 2^k - 1 if x < 0, else 0
+addl %eax, %edx
+sarl $k, %edx       # x / 2^k
+negl %edx           # if d < 0
+```
+Any other `d` is multiplied by `M ≈ 2^(32+s) / d` keeping the high half, as in
+Granlund and Montgomery, "Division by Invariant Integers using
+Multiplication" (also Hacker's Delight, 10-4):
+```asm
+movl x, %eax
+imull M             # EDX:EAX = x * M
+addl x, %edx        # if d > 0 and M < 0, `subl` if d < 0 and M > 0
+sarl $s, %edx
+movl %edx, %eax
+shrl $31, %eax
+addl %eax, %edx     # +1 if negative, to round to zero
+```
+`x % d` is then `x - (x / d) * d`.
+*/
+struct DivisionMagic {
+  int multiplier;
+  int shift;
+};
+
+/// @return the magic multiplier and shift for `d`, 2 <= |d| < 2^31
+DivisionMagic getDivisionMagic(int d) {
+  constexpr uint32_t two31 = 0x80000000u;
+  const uint32_t ad = d < 0 ? -static_cast<uint32_t>(d) : d;
+  const uint32_t t = two31 + (static_cast<uint32_t>(d) >> 31);
+  const uint32_t anc = t - 1 - t % ad; // |nc|, the largest `x % d == d-1`
+  int p = 31;
+  uint32_t q1 = two31 / anc, r1 = two31 - q1 * anc; // 2^p / |nc|
+  uint32_t q2 = two31 / ad, r2 = two31 - q2 * ad;   // 2^p / |d|
+  uint32_t delta;
+  do {
+    p++;
+    q1 *= 2, r1 *= 2;
+    if (r1 >= anc)
+      q1++, r1 -= anc;
+    q2 *= 2, r2 *= 2;
+    if (r2 >= ad)
+      q2++, r2 -= ad;
+    delta = ad - r2;
+  } while (q1 < delta || (q1 == delta && r1 == 0));
+
+  uint32_t multiplier = q2 + 1;
+  if (d < 0)
+    multiplier = -multiplier;
+  return {static_cast<int>(multiplier), p - 32};
+}
+
+/// @brief Lowers `x / d` or `x % d` for a constant `d` without `idiv`.
+/// @return false, emitting nothing, if `d` is 0, ±1 or INT_MIN
+bool constDivisionLowerIRToAsm(
+    IRBinaryNode& node,
+    std::vector<std::unique_ptr<AsmInstructionNode>>& instructions) {
+  auto* divisor_const = dyn_cast<IRConstNode>(node.valSrcR.get());
+  if (!divisor_const)
+    return false;
+  const int d = divisor_const->IntVal;
+  if (d == 0 || d == 1 || d == -1 || d == INT_MIN)
+    return false;
+
+  auto eax_reg = std::make_shared<AsmRegisterNode>(getRegString(Reg::eax));
+  auto edx_reg = std::make_shared<AsmRegisterNode>(getRegString(Reg::edx));
+  auto dividend = AsmGen::operandLowerIRToAsm(node.valSrcL);
+  auto dest = AsmGen::operandLowerIRToAsm(node.valDest);
+  const uint32_t ad = d < 0 ? -static_cast<uint32_t>(d) : d;
+  const bool power_of_two = (ad & (ad - 1)) == 0;
+
+  instructions.push_back(std::make_unique<AsmMovNode>(dividend, eax_reg));
+  if (power_of_two) {
+    const int k = std::countr_zero(ad);
+    instructions.push_back(std::make_unique<AsmMovNode>(eax_reg, edx_reg));
+    if (k > 1)
+      instructions.push_back(
+          std::make_unique<AsmShiftNode>("sar", 31, edx_reg));
+    instructions.push_back(
+        std::make_unique<AsmShiftNode>("shr", 32 - k, edx_reg));
+    instructions.push_back(
+        std::make_unique<AsmBinaryNode>(TokenType::PLUS, eax_reg, edx_reg));
+    instructions.push_back(std::make_unique<AsmShiftNode>("sar", k, edx_reg));
+    if (node.opType == TokenType::PERCENT) {
+      // `x % d == x % |d|`: subtract the quotient by |d| scaled back
+      instructions.push_back(std::make_unique<AsmShiftNode>("shl", k, edx_reg));
+      instructions.push_back(
+          std::make_unique<AsmBinaryNode>(TokenType::MINUS, edx_reg, eax_reg));
+      instructions.push_back(std::make_unique<AsmMovNode>(eax_reg, dest));
+      return true;
+    }
+    if (d < 0)
+      instructions.push_back(
+          std::make_unique<AsmUnaryNode>(TokenType::MINUS, edx_reg));
+  } else {
+    const DivisionMagic magic = getDivisionMagic(d);
+    instructions.push_back(std::make_unique<AsmMulHiNode>(
+        std::make_shared<AsmImmediateNode>(magic.multiplier)));
+    if (d > 0 && magic.multiplier < 0)
+      instructions.push_back(
+          std::make_unique<AsmBinaryNode>(TokenType::PLUS, dividend, edx_reg));
+    else if (d < 0 && magic.multiplier > 0)
+      instructions.push_back(
+          std::make_unique<AsmBinaryNode>(TokenType::MINUS, dividend, edx_reg));
+    if (magic.shift > 0)
+      instructions.push_back(
+          std::make_unique<AsmShiftNode>("sar", magic.shift, edx_reg));
+    instructions.push_back(std::make_unique<AsmMovNode>(edx_reg, eax_reg));
+    instructions.push_back(std::make_unique<AsmShiftNode>("shr", 31, eax_reg));
+    instructions.push_back(
+        std::make_unique<AsmBinaryNode>(TokenType::PLUS, eax_reg, edx_reg));
+    if (node.opType == TokenType::PERCENT) {
+      instructions.push_back(std::make_unique<AsmBinaryNode>(
+          TokenType::STAR, std::make_shared<AsmImmediateNode>(d), edx_reg));
+      instructions.push_back(std::make_unique<AsmMovNode>(dividend, eax_reg));
+      instructions.push_back(
+          std::make_unique<AsmBinaryNode>(TokenType::MINUS, edx_reg, eax_reg));
+      instructions.push_back(std::make_unique<AsmMovNode>(eax_reg, dest));
+      return true;
+    }
+  }
+  instructions.push_back(std::make_unique<AsmMovNode>(edx_reg, dest));
+  return true;
+}
+} // namespace
+
 std::vector<std::unique_ptr<AsmInstructionNode>>
 binaryLowerIRToAsm(IRBinaryNode& node) {
   std::vector<std::unique_ptr<AsmInstructionNode>> instructions;
@@ -184,6 +338,8 @@ binaryLowerIRToAsm(IRBinaryNode& node) {
   // separate handling for (+, -, *), (/, %) and (==, !=, <, >, <=, >=
   // {relational ops})
   if (node.opType == TokenType::SLASH || node.opType == TokenType::PERCENT) {
+    if (constDivisionLowerIRToAsm(node, instructions))
+      return instructions;
     auto eax_reg = std::make_shared<AsmRegisterNode>(getRegString(Reg::eax));
     auto src1 = operandLowerIRToAsm(node.valSrcL);
     instructions.push_back(std::make_unique<AsmMovNode>(src1, eax_reg));
@@ -201,9 +357,24 @@ binaryLowerIRToAsm(IRBinaryNode& node) {
              node.opType == TokenType::MINUS ||
              node.opType == TokenType::STAR) {
     auto src1 = operandLowerIRToAsm(node.valSrcL);
-    instructions.push_back(std::make_unique<AsmMovNode>(src1, dest));
-
     auto src2 = operandLowerIRToAsm(node.valSrcR);
+    // `a = b op a` (e.g. after SSA destruction): the mov would clobber the
+    // right operand
+    auto* dest_var = dyn_cast<IRVariableNode>(node.valDest.get());
+    auto* src2_var = dyn_cast<IRVariableNode>(node.valSrcR.get());
+    if (dest_var && src2_var && dest_var->varName == src2_var->varName) {
+      if (node.opType == TokenType::MINUS) { // a = b - a => a = -a + b
+        instructions.push_back(
+            std::make_unique<AsmUnaryNode>(TokenType::MINUS, dest));
+        instructions.push_back(
+            std::make_unique<AsmBinaryNode>(TokenType::PLUS, src1, dest));
+      } else { // commutative
+        instructions.push_back(
+            std::make_unique<AsmBinaryNode>(node.opType, src1, dest));
+      }
+      return instructions;
+    }
+    instructions.push_back(std::make_unique<AsmMovNode>(src1, dest));
     instructions.push_back(
         std::make_unique<AsmBinaryNode>(node.opType, src2, dest));
   } else if (RELATIONAL_OPS.contains(node.opType)) {
@@ -211,11 +382,17 @@ binaryLowerIRToAsm(IRBinaryNode& node) {
     auto src2 = operandLowerIRToAsm(node.valSrcR);
     auto dest = operandLowerIRToAsm(node.valDest);
 
+    // `setcc` writes one byte; set a register and store all four, a `setcc`
+    // to memory stalls the load of the whole value right after it. `mov`
+    // leaves the flags alone, `xor` wouldn't.
+    auto r11_reg = std::make_shared<AsmRegisterNode>(getRegString(Reg::r11d));
     instructions.push_back(std::make_unique<AsmCmpNode>(src2, src1));
     instructions.push_back(std::make_unique<AsmMovNode>(
-        std::make_shared<AsmImmediateNode>(0), dest));
-    instructions.push_back(
-        std::make_unique<AsmSetCCNode>(getCondCode(node.opType), dest));
+        std::make_shared<AsmImmediateNode>(0), r11_reg));
+    instructions.push_back(std::make_unique<AsmSetCCNode>(
+        getCondCode(node.opType),
+        std::make_shared<AsmRegisterNode>(getRegString(Reg::r11b))));
+    instructions.push_back(std::make_unique<AsmMovNode>(r11_reg, dest));
   } else {
     throw std::runtime_error(
         std::format("binaryLowerIRToAsm: Unsupported op_type {}",
@@ -271,6 +448,18 @@ jumpIfNotZeroLowerIRToAsm(IRJumpIfNotZeroNode& node) {
   return emitConditionalJump("ne", node.condition, node.labelName);
 }
 
+/// @brief `cmp` + `jcc`, the comparison never lands in a register
+std::vector<std::unique_ptr<AsmInstructionNode>>
+jumpIfCmpLowerIRToAsm(IRJumpIfCmpNode& node) {
+  std::vector<std::unique_ptr<AsmInstructionNode>> instructions;
+  auto src1 = operandLowerIRToAsm(node.valSrcL);
+  auto src2 = operandLowerIRToAsm(node.valSrcR);
+  instructions.push_back(std::make_unique<AsmCmpNode>(src2, src1));
+  instructions.push_back(
+      std::make_unique<AsmJmpCCNode>(getCondCode(node.opType), node.labelName));
+  return instructions;
+}
+
 std::vector<std::unique_ptr<AsmInstructionNode>>
 labelLowerIRToAsm(IRLabelNode& node) {
   std::vector<std::unique_ptr<AsmInstructionNode>> instructions;
@@ -283,6 +472,37 @@ labelLowerIRToAsm(IRLabelNode& node) {
 ///
 /// function callee: is called by other functions
 /// @return instructions
+/// @return true if `node` may jump to the callee: it's marked `tail`, passes
+/// no arguments on the stack and `next` returns its result
+bool isTailCall(const IRFunctionCallNode& node, const IRInstructionNode& next) {
+  auto* ret = dyn_cast<IRRetNode>(&next);
+  if (!node.tail || node.arguments.size() > 6 || !ret || !ret->retValue)
+    return false;
+  auto* ret_var = dyn_cast<IRVariableNode>(ret->retValue.get());
+  auto* dest = cast<IRVariableNode>(node.returnDest.get());
+  // a static result is stored after the call
+  return ret_var && ret_var->varName == dest->varName &&
+         !nanocc::hasStaticStorage(*dest);
+}
+
+/// @brief The arguments go to their registers and the frame goes before the
+/// `jmp`, our return address becomes the callee's.
+std::vector<std::unique_ptr<AsmInstructionNode>>
+tailCallLowerIRToAsm(IRFunctionCallNode& node) {
+  std::vector<std::unique_ptr<AsmInstructionNode>> instructions;
+  Reg arg_resisters[6] = {Reg::edi, Reg::esi, Reg::edx,
+                          Reg::ecx, Reg::r8d, Reg::r9d};
+  for (size_t i = 0; i < node.arguments.size(); i++) {
+    auto reg_node =
+        std::make_shared<AsmRegisterNode>(getRegString(arg_resisters[i]));
+    instructions.push_back(std::make_unique<AsmMovNode>(
+        operandLowerIRToAsm(node.arguments[i]), reg_node));
+  }
+  instructions.push_back(
+      std::make_unique<AsmCallNode>(node.funcName, /*tail=*/true));
+  return instructions;
+}
+
 std::vector<std::unique_ptr<AsmInstructionNode>>
 functionCallLowerIRToAsm(IRFunctionCallNode& node) {
   std::vector<std::unique_ptr<AsmInstructionNode>> instructions;
@@ -350,6 +570,38 @@ functionCallLowerIRToAsm(IRFunctionCallNode& node) {
 
   return instructions;
 }
+
+/// @brief `cmp` + `mov` of the false value + `cmovcc` of the true one
+std::vector<std::unique_ptr<AsmInstructionNode>>
+selectLowerIRToAsm(IRSelectNode& node) {
+  std::vector<std::unique_ptr<AsmInstructionNode>> instructions;
+  auto isDest = [&](const std::shared_ptr<IRValNode>& val) {
+    auto* var = dyn_cast<IRVariableNode>(val.get());
+    return var &&
+           var->varName == cast<IRVariableNode>(node.valDest.get())->varName;
+  };
+  TokenType op_type = node.opType;
+  auto val_true = node.valTrue;
+  auto val_false = node.valFalse;
+  // `a = select c, a, b`: the mov would clobber the true value
+  if (isDest(val_true)) {
+    std::swap(val_true, val_false);
+    op_type = nanocc::getNegatedComparison(op_type);
+  }
+  if (isDest(val_true)) // `a = select c, a, a`
+    return instructions;
+
+  auto dest = operandLowerIRToAsm(node.valDest);
+  // the comparison first, the mov may overwrite one of its operands
+  instructions.push_back(std::make_unique<AsmCmpNode>(
+      operandLowerIRToAsm(node.valSrcR), operandLowerIRToAsm(node.valSrcL)));
+  if (!isDest(val_false))
+    instructions.push_back(
+        std::make_unique<AsmMovNode>(operandLowerIRToAsm(val_false), dest));
+  instructions.push_back(std::make_unique<AsmCMovNode>(
+      getCondCode(op_type), operandLowerIRToAsm(val_true), dest));
+  return instructions;
+}
 } // namespace AsmGen
 // Emit Assembly Functions -- End
 
@@ -1,110 +1,102 @@
-#include "unordered_map"
+#include <algorithm>
+#include <utility>
+#include <vector>
 
 #include "nanocc/IR/BasicBlock.hpp"
 #include "nanocc/IR/IR.hpp"
 #include "nanocc/Utils/Utils.hpp"
 
 namespace {
-// TODO(VachanVY): Store raw pointer instead of unique pointer...?
-// std::vector<std::deque<std::unique_ptr<IRInstructionNode>>> ==>
-// std::vector<std::deque<IRInstructionNode*>>
-std::vector<std::deque<std::unique_ptr<IRInstructionNode>>> groupIRInstructions(
-    std::list<std::unique_ptr<IRInstructionNode>>& Instructions) {
-  std::vector<std::deque<std::unique_ptr<IRInstructionNode>>> Blocks;
-  std::deque<std::unique_ptr<IRInstructionNode>> currBlock;
+/// @brief A Label starts a new BasicBlock, a Jump<Type>Node or Return ends one.
+void splitIntoBlocks(IRFunctionNode& IRFunc,
+                     std::vector<std::unique_ptr<BasicBlock>>& blocks) {
+  auto& Instructions = IRFunc.IRInstructions;
+  auto startBlock = [&](BasicBlock::InstrIter first) {
+    auto BB = std::make_unique<BasicBlock>();
+    BB->blockId = blocks.size();
+    BB->first = first;
+    BB->last = first;
+    blocks.push_back(std::move(BB));
+  };
 
-  for (auto& IRInstr : Instructions) {
-    // If a Label, it's the start of a new Basic BLock
-    if (isa<IRLabelNode>(IRInstr.get())) {
-      if (!currBlock.empty()) {
-        Blocks.push_back(std::move(currBlock));
-      }
-      currBlock.push_back(std::move(IRInstr));
-    } else if ( // If a Jump<Type>Node, it's the end of the Basic Block
-        isa<IRJumpNode>(IRInstr.get()) ||
-        isa<IRJumpIfZeroNode>(IRInstr.get()) ||
-        isa<IRJumpIfNotZeroNode>(IRInstr.get()) ||
-        isa<IRRetNode>(IRInstr.get())) {
-      currBlock.push_back(std::move(IRInstr));
-      Blocks.push_back(std::move(currBlock)); // currBlock is now empty
-    } else {
-      currBlock.push_back(std::move(IRInstr));
+  bool open = false; // is blocks.back() still accepting instructions
+  for (auto it = Instructions.begin(); it != Instructions.end(); ++it) {
+    IRInstructionNode* IRInstr = it->get();
+    if (isa<IRLabelNode>(IRInstr) || !open) {
+      startBlock(it);
+      open = true;
+    }
+    blocks.back()->last = std::next(it);
+    if (IRInstr->isTerminator()) {
+      open = false;
     }
   }
-  if (!currBlock.empty())
-    Blocks.push_back(std::move(currBlock));
-  return Blocks;
 }
-} // namespace
 
-std::list<std::shared_ptr<BasicBlock>> BasicBlock::getBasicBlocks(
-    std::list<std::unique_ptr<IRInstructionNode>>& Instructions) {
-  std::list<std::shared_ptr<BasicBlock>> BBList;
-  size_t blockId = 0;
-  LabelBBMap::obj().clear();
-  std::vector<std::deque<std::unique_ptr<IRInstructionNode>>> Blocks =
-      groupIRInstructions(Instructions);
-  for (auto& IRInstrGroup : Blocks) {
-    auto BB = std::make_shared<BasicBlock>();
-    BB->IRInstructions = std::move(IRInstrGroup);
-    BB->blockId = blockId++;
-    auto BBIter = BBList.emplace(BBList.end(), BB);
-    auto& FirstIRInstr = BB->IRInstructions.front();
-    if (auto* LabelIRInstr = dyn_cast<IRLabelNode>(FirstIRInstr.get())) {
-      LabelBBMap::obj().insert(LabelIRInstr->labelName, BBIter);
-    }
+void addEdge(BasicBlock* From, BasicBlock* To) {
+  for (auto* Succ : From->successors) {
+    if (Succ == To) // both arms of a conditional jump reach the same block
+      return;
   }
-  return BBList;
+  From->successors.push_back(To);
+  To->predecessors.push_back(From);
 }
+} // namespace
 
-std::vector<BasicBlock::Iter>
-BasicBlock::getSuccessors(BasicBlock::Iter BBIter,
-                          std::list<std::shared_ptr<BasicBlock>>& BBList) {
-  std::vector<BasicBlock::Iter> successors;
-  BasicBlock* BB = (*BBIter).get();
-
-  if (BB->IRInstructions.empty()) {
-    return successors;
+ControlFlowGraph::ControlFlowGraph(IRFunctionNode& IRFunc)
+    : labelToBlock(IRFunc.numLabels, nullptr) {
+  splitIntoBlocks(IRFunc, blocks);
+  for (auto& BB : blocks) {
+    if (auto* Label = BB->getLabel()) {
+      assert(Label->labelId < labelToBlock.size() &&
+             "ControlFlowGraph: label was not numbered");
+      labelToBlock[Label->labelId] = BB.get();
+    }
   }
 
-  IRInstructionNode* BBLastIRInstr = BB->IRInstructions.back().get();
-  if (!BBLastIRInstr || isa<IRRetNode>(BBLastIRInstr)) {
-    return successors;
-  } else if (auto* JumpIRInstr = dyn_cast<IRJumpNode>(BBLastIRInstr)) {
-    if (BasicBlock::Iter* branch =
-            LabelBBMap::obj().find(JumpIRInstr->labelName)) {
-      successors.push_back(*branch);
+  for (auto& BB : blocks) {
+    IRInstructionNode* BBLastIRInstr = BB->back();
+    if (isa<IRRetNode>(BBLastIRInstr)) {
+      continue;
     }
-    return successors;
-  }
-  std::string labelName;
-  if (auto* JumpIfZeroIRInstr = dyn_cast<IRJumpIfZeroNode>(BBLastIRInstr)) {
-    labelName = JumpIfZeroIRInstr->labelName;
-  } else if (auto* JumpIfNotZeroIRInstr =
-                 dyn_cast<IRJumpIfNotZeroNode>(BBLastIRInstr)) {
-    labelName = JumpIfNotZeroIRInstr->labelName;
-  }
-  if (BasicBlock::Iter defaultBranch = std::next(BBIter);
-      defaultBranch != BBList.end())
-    successors.push_back(defaultBranch);
-  if (labelName.size() > 0) {
-    if (BasicBlock::Iter* trueBranch = LabelBBMap::obj().find(labelName)) {
-      successors.push_back(*trueBranch);
+    auto* Branch = dyn_cast<IRBranchNode>(BBLastIRInstr);
+    // fallthrough edge for conditional jumps and blocks cut by a label
+    if (!Branch || Branch->isConditional()) {
+      if (BasicBlock* Next = getLayoutSuccessor(BB.get()))
+        addEdge(BB.get(), Next);
+    }
+    if (Branch) {
+      assert(Branch->labelId < labelToBlock.size() &&
+             "ControlFlowGraph: jump to a label that was not numbered");
+      if (BasicBlock* Target = getBlockForLabel(Branch->labelId))
+        addEdge(BB.get(), Target);
     }
   }
-  return successors;
 }
 
-std::vector<BasicBlock::Iter>
-BasicBlock::getPredecessor(BasicBlock::Iter BBTarget,
-                           std::list<std::shared_ptr<BasicBlock>>& BBList) {
-  std::vector<BasicBlock::Iter> predecessors;
-  for (auto BBIter = BBList.begin(); BBIter != BBList.end(); BBIter++) {
-    for (BasicBlock::Iter BBChild : BasicBlock::getSuccessors(BBIter, BBList)) {
-      if (BBChild == BBTarget) {
-        predecessors.push_back(BBIter);
+// iterative, deep CFGs would overflow the stack otherwise
+std::vector<BasicBlock*> ControlFlowGraph::getReversePostOrder() const {
+  std::vector<BasicBlock*> postOrder;
+  if (empty())
+    return postOrder;
+  std::vector<bool> visited(size(), false);
+  // (block, index of the next successor to visit)
+  std::vector<std::pair<BasicBlock*, size_t>> stack;
+  stack.push_back({getEntry(), 0});
+  visited[getEntry()->blockId] = true;
+  while (!stack.empty()) {
+    auto& [BB, nextSucc] = stack.back();
+    if (nextSucc < BB->successors.size()) {
+      BasicBlock* Succ = BB->successors[nextSucc++];
+      if (!visited[Succ->blockId]) {
+        visited[Succ->blockId] = true;
+        stack.push_back({Succ, 0});
       }
+      continue;
     }
+    postOrder.push_back(BB);
+    stack.pop_back();
   }
-  return predecessors;
+  std::reverse(postOrder.begin(), postOrder.end());
+  return postOrder;
 }
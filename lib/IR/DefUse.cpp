@@ -0,0 +1,159 @@
+#include <cassert>
+#include <unordered_set>
+
+#include "nanocc/IR/DefUse.hpp"
+#include "nanocc/IR/IR.hpp"
+#include "nanocc/Utils/Utils.hpp"
+
+DefUseChains::DefUseChains(IRFunctionNode& IRFunc) : IRFunc(IRFunc) {
+  auto& Instructions = IRFunc.IRInstructions;
+  for (auto it = Instructions.begin(); it != Instructions.end(); ++it) {
+    registerInstruction(it);
+  }
+}
+
+bool DefUseChains::isTracked(const IRValNode* val) {
+  return isa<IRVariableNode>(val) && !nanocc::hasStaticStorage(*val);
+}
+
+DefUseChains::ValueInfo*
+DefUseChains::lookupValue(const std::shared_ptr<IRValNode>& val) {
+  if (!isTracked(val.get()))
+    return nullptr;
+  return &values[cast<IRVariableNode>(val.get())->varName];
+}
+
+const std::vector<DefUseChains::Use>&
+DefUseChains::getUses(const std::string& var) const {
+  static const std::vector<Use> NoUses;
+  auto it = values.find(var);
+  return it == values.end() ? NoUses : it->second.uses;
+}
+
+IRInstructionNode* DefUseChains::getDef(const std::string& var) const {
+  auto it = values.find(var);
+  if (it == values.end() || it->second.numDefs != 1)
+    return nullptr;
+  return it->second.def;
+}
+
+IRValSlot DefUseChains::getSlot(const Use& U) const {
+  return instrs.at(U.user).operands[U.operandNo].slot;
+}
+
+DefUseChains::InstrIter
+DefUseChains::getPosition(IRInstructionNode* IRInstr) const {
+  return instrs.at(IRInstr).pos;
+}
+
+void DefUseChains::addUse(IRInstructionNode* user, size_t operandNo,
+                          ValueInfo* value) {
+  Operand& Op = instrs.at(user).operands[operandNo];
+  Op.value = value;
+  if (!value)
+    return;
+  Op.useIdx = value->uses.size();
+  value->uses.push_back({user, operandNo});
+}
+
+// swap with the last use, O(1)
+void DefUseChains::removeUse(const Operand& Op) {
+  if (!Op.value)
+    return;
+  auto& Uses = Op.value->uses;
+  size_t idx = Op.useIdx;
+  if (idx + 1 != Uses.size()) {
+    Uses[idx] = Uses.back();
+    instrs.at(Uses[idx].user).operands[Uses[idx].operandNo].useIdx = idx;
+  }
+  Uses.pop_back();
+}
+
+void DefUseChains::registerInstruction(InstrIter pos) {
+  IRInstructionNode* IRInstr = pos->get();
+  auto& Info = instrs[IRInstr];
+  Info.pos = pos;
+  auto Slots = IRInstr->operands();
+  Info.operands.resize(Slots.size());
+  for (size_t i = 0; i < Slots.size(); i++) {
+    Info.operands[i].slot = Slots[i];
+    addUse(IRInstr, i, lookupValue(*Slots[i]));
+  }
+  if (IRValSlot Result = IRInstr->result()) {
+    if (ValueInfo* Def = lookupValue(*Result)) {
+      Info.def = Def;
+      Def->def = IRInstr;
+      Def->numDefs++;
+    }
+  }
+}
+
+void DefUseChains::unregisterInstruction(IRInstructionNode* IRInstr) {
+  auto it = instrs.find(IRInstr);
+  assert(it != instrs.end() && "DefUseChains: unknown instruction");
+  for (auto& Op : it->second.operands) {
+    removeUse(Op);
+  }
+  if (ValueInfo* Def = it->second.def) {
+    Def->numDefs--;
+    if (Def->def == IRInstr)
+      Def->def = nullptr;
+  }
+  instrs.erase(it);
+}
+
+std::vector<IRInstructionNode*>
+DefUseChains::replaceAllUsesWith(const std::string& var,
+                                 const std::shared_ptr<IRValNode>& val) {
+  std::vector<IRInstructionNode*> users;
+  auto it = values.find(var);
+  if (it == values.end())
+    return users;
+  ValueInfo& From = it->second;
+  ValueInfo* To = lookupValue(val);
+  if (To == &From)
+    return users;
+  auto Uses = std::move(From.uses);
+  From.uses.clear();
+  // an instruction may use `var` more than once
+  std::unordered_set<IRInstructionNode*> seen;
+  for (auto& U : Uses) {
+    *instrs.at(U.user).operands[U.operandNo].slot = val;
+    addUse(U.user, U.operandNo, To);
+    if (seen.insert(U.user).second)
+      users.push_back(U.user);
+  }
+  return users;
+}
+
+void DefUseChains::setOperand(IRInstructionNode* user, size_t operandNo,
+                              std::shared_ptr<IRValNode> val) {
+  Operand& Op = instrs.at(user).operands[operandNo];
+  removeUse(Op);
+  ValueInfo* To = lookupValue(val);
+  *Op.slot = std::move(val);
+  addUse(user, operandNo, To);
+}
+
+IRInstructionNode*
+DefUseChains::insert(InstrIter pos, std::unique_ptr<IRInstructionNode> IRInstr) {
+  auto it = IRFunc.IRInstructions.insert(pos, std::move(IRInstr));
+  registerInstruction(it);
+  return it->get();
+}
+
+IRInstructionNode*
+DefUseChains::replace(IRInstructionNode* Old,
+                      std::unique_ptr<IRInstructionNode> NewInstr) {
+  InstrIter pos = getPosition(Old);
+  unregisterInstruction(Old);
+  *pos = std::move(NewInstr);
+  registerInstruction(pos);
+  return pos->get();
+}
+
+void DefUseChains::erase(IRInstructionNode* IRInstr) {
+  InstrIter pos = getPosition(IRInstr);
+  unregisterInstruction(IRInstr);
+  IRFunc.IRInstructions.erase(pos);
+}
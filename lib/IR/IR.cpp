@@ -2,10 +2,78 @@
 
 #include "nanocc/IR/IR.hpp"
 #include "nanocc/IR/IRDump.hpp"
+#include "nanocc/Sema/Sema.hpp"
+#include "nanocc/Utils/Utils.hpp"
 
 #include "IRHelper.hpp"
 
+std::unique_ptr<IRLabelNode>
+IRFunctionNode::createLabel(const std::string& prefix) {
+  std::string name = prefix + "." + funcName + "." + std::to_string(numLabels);
+  return std::make_unique<IRLabelNode>(std::move(name), numLabels++);
+}
+
+std::string IRFunctionNode::createName(const std::string& prefix) {
+  return prefix + "." + funcName + "." + std::to_string(numNames++);
+}
+
 namespace nanocc {
+bool hasStaticStorage(const IRValNode& val) {
+  auto* var = dyn_cast<IRVariableNode>(&val);
+  if (!var)
+    return false;
+  // `find`, not `operator[]`, which would insert IR temporaries
+  auto it = global_type_checker_map.find(var->varName);
+  return it != global_type_checker_map.end() &&
+         std::holds_alternative<StaticAttr>(it->second.attrs);
+}
+
+bool isComparison(TokenType opType) {
+  switch (opType) {
+  case TokenType::LESSTHAN:
+  case TokenType::LESS_EQUAL:
+  case TokenType::GREATERTHAN:
+  case TokenType::GREATER_EQUAL:
+  case TokenType::EQUAL:
+  case TokenType::NOT_EQUAL:
+    return true;
+  default:
+    return false;
+  }
+}
+
+TokenType getSwappedComparison(TokenType opType) {
+  switch (opType) {
+  case TokenType::LESSTHAN:
+    return TokenType::GREATERTHAN;
+  case TokenType::GREATERTHAN:
+    return TokenType::LESSTHAN;
+  case TokenType::LESS_EQUAL:
+    return TokenType::GREATER_EQUAL;
+  case TokenType::GREATER_EQUAL:
+    return TokenType::LESS_EQUAL;
+  default:
+    return opType; // == and !=
+  }
+}
+
+TokenType getNegatedComparison(TokenType opType) {
+  switch (opType) {
+  case TokenType::LESSTHAN:
+    return TokenType::GREATER_EQUAL;
+  case TokenType::GREATER_EQUAL:
+    return TokenType::LESSTHAN;
+  case TokenType::LESS_EQUAL:
+    return TokenType::GREATERTHAN;
+  case TokenType::GREATERTHAN:
+    return TokenType::LESS_EQUAL;
+  case TokenType::EQUAL:
+    return TokenType::NOT_EQUAL;
+  default:
+    return TokenType::EQUAL;
+  }
+}
+
 std::unique_ptr<IRProgramNode> generateIntermRepr(const ProgramNode& ast,
                                                   bool debug) {
   auto interm_repr = IRGen::programNodeIRGen(ast);
@@ -105,6 +105,14 @@ void jumpIfNotZeroNodeIRDump(const IRJumpIfNotZeroNode& jump_node, int indent) {
   std::println("jump_if_true {}, {}", cond, jump_node.labelName);
 }
 
+void jumpIfCmpNodeIRDump(const IRJumpIfCmpNode& jump_node, int indent) {
+  printIndent(indent);
+  std::string src1 = valNodeIRDump(*jump_node.valSrcL);
+  std::string src2 = valNodeIRDump(*jump_node.valSrcR);
+  std::println("jump_if {} {} {}, {}", src1,
+               tokenTypeToString(jump_node.opType), src2, jump_node.labelName);
+}
+
 void labelNodeIRDump(const IRLabelNode& label_node, int indent) {
   assert(indent > 0);
   printIndent(indent - 1);
@@ -114,8 +122,8 @@ void labelNodeIRDump(const IRLabelNode& label_node, int indent) {
 void functionCallNodeIRDump(const IRFunctionCallNode& func_call_node,
                             int indent) {
   printIndent(indent);
-  std::print("{} = {}(", valNodeIRDump(*func_call_node.returnDest),
-             func_call_node.funcName);
+  std::print("{} = {}{}(", valNodeIRDump(*func_call_node.returnDest),
+             func_call_node.tail ? "tail " : "", func_call_node.funcName);
   for (size_t i = 0; i < func_call_node.arguments.size(); ++i) {
     std::print("{}", valNodeIRDump(*func_call_node.arguments[i]));
     if (i < func_call_node.arguments.size() - 1) {
@@ -125,6 +133,28 @@ void functionCallNodeIRDump(const IRFunctionCallNode& func_call_node,
   std::println(")");
 }
 
+void selectNodeIRDump(const IRSelectNode& select_node, int indent) {
+  printIndent(indent);
+  std::string dest = valNodeIRDump(*select_node.valDest);
+  std::string src1 = valNodeIRDump(*select_node.valSrcL);
+  std::string src2 = valNodeIRDump(*select_node.valSrcR);
+  std::println("{} = select {} {} {}, {}, {}", dest, src1,
+               tokenTypeToString(select_node.opType), src2,
+               valNodeIRDump(*select_node.valTrue),
+               valNodeIRDump(*select_node.valFalse));
+}
+
+void phiNodeIRDump(const IRPhiNode& phi_node, int indent) {
+  printIndent(indent);
+  std::print("{} = phi", valNodeIRDump(*phi_node.valDest));
+  for (size_t i = 0; i < phi_node.incoming.size(); ++i) {
+    std::print("{} [{}, {}]", i == 0 ? "" : ",",
+               valNodeIRDump(*phi_node.incoming[i].value),
+               phi_node.incoming[i].labelName);
+  }
+  std::println();
+}
+
 std::string valNodeIRDump(const IRValNode& val_node) {
   if (auto node = dyn_cast<IRConstNode>(&val_node)) {
     return std::to_string(node->IntVal);
@@ -150,10 +180,16 @@ void instructionNodeIRDump(const IRInstructionNode& instr_node, int indent) {
   } else if (auto jump_if_not_zero_node =
                  dyn_cast<IRJumpIfNotZeroNode>(&instr_node)) {
     jumpIfNotZeroNodeIRDump(*jump_if_not_zero_node, indent);
+  } else if (auto jump_if_cmp_node = dyn_cast<IRJumpIfCmpNode>(&instr_node)) {
+    jumpIfCmpNodeIRDump(*jump_if_cmp_node, indent);
   } else if (auto label_node = dyn_cast<IRLabelNode>(&instr_node)) {
     labelNodeIRDump(*label_node, indent);
   } else if (auto func_call_node = dyn_cast<IRFunctionCallNode>(&instr_node)) {
     functionCallNodeIRDump(*func_call_node, indent);
+  } else if (auto select_node = dyn_cast<IRSelectNode>(&instr_node)) {
+    selectNodeIRDump(*select_node, indent);
+  } else if (auto phi_node = dyn_cast<IRPhiNode>(&instr_node)) {
+    phiNodeIRDump(*phi_node, indent);
   } else {
     throw std::runtime_error("IR Dump Error: Unknown IRInstructionNode type");
   }
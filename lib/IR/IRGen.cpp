@@ -16,6 +16,7 @@ use shared_ptr for IRValNode (and its derived classes)
 #include <memory>
 #include <print>
 #include <string>
+#include <unordered_map>
 #include <utility>
 
 #include "IRHelper.hpp"
@@ -32,6 +33,30 @@ void extendInstrFromVector(
     dest.push_back(std::move(instr));
   }
 }
+
+/// @brief Give every label of the function a dense id and point every jump at
+/// it. This is the only place where labels are resolved by name, everything
+/// after IR generation works with `labelId`.
+void numberLabels(IRFunctionNode& ir_function) {
+  std::unordered_map<std::string, size_t> label_ids;
+  for (auto& instr : ir_function.IRInstructions) {
+    if (auto* label = dyn_cast<IRLabelNode>(instr.get())) {
+      label->labelId = ir_function.numLabels++;
+      label_ids.emplace(label->labelName, label->labelId);
+    }
+  }
+  for (auto& instr : ir_function.IRInstructions) {
+    if (auto* branch = dyn_cast<IRBranchNode>(instr.get())) {
+      auto it = label_ids.find(branch->labelName);
+      if (it == label_ids.end()) {
+        throw std::runtime_error(std::format(
+            "IR Generation Error: jump to undefined label '{}' in '{}'",
+            branch->labelName, ir_function.funcName));
+      }
+      branch->labelId = it->second;
+    }
+  }
+}
 } // namespace
 
 namespace IRGen {
@@ -124,6 +149,7 @@ functionDeclNodeIRGen(const FunctionDeclNode& function) {
   for (const auto& param : function.parameters) {
     ir_function->parameters.push_back(param->name);
   }
+  numberLabels(*ir_function);
 
   return ir_function;
 }
@@ -246,11 +272,9 @@ ifElseNodeIRGen(const IfElseNode& ifelse_stmt) {
   std::string end_else_label =
       getLabelName(!ifelse_stmt.else_block ? "end" : "else");
 
-  auto cond_var = exprNodeIRGen(*ifelse_stmt.condition, ir_instructions);
   // if condition is false, jump to else / end
-  auto jumpifzero =
-      std::make_unique<IRJumpIfZeroNode>(cond_var, end_else_label);
-  ir_instructions.push_back(std::move(jumpifzero));
+  conditionIRGen(*ifelse_stmt.condition, false, end_else_label,
+                 ir_instructions);
 
   // emit if block instructions
   extendInstrFromVector(statementNodeIRGen(*ifelse_stmt.if_block),
@@ -304,32 +328,47 @@ continueNodeIRGen(const ContinueNode& continue_stmt) {
 /* ```
 while (<condition>) {
     <body>; // can have break/continue
-    // continue will jump here; will go to <condition> check anyway
-    // so we will use start and continue as same label
+    // continue will jump here
 }
 // break will jump here
+```
+rotated into a guarded do-while, so an iteration runs one branch instead of a
+conditional exit plus a jump back:
+<condition> // jump to break if false
+start:
+    <body>
+continue:
+    <condition> // jump to start if true
+break:
+The jump back to start is a critical edge: it leaves a block that also falls
+through to break and enters one the guard falls through to. Out of SSA form,
+the copies of values carried around the loop go above it, or into a block of
+their own when the test or the code after break still reads what they
+overwrite (see destructSSA).
 ``` */
 std::list<std::unique_ptr<IRInstructionNode>>
 whileNodeIRGen(const WhileNode& while_stmt) {
   std::list<std::unique_ptr<IRInstructionNode>> ir_instructions;
 
-  // start/continue Label
-  std::string start_cont_str = "continue_" + while_stmt.label->name;
-  auto continue_label = std::make_unique<IRLabelNode>(start_cont_str);
-  ir_instructions.push_back(std::move(continue_label));
-
-  // condition instructions // jump to break if condition false
-  auto cond_var = exprNodeIRGen(*while_stmt.condition, ir_instructions);
+  // guard // jump to break if condition false
   std::string break_str = "break_" + while_stmt.label->name;
-  auto jump_if_zero = std::make_unique<IRJumpIfZeroNode>(cond_var, break_str);
-  ir_instructions.push_back(std::move(jump_if_zero));
+  conditionIRGen(*while_stmt.condition, false, break_str, ir_instructions);
+
+  // start Label
+  std::string start_str = "start_" + while_stmt.label->name;
+  auto start_label = std::make_unique<IRLabelNode>(start_str);
+  ir_instructions.push_back(std::move(start_label));
 
   // body instructions
   extendInstrFromVector(statementNodeIRGen(*while_stmt.body), ir_instructions);
 
-  // jump back to start/continue
-  auto jump_to_continue = std::make_unique<IRJumpNode>(start_cont_str);
-  ir_instructions.push_back(std::move(jump_to_continue));
+  // continue label
+  std::string continue_str = "continue_" + while_stmt.label->name;
+  auto continue_label = std::make_unique<IRLabelNode>(continue_str);
+  ir_instructions.push_back(std::move(continue_label));
+
+  // condition instructions, generated again // jump to start if condition true
+  conditionIRGen(*while_stmt.condition, true, start_str, ir_instructions);
 
   // break label
   auto break_label = std::make_unique<IRLabelNode>(break_str);
@@ -364,10 +403,7 @@ doWhileNodeIRGen(const DoWhileNode& dowhile_stmt) {
   ir_instructions.push_back(std::move(continue_label));
 
   // condition instructions // jump to start if condition true
-  auto cond_var = exprNodeIRGen(*dowhile_stmt.condition, ir_instructions);
-  auto jump_if_not_zero =
-      std::make_unique<IRJumpIfNotZeroNode>(cond_var, start_str);
-  ir_instructions.push_back(std::move(jump_if_not_zero));
+  conditionIRGen(*dowhile_stmt.condition, true, start_str, ir_instructions);
 
   // break label
   std::string break_str = "break_" + dowhile_stmt.label->name;
@@ -382,10 +418,13 @@ for(<init>; <condition>; <post>) {
     <body>; // can have break/continue
     // continue will jump here; will go to <post> anyway
 }
+rotated like `while`, no guard and an unconditional jump back when there is
+no condition:
 <init>
-<condition> <--, // jump to break_label if false
-<body>         | continue_label after <body>
-<post> --------' break_label    after <post>
+<condition> // jump to break_label if false
+<body> <-----. start_label before <body>
+<post>       | continue_label before <post>
+<condition> -' break_label after the jump back
 ``` */
 std::list<std::unique_ptr<IRInstructionNode>>
 forNodeIRGen(const ForNode& for_stmt) {
@@ -394,21 +433,17 @@ forNodeIRGen(const ForNode& for_stmt) {
   // init
   extendInstrFromVector(forInitNodeIRGen(*for_stmt.init), ir_instructions);
 
+  // guard // jump to break if condition false
+  std::string break_str = "break_" + for_stmt.label->name;
+  if (for_stmt.condition) {
+    conditionIRGen(*for_stmt.condition, false, break_str, ir_instructions);
+  }
+
   // start
   std::string start_str = "start_" + for_stmt.label->name;
   auto start_label = std::make_unique<IRLabelNode>(start_str);
   ir_instructions.push_back(std::move(start_label));
 
-  // condition instructions // jump to break if condition false
-  // else if no condition => always true (use a non-zero constant 69; no jump
-  // needed)
-  std::string break_str = "break_" + for_stmt.label->name;
-  if (for_stmt.condition) {
-    auto cond_var = exprNodeIRGen(*for_stmt.condition, ir_instructions);
-    auto jump_if_zero = std::make_unique<IRJumpIfZeroNode>(cond_var, break_str);
-    ir_instructions.push_back(std::move(jump_if_zero));
-  }
-
   // body instructions // can have break/continue
   // if continue is there here, will jump just before post instructions
   extendInstrFromVector(statementNodeIRGen(*for_stmt.body), ir_instructions);
@@ -423,9 +458,14 @@ forNodeIRGen(const ForNode& for_stmt) {
     auto post_var = exprNodeIRGen(*for_stmt.post, ir_instructions);
   }
 
-  // jump
-  auto jump_to_start = std::make_unique<IRJumpNode>(start_str);
-  ir_instructions.push_back(std::move(jump_to_start));
+  // condition instructions, generated again // jump to start if condition true
+  // else if no condition => always true, jump back unconditionally
+  if (for_stmt.condition) {
+    conditionIRGen(*for_stmt.condition, true, start_str, ir_instructions);
+  } else {
+    auto jump_to_start = std::make_unique<IRJumpNode>(start_str);
+    ir_instructions.push_back(std::move(jump_to_start));
+  }
 
   // break label
   auto break_label = std::make_unique<IRLabelNode>(break_str);
@@ -476,7 +516,8 @@ handleOtherBinOps(const BinaryNode* binop,
   return val_dest;
 }
 
-/// @brief handle short-circuiting binary operations (&&, ||)
+/// @brief handle short-circuiting binary operations (&&, ||) whose value is
+/// used; the operands are lowered as conditions, only the result is 0/1
 /// @param binop
 /// @param instructions
 /// @return result variable holding the final value of the operation
@@ -490,43 +531,89 @@ std::shared_ptr<IRValNode> handleShortCircuitOps(
   std::string short_label = getLabelName("short");
   std::string end_label = getLabelName("end");
 
-  bool is_and = (binop->op_type == TokenType::AND);
-
-  auto left_val = exprNodeIRGen(*binop->left_expr, instructions);
-  // jump to short-circuit if left determines the result
-  if (is_and) {
-    instructions.push_back(
-        std::make_unique<IRJumpIfZeroNode>(left_val, short_label));
-  } else {
-    instructions.push_back(
-        std::make_unique<IRJumpIfNotZeroNode>(left_val, short_label));
-  }
-
-  auto right_val = exprNodeIRGen(*binop->right_expr, instructions);
-  // jump to short-circuit if right determines the result
-  if (is_and) {
-    instructions.push_back(
-        std::make_unique<IRJumpIfZeroNode>(right_val, short_label));
-  } else {
-    instructions.push_back(
-        std::make_unique<IRJumpIfNotZeroNode>(right_val, short_label));
-  }
+  // jump to short-circuit as soon as the operation is known to be false
+  conditionFactorIRGen(*binop, false, short_label, instructions);
 
-  // both conditions passed: AND is true, OR is false
   instructions.push_back(std::make_unique<IRCopyNode>(
-      std::make_shared<IRConstNode>(is_and ? 1 : 0), result));
+      std::make_shared<IRConstNode>(1), result));
   instructions.push_back(std::make_unique<IRJumpNode>(end_label));
 
-  // short-circuit label: AND is false, OR is true
   instructions.push_back(std::make_unique<IRLabelNode>(short_label));
   instructions.push_back(std::make_unique<IRCopyNode>(
-      std::make_shared<IRConstNode>(is_and ? 0 : 1), result));
+      std::make_shared<IRConstNode>(0), result));
 
   instructions.push_back(std::make_unique<IRLabelNode>(end_label));
   return result;
 }
 } // namespace
 
+/* ```
+if (a < b && c) <body>
+```
+A condition is never computed into a 0/1 temporary just to be tested again;
+it is lowered straight to the jumps it decides:
+jump_if a >= b, end    // `&&` is false as soon as an operand is
+jump_if_false c, end
+<body>
+end:
+`!` swaps which outcome jumps, any other expression is computed and tested
+against 0. */
+void conditionIRGen(
+    const ExprNode& cond, bool jump_if, const std::string& label,
+    std::list<std::unique_ptr<IRInstructionNode>>& instructions) {
+  assert(cond.left_exprf && "IR Generation Error: Malformed Expression");
+  conditionFactorIRGen(*cond.left_exprf, jump_if, label, instructions);
+}
+
+/// @brief Jump to `label` if `condf` evaluates to `jump_if`, fall through
+/// otherwise.
+void conditionFactorIRGen(
+    const ExprFactorNode& condf, bool jump_if, const std::string& label,
+    std::list<std::unique_ptr<IRInstructionNode>>& instructions) {
+  if (auto* binop = dyn_cast<BinaryNode>(&condf)) {
+    if (binop->op_type == TokenType::AND || binop->op_type == TokenType::OR) {
+      bool is_and = (binop->op_type == TokenType::AND);
+      if (jump_if != is_and) {
+        // `&&` is false if either operand is, `||` true if either is
+        conditionIRGen(*binop->left_expr, jump_if, label, instructions);
+        conditionIRGen(*binop->right_expr, jump_if, label, instructions);
+        return;
+      }
+      // the left operand alone can only decide the other outcome, skip the
+      // right one then
+      std::string short_label = getLabelName("short");
+      conditionIRGen(*binop->left_expr, !jump_if, short_label, instructions);
+      conditionIRGen(*binop->right_expr, jump_if, label, instructions);
+      instructions.push_back(std::make_unique<IRLabelNode>(short_label));
+      return;
+    }
+    if (nanocc::isComparison(binop->op_type)) {
+      auto left_val = exprNodeIRGen(*binop->left_expr, instructions);
+      auto right_val = exprNodeIRGen(*binop->right_expr, instructions);
+      TokenType op_type = jump_if
+                              ? binop->op_type
+                              : nanocc::getNegatedComparison(binop->op_type);
+      instructions.push_back(std::make_unique<IRJumpIfCmpNode>(
+          op_type, left_val, right_val, label));
+      return;
+    }
+  } else if (condf.unary && condf.unary->op_type == TokenType::NOT) {
+    conditionFactorIRGen(*condf.unary->operand, !jump_if, label, instructions);
+    return;
+  } else if (condf.expr) {
+    conditionIRGen(*condf.expr, jump_if, label, instructions);
+    return;
+  }
+
+  auto cond_val = exprFactorNodeIRGen(condf, instructions);
+  if (jump_if) {
+    instructions.push_back(
+        std::make_unique<IRJumpIfNotZeroNode>(cond_val, label));
+  } else {
+    instructions.push_back(std::make_unique<IRJumpIfZeroNode>(cond_val, label));
+  }
+}
+
 std::shared_ptr<IRValNode> exprFactorNodeIRGen(
     const ExprFactorNode& exprf,
     std::list<std::unique_ptr<IRInstructionNode>>& instructions) {
@@ -612,10 +699,8 @@ std::shared_ptr<IRValNode> conditionalNodeIRGen(
   auto result = std::make_shared<IRVariableNode>(getUniqueName("tmp"));
 
   // eval condition
-  auto cond_val = exprNodeIRGen(*condop->condition, instructions);
   std::string else_label = getLabelName("else_branch");
-  instructions.push_back(
-      std::make_unique<IRJumpIfZeroNode>(cond_val, else_label));
+  conditionIRGen(*condop->condition, false, else_label, instructions);
 
   // if true
   auto true_val = exprNodeIRGen(*condop->true_expr, instructions);
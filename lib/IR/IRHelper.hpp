@@ -2,6 +2,7 @@
 
 #include <list>
 #include <memory>
+#include <string>
 
 #include "nanocc/IR/IR.hpp"
 
@@ -30,6 +31,13 @@ IRInstructionList forNodeIRGen(const ForNode& for_stmt);
 IRInstructionList nullNodeIRGen(const NullNode& null_stmt);
 IRInstructionList forInitNodeIRGen(const ForInitNode& init);
 
+// conditions, lowered to jumps instead of 0/1 values
+void conditionIRGen(const ExprNode& cond, bool jump_if,
+                    const std::string& label, IRInstructionList& instructions);
+void conditionFactorIRGen(const ExprFactorNode& condf, bool jump_if,
+                          const std::string& label,
+                          IRInstructionList& instructions);
+
 // expr nodes
 std::shared_ptr<IRValNode> exprNodeIRGen(const ExprNode& expr,
                                          IRInstructionList& instructions);
@@ -0,0 +1,910 @@
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "nanocc/IR/BasicBlock.hpp"
+#include "nanocc/IR/IR.hpp"
+#include "nanocc/IR/SSA.hpp"
+#include "nanocc/Utils/Utils.hpp"
+
+/*
+Construction (Braun et al.):
+    readVariable(v, BB)  -> local definition if there is one, else
+      - BB has no predecessors : the variable itself (parameter / undefined)
+      - BB is unreachable      : the same, ends cycles of unreachable blocks
+      - BB not sealed          : incomplete phi, operands added on sealing
+      - one predecessor        : readVariable(v, pred)
+      - otherwise              : phi with readVariable(v, pred) per pred
+    Phis whose operands are all the same value (or the phi itself) are
+    replaced by that value until none is left.
+
+Destruction:
+    1. liveness + interference on the SSA values
+    2. union-find coalescing: versions with their original variable first,
+       then phi destinations with their operands
+    3. phi operands that didn't coalesce become copies, the copies of one edge
+       form a parallel copy that is sequentialized:
+       - at the end of the predecessor if the edge is its only successor
+       - else before its conditional jump if the other successor reads none
+         of the destinations
+       - else the edge is split: a block right after the jump for the
+         fallthrough edge, a block at the end of the function the jump is
+         redirected to for the other one
+    4. every value is renamed to its class representative, self copies and
+       phis are dropped
+*/
+
+namespace {
+using ValuePtr = std::shared_ptr<IRValNode>;
+
+/// @return name of `val` if it is a variable that gets renamed into SSA form
+const std::string* getSSAName(const ValuePtr& val) {
+  auto* Var = dyn_cast<IRVariableNode>(val.get());
+  if (!Var || nanocc::hasStaticStorage(*Var))
+    return nullptr;
+  return &Var->varName;
+}
+
+bool isSameValue(const IRValNode* A, const IRValNode* B) {
+  if (auto* ConstA = dyn_cast<IRConstNode>(A)) {
+    auto* ConstB = dyn_cast<IRConstNode>(B);
+    return ConstB && ConstA->IntVal == ConstB->IntVal;
+  }
+  auto* VarA = dyn_cast<IRVariableNode>(A);
+  auto* VarB = dyn_cast<IRVariableNode>(B);
+  return VarA && VarB && VarA->varName == VarB->varName;
+}
+
+/// @brief phis refer to their predecessors by label, so every block needs one,
+/// and the entry block must not be a jump target (its phis would have no
+/// place for the incoming parameters).
+void labelAllBlocks(IRFunctionNode& IRFunc) {
+  ControlFlowGraph CFG(IRFunc);
+  if (CFG.empty())
+    return;
+  for (auto& BB : CFG.blocks) {
+    if (BB->blockId != 0 && !BB->getLabel())
+      IRFunc.IRInstructions.insert(BB->begin(), IRFunc.createLabel("bb"));
+  }
+  BasicBlock* Entry = CFG.getEntry();
+  if (!Entry->getLabel() || !Entry->predecessors.empty())
+    IRFunc.IRInstructions.push_front(IRFunc.createLabel("entry"));
+}
+
+class SSABuilder {
+  IRFunctionNode& IRFunc;
+  ControlFlowGraph CFG;
+  /// @brief per block: variable => its SSA value at the end of the block
+  std::vector<std::unordered_map<std::string, ValuePtr>> currentDef;
+  std::vector<std::vector<std::pair<std::string, IRPhiNode*>>> incompletePhis;
+  std::vector<bool> sealed;
+  std::vector<bool> filled;
+  std::vector<bool> reachable;
+  std::vector<IRPhiNode*> phis;
+
+public:
+  explicit SSABuilder(IRFunctionNode& IRFunc)
+      : IRFunc(IRFunc), CFG(IRFunc), currentDef(CFG.size()),
+        incompletePhis(CFG.size()), sealed(CFG.size(), false),
+        filled(CFG.size(), false), reachable(CFG.size(), false) {
+    for (auto* BB : CFG.getReversePostOrder()) {
+      reachable[BB->blockId] = true;
+    }
+  }
+
+  void run() {
+    for (auto& BB : CFG.blocks) {
+      trySealBlock(BB.get());
+      fillBlock(BB.get());
+      filled[BB->blockId] = true;
+      for (auto* Succ : BB->successors) {
+        trySealBlock(Succ);
+      }
+    }
+    // every block is filled now; seals the ones only reached by back edges
+    // from unreachable code
+    for (auto& BB : CFG.blocks) {
+      trySealBlock(BB.get());
+    }
+    removeTrivialPhis();
+  }
+
+private:
+  ValuePtr newVersion(const std::string& var) {
+    std::string name = IRFunc.createName(var);
+    IRFunc.ssaOrigin[name] = var;
+    return std::make_shared<IRVariableNode>(name);
+  }
+
+  IRPhiNode* newPhi(const std::string& var, BasicBlock* BB) {
+    auto Phi = std::make_unique<IRPhiNode>(newVersion(var));
+    IRPhiNode* PhiPtr = Phi.get();
+    // right after the label, every block has one by now
+    IRFunc.IRInstructions.insert(std::next(BB->begin()), std::move(Phi));
+    phis.push_back(PhiPtr);
+    return PhiPtr;
+  }
+
+  void writeVariable(const std::string& var, BasicBlock* BB, ValuePtr val) {
+    currentDef[BB->blockId][var] = std::move(val);
+  }
+
+  ValuePtr readVariable(const std::string& var, BasicBlock* BB) {
+    auto& Defs = currentDef[BB->blockId];
+    if (auto it = Defs.find(var); it != Defs.end())
+      return it->second;
+    return readVariableRecursive(var, BB);
+  }
+
+  ValuePtr readVariableRecursive(const std::string& var, BasicBlock* BB) {
+    ValuePtr val;
+    if (!reachable[BB->blockId] || BB->predecessors.empty()) {
+      // entry block or unreachable code: the value the function starts with
+      val = std::make_shared<IRVariableNode>(var);
+    } else if (!sealed[BB->blockId]) {
+      // not all predecessors are known yet
+      IRPhiNode* Phi = newPhi(var, BB);
+      incompletePhis[BB->blockId].push_back({var, Phi});
+      val = Phi->valDest;
+    } else if (BB->predecessors.size() == 1) {
+      val = readVariable(var, BB->predecessors.front());
+    } else {
+      // the phi is written before its operands are read to break cycles
+      IRPhiNode* Phi = newPhi(var, BB);
+      writeVariable(var, BB, Phi->valDest);
+      addPhiOperands(var, Phi, BB);
+      val = Phi->valDest;
+    }
+    writeVariable(var, BB, val);
+    return val;
+  }
+
+  void addPhiOperands(const std::string& var, IRPhiNode* Phi,
+                      BasicBlock* BB) {
+    for (auto* Pred : BB->predecessors) {
+      IRLabelNode* PredLabel = Pred->getLabel();
+      Phi->incoming.push_back(
+          {readVariable(var, Pred), PredLabel->labelName, PredLabel->labelId});
+    }
+  }
+
+  /// @brief A block is sealed once all of its predecessors are filled
+  void trySealBlock(BasicBlock* BB) {
+    if (sealed[BB->blockId])
+      return;
+    for (auto* Pred : BB->predecessors) {
+      if (!filled[Pred->blockId])
+        return;
+    }
+    auto& Incomplete = incompletePhis[BB->blockId];
+    for (size_t i = 0; i < Incomplete.size(); i++) {
+      addPhiOperands(Incomplete[i].first, Incomplete[i].second, BB);
+    }
+    Incomplete.clear();
+    sealed[BB->blockId] = true;
+  }
+
+  void fillBlock(BasicBlock* BB) {
+    for (auto& IRInstr : *BB) {
+      if (isa<IRLabelNode>(IRInstr.get()) || isa<IRPhiNode>(IRInstr.get()))
+        continue;
+      for (IRValSlot Slot : IRInstr->operands()) {
+        if (auto* Name = getSSAName(*Slot)) {
+          std::string var = *Name;
+          *Slot = readVariable(var, BB);
+        }
+      }
+      if (IRValSlot Slot = IRInstr->result()) {
+        if (auto* Name = getSSAName(*Slot)) {
+          std::string var = *Name;
+          *Slot = newVersion(var);
+          writeVariable(var, BB, *Slot);
+        }
+      }
+    }
+  }
+
+  void removeTrivialPhis() {
+    std::unordered_map<std::string, ValuePtr> replacement;
+    auto resolve = [&](ValuePtr val) {
+      while (auto* Var = dyn_cast<IRVariableNode>(val.get())) {
+        auto it = replacement.find(Var->varName);
+        if (it == replacement.end())
+          break;
+        val = it->second;
+      }
+      return val;
+    };
+
+    std::unordered_set<IRPhiNode*> removed;
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (auto* Phi : phis) {
+        if (removed.contains(Phi))
+          continue;
+        ValuePtr same;
+        bool trivial = true;
+        for (auto& In : Phi->incoming) {
+          In.value = resolve(In.value);
+          if (isSameValue(In.value.get(), Phi->valDest.get()) ||
+              (same && isSameValue(In.value.get(), same.get())))
+            continue;
+          if (same) {
+            trivial = false;
+            break;
+          }
+          same = In.value;
+        }
+        if (!trivial)
+          continue;
+        auto& DestName = cast<IRVariableNode>(Phi->valDest.get())->varName;
+        if (!same) // only reached from itself, i.e. undefined
+          same = std::make_shared<IRVariableNode>(IRFunc.ssaOrigin.at(DestName));
+        replacement[DestName] = same;
+        removed.insert(Phi);
+        changed = true;
+      }
+    }
+
+    auto& Instructions = IRFunc.IRInstructions;
+    for (auto it = Instructions.begin(); it != Instructions.end();) {
+      auto* Phi = dyn_cast<IRPhiNode>(it->get());
+      if (Phi && removed.contains(Phi)) {
+        it = Instructions.erase(it);
+        continue;
+      }
+      for (IRValSlot Slot : (*it)->operands()) {
+        *Slot = resolve(*Slot);
+      }
+      ++it;
+    }
+  }
+};
+
+class SSADestructor {
+  IRFunctionNode& IRFunc;
+  ControlFlowGraph CFG;
+  /// @brief dense numbering of the SSA values
+  std::unordered_map<std::string, size_t> varIds;
+  std::vector<std::string> varNames;
+  std::vector<std::unordered_set<size_t>> interferes;
+  std::vector<std::vector<bool>> liveIn;  // [blockId][varId]
+  std::vector<std::vector<bool>> liveOut; // [blockId][varId]
+  // union-find over varIds, `members` is only valid for roots
+  std::vector<size_t> parent;
+  std::vector<std::vector<size_t>> members;
+  std::vector<std::vector<IRPhiNode*>> blockPhis; // [blockId]
+  /// @brief the copies `lowerPhis` emitted
+  std::unordered_set<IRInstructionNode*> phiCopies;
+
+public:
+  explicit SSADestructor(IRFunctionNode& IRFunc)
+      : IRFunc(IRFunc), CFG(IRFunc) {}
+
+  void run() {
+    numberValues();
+    computeLiveness();
+    buildInterference();
+    coalesce();
+    lowerPhis();
+    renameToClasses();
+    removeRedundantCopies();
+    removeUnusedLabels();
+  }
+
+private:
+  size_t getVarId(const std::string& name) {
+    auto [it, inserted] = varIds.try_emplace(name, varNames.size());
+    if (inserted) {
+      varNames.push_back(name);
+      interferes.emplace_back();
+      parent.push_back(it->second);
+      members.push_back({it->second});
+    }
+    return it->second;
+  }
+
+  std::optional<size_t> lookupVar(const ValuePtr& val) {
+    if (auto* Name = getSSAName(val))
+      return getVarId(*Name);
+    return std::nullopt;
+  }
+
+  void addInterference(size_t A, size_t B) {
+    if (A == B)
+      return;
+    interferes[A].insert(B);
+    interferes[B].insert(A);
+  }
+
+  BasicBlock* getIncomingBlock(const IRPhiNode::Incoming& In) const {
+    BasicBlock* Pred = CFG.getBlockForLabel(In.labelId);
+    assert(Pred && "destructSSA: phi operand from a deleted block");
+    return Pred;
+  }
+
+  void numberValues() {
+    // parameters first: they are all written by the prologue
+    for (auto& Param : IRFunc.parameters) {
+      getVarId(Param);
+    }
+    for (auto& IRInstr : IRFunc.IRInstructions) {
+      for (IRValSlot Slot : IRInstr->operands()) {
+        lookupVar(*Slot);
+      }
+      if (IRValSlot Slot = IRInstr->result())
+        lookupVar(*Slot);
+    }
+  }
+
+  /// @brief backward liveness; a phi operand is live out of the predecessor
+  /// it comes from, not live into the phi's block
+  void computeLiveness() {
+    size_t numBlocks = CFG.size();
+    size_t numVars = varNames.size();
+    std::vector<std::vector<bool>> gen(numBlocks, std::vector<bool>(numVars));
+    std::vector<std::vector<bool>> kill(numBlocks,
+                                        std::vector<bool>(numVars));
+    std::vector<std::vector<bool>> phiUses(numBlocks,
+                                           std::vector<bool>(numVars));
+    for (auto& BB : CFG.blocks) {
+      auto& Gen = gen[BB->blockId];
+      auto& Kill = kill[BB->blockId];
+      for (auto& IRInstr : *BB) {
+        if (auto* Phi = dyn_cast<IRPhiNode>(IRInstr.get())) {
+          Kill[*lookupVar(Phi->valDest)] = true;
+          for (auto& In : Phi->incoming) {
+            if (auto Id = lookupVar(In.value))
+              phiUses[getIncomingBlock(In)->blockId][*Id] = true;
+          }
+          continue;
+        }
+        for (IRValSlot Slot : IRInstr->operands()) {
+          if (auto Id = lookupVar(*Slot); Id && !Kill[*Id])
+            Gen[*Id] = true;
+        }
+        if (IRValSlot Slot = IRInstr->result()) {
+          if (auto Id = lookupVar(*Slot))
+            Kill[*Id] = true;
+        }
+      }
+    }
+
+    liveIn.assign(numBlocks, std::vector<bool>(numVars));
+    liveOut.assign(numBlocks, std::vector<bool>(numVars));
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (size_t b = numBlocks; b-- > 0;) {
+        BasicBlock* BB = CFG.blocks[b].get();
+        std::vector<bool> Out = phiUses[b];
+        for (auto* Succ : BB->successors) {
+          auto& SuccIn = liveIn[Succ->blockId];
+          for (size_t v = 0; v < numVars; v++) {
+            if (SuccIn[v])
+              Out[v] = true;
+          }
+        }
+        std::vector<bool> In = gen[b];
+        for (size_t v = 0; v < numVars; v++) {
+          if (Out[v] && !kill[b][v])
+            In[v] = true;
+        }
+        if (In != liveIn[b] || Out != liveOut[b]) {
+          liveIn[b] = std::move(In);
+          liveOut[b] = std::move(Out);
+          changed = true;
+        }
+      }
+    }
+  }
+
+  void buildInterference() {
+    size_t numVars = liveOut.empty() ? 0 : liveOut.front().size();
+    auto interfereWithLive = [&](size_t Def, const std::vector<bool>& Live,
+                                 std::optional<size_t> Except) {
+      for (size_t v = 0; v < numVars; v++) {
+        if (Live[v] && v != Except)
+          addInterference(Def, v);
+      }
+    };
+
+    for (auto& BB : CFG.blocks) {
+      std::vector<bool> Live = liveOut[BB->blockId];
+      auto it = BB->end();
+      while (it != BB->begin()) {
+        IRInstructionNode* IRInstr = std::prev(it)->get();
+        if (isa<IRPhiNode>(IRInstr) || isa<IRLabelNode>(IRInstr))
+          break;
+        --it;
+        if (IRValSlot Slot = IRInstr->result()) {
+          if (auto Def = lookupVar(*Slot)) {
+            // `dest = src` doesn't make dest and src interfere, both hold the
+            // same value
+            std::optional<size_t> CopySrc;
+            if (auto* Copy = dyn_cast<IRCopyNode>(IRInstr))
+              CopySrc = lookupVar(Copy->ValSrc);
+            interfereWithLive(*Def, Live, CopySrc);
+            Live[*Def] = false;
+          }
+        }
+        for (IRValSlot Slot : IRInstr->operands()) {
+          if (auto Use = lookupVar(*Slot))
+            Live[*Use] = true;
+        }
+      }
+
+      // phis are all written at once on entry to the block
+      std::vector<size_t> PhiDefs;
+      for (; it != BB->begin(); --it) {
+        if (auto* Phi = dyn_cast<IRPhiNode>(std::prev(it)->get()))
+          PhiDefs.push_back(*lookupVar(Phi->valDest));
+      }
+      for (size_t Def : PhiDefs) {
+        Live[Def] = false;
+      }
+      for (size_t Def : PhiDefs) {
+        interfereWithLive(Def, Live, std::nullopt);
+        for (size_t Other : PhiDefs) {
+          addInterference(Def, Other);
+        }
+      }
+
+      if (BB.get() == CFG.getEntry()) {
+        // everything live on entry is set up before the first instruction
+        for (size_t v = 0; v < numVars; v++) {
+          if (Live[v])
+            interfereWithLive(v, Live, std::nullopt);
+        }
+      }
+    }
+
+    // the prologue writes every parameter, even dead ones
+    for (auto& Param : IRFunc.parameters) {
+      for (auto& Other : IRFunc.parameters) {
+        addInterference(varIds.at(Param), varIds.at(Other));
+      }
+    }
+  }
+
+  size_t find(size_t v) {
+    while (parent[v] != v) {
+      parent[v] = parent[parent[v]];
+      v = parent[v];
+    }
+    return v;
+  }
+
+  bool tryMerge(size_t A, size_t B) {
+    A = find(A);
+    B = find(B);
+    if (A == B)
+      return true;
+    for (size_t x : members[A]) {
+      for (size_t y : members[B]) {
+        if (interferes[x].contains(y))
+          return false;
+      }
+    }
+    if (members[A].size() < members[B].size())
+      std::swap(A, B);
+    parent[B] = A;
+    members[A].insert(members[A].end(), members[B].begin(), members[B].end());
+    members[B].clear();
+    return true;
+  }
+
+  void coalesce() {
+    // versions of the same variable first, it keeps the name in most cases
+    // (`getVarId` may grow `varNames` while iterating, use indices)
+    for (size_t v = 0; v < varNames.size(); v++) {
+      auto it = IRFunc.ssaOrigin.find(varNames[v]);
+      if (it != IRFunc.ssaOrigin.end())
+        tryMerge(v, getVarId(it->second));
+    }
+    // then phi webs, each merge removes a copy
+    for (auto& IRInstr : IRFunc.IRInstructions) {
+      if (auto* Phi = dyn_cast<IRPhiNode>(IRInstr.get())) {
+        size_t Dest = *lookupVar(Phi->valDest);
+        for (auto& In : Phi->incoming) {
+          if (auto Src = lookupVar(In.value))
+            tryMerge(Dest, *Src);
+        }
+      }
+    }
+  }
+
+  bool needsCopy(const IRPhiNode* Phi, const IRPhiNode::Incoming& In) {
+    auto Src = lookupVar(In.value);
+    return !Src || find(*Src) != find(*lookupVar(Phi->valDest));
+  }
+
+  /// @return where copies go at the end of `Pred`: before its jump, if any
+  BasicBlock::InstrIter getCopyInsertPoint(BasicBlock* Pred) {
+    if (isa<IRBranchNode>(Pred->back()))
+      return std::prev(Pred->end());
+    return Pred->end();
+  }
+
+  struct PhiCopy {
+    ValuePtr dest;
+    size_t destClass;
+    ValuePtr src;
+    std::optional<size_t> srcClass;
+  };
+
+  static bool isSameCopy(const PhiCopy& A, const PhiCopy& B) {
+    return A.destClass == B.destClass && A.srcClass == B.srcClass &&
+           (A.srcClass || isSameValue(A.src.get(), B.src.get()));
+  }
+
+  /// @return the variable `Version` was renamed from
+  const std::string& getOrigin(const ValuePtr& Version) {
+    const std::string& Name = cast<IRVariableNode>(Version.get())->varName;
+    auto it = IRFunc.ssaOrigin.find(Name);
+    return it != IRFunc.ssaOrigin.end() ? it->second : Name;
+  }
+
+  /// @return temporary that breaks a copy cycle through `Dest`, named after its
+  /// variable so that destructing the same code twice gives the same copies
+  ValuePtr getCycleTemp(const ValuePtr& Dest) {
+    std::string name = getOrigin(Dest) + ".swap";
+    // a temporary of an earlier destruction that is still in use
+    if (varIds.contains(name))
+      name = IRFunc.createName(name);
+    return std::make_shared<IRVariableNode>(name);
+  }
+
+  /// @brief Emits the parallel copy `Copies` before `InsertPt` as a sequence:
+  /// a copy goes first once no other pending copy still reads its destination,
+  /// cycles (`a, b = b, a`) are broken with a temporary.
+  void sequentializeCopies(BasicBlock::InstrIter InsertPt,
+                           std::vector<PhiCopy> Copies) {
+    auto emit = [&](ValuePtr src, ValuePtr dest) {
+      auto it = IRFunc.IRInstructions.insert(
+          InsertPt, std::make_unique<IRCopyNode>(std::move(src),
+                                                 std::move(dest)));
+      phiCopies.insert(it->get());
+    };
+    // by variable, the phis of a block come in a different order each time
+    std::stable_sort(Copies.begin(), Copies.end(), [&](auto& A, auto& B) {
+      return getOrigin(A.dest) < getOrigin(B.dest);
+    });
+    while (!Copies.empty()) {
+      auto Ready = std::find_if(Copies.begin(), Copies.end(), [&](auto& C) {
+        return std::none_of(Copies.begin(), Copies.end(), [&](auto& Other) {
+          return &Other != &C && Other.srcClass == C.destClass;
+        });
+      });
+      if (Ready == Copies.end()) {
+        // only cycles left: save one destination, its readers use the copy
+        auto& C = Copies.front();
+        auto Temp = getCycleTemp(C.dest);
+        emit(C.dest, Temp);
+        for (auto& Other : Copies) {
+          if (Other.srcClass == C.destClass) {
+            Other.src = Temp;
+            Other.srcClass = std::nullopt;
+          }
+        }
+        continue;
+      }
+      emit(Ready->src, Ready->dest);
+      Copies.erase(Ready);
+    }
+  }
+
+  /// @return classes whose value the edge from `Pred` to `Succ` keeps: live
+  /// into `Succ`, or operands of its phis that coalesced with the phi
+  std::unordered_set<size_t> getClassesKeptOnEdge(BasicBlock* Pred,
+                                                  BasicBlock* Succ) {
+    std::unordered_set<size_t> Kept;
+    auto& Live = liveIn[Succ->blockId];
+    for (size_t v = 0; v < Live.size(); v++) {
+      if (Live[v])
+        Kept.insert(find(v));
+    }
+    for (auto* Phi : blockPhis[Succ->blockId]) {
+      for (auto& In : Phi->incoming) {
+        if (getIncomingBlock(In) == Pred && !needsCopy(Phi, In))
+          Kept.insert(find(*lookupVar(In.value)));
+      }
+    }
+    return Kept;
+  }
+
+  /// @brief jump redirected to a new block holding the copies of its edge
+  struct SplitEdge {
+    IRBranchNode* jump;
+    IRLabelNode* target;
+    std::vector<PhiCopy> copies;
+  };
+
+  /// @brief Places the copies of the two edges out of `Pred`, which ends with
+  /// a conditional jump. The copies of an edge go before the jump if they
+  /// can run on the other edge too, else the edge is split.
+  void lowerCriticalEdges(BasicBlock* Pred,
+                          std::vector<std::vector<PhiCopy>>& Copies,
+                          std::vector<SplitEdge>& Splits) {
+    auto JumpIt = std::prev(Pred->end());
+    auto* Jump = cast<IRBranchNode>(JumpIt->get());
+    std::unordered_set<size_t> JumpReads;
+    for (IRValSlot Slot : Jump->operands()) {
+      if (auto Id = lookupVar(*Slot))
+        JumpReads.insert(find(*Id));
+    }
+    std::unordered_set<size_t> Kept[2] = {
+        getClassesKeptOnEdge(Pred, Pred->successors[0]),
+        getClassesKeptOnEdge(Pred, Pred->successors[1])};
+    // a copy of edge `i` can run on the other edge if that one keeps nothing
+    // in its destination and writes nothing else to it. The copies before the
+    // jump are one parallel copy, those the other edge reads must stay on it
+    // unless `Both` edges are hoisted.
+    auto canHoist = [&](size_t i, bool Both) {
+      auto& Other = Copies[1 - i];
+      return std::all_of(Copies[i].begin(), Copies[i].end(), [&](auto& C) {
+        return !JumpReads.contains(C.destClass) &&
+               !Kept[1 - i].contains(C.destClass) &&
+               std::all_of(Other.begin(), Other.end(), [&](auto& O) {
+                 if (O.destClass == C.destClass)
+                   return isSameCopy(C, O);
+                 return Both || O.srcClass != C.destClass;
+               });
+      });
+    };
+    bool Hoist[2] = {false, false};
+    if (canHoist(0, true) && canHoist(1, true)) {
+      Hoist[0] = Hoist[1] = true;
+    } else {
+      // the taken edge first, splitting the fallthrough one costs no jump
+      size_t Taken = Pred->successors[0] == CFG.getLayoutSuccessor(Pred);
+      Hoist[Taken] = canHoist(Taken, false);
+      Hoist[1 - Taken] = !Hoist[Taken] && canHoist(1 - Taken, false);
+    }
+
+    std::vector<PhiCopy> Hoisted;
+    auto isHoisted = [&](const PhiCopy& C) {
+      return std::any_of(Hoisted.begin(), Hoisted.end(),
+                         [&](auto& H) { return isSameCopy(H, C); });
+    };
+    for (size_t i = 0; i < 2; i++) {
+      if (!Hoist[i])
+        continue;
+      for (auto& C : Copies[i]) {
+        if (!isHoisted(C))
+          Hoisted.push_back(C);
+      }
+      Copies[i].clear();
+    }
+    if (!Hoisted.empty())
+      sequentializeCopies(JumpIt, Hoisted);
+
+    BasicBlock* Fallthrough = CFG.getLayoutSuccessor(Pred);
+    for (size_t i = 0; i < 2; i++) {
+      std::erase_if(Copies[i], isHoisted);
+      if (Copies[i].empty())
+        continue;
+      BasicBlock* Succ = Pred->successors[i];
+      if (Succ == Fallthrough) // a new block between the jump and `Succ`
+        sequentializeCopies(Succ->begin(), std::move(Copies[i]));
+      else
+        Splits.push_back({Jump, Succ->getLabel(), std::move(Copies[i])});
+    }
+  }
+
+  void lowerPhis() {
+    auto& Instructions = IRFunc.IRInstructions;
+    blockPhis.assign(CFG.size(), {});
+    // the parallel copy of every edge, [pred][index of the successor]
+    std::vector<std::vector<std::vector<PhiCopy>>> EdgeCopies(CFG.size());
+    for (auto& BB : CFG.blocks) {
+      EdgeCopies[BB->blockId].resize(BB->successors.size());
+      // past the label
+      for (auto it = std::next(BB->begin()); it != BB->end(); ++it) {
+        auto* Phi = dyn_cast<IRPhiNode>(it->get());
+        if (!Phi)
+          break;
+        blockPhis[BB->blockId].push_back(Phi);
+      }
+    }
+    for (auto& BB : CFG.blocks) {
+      for (auto* Phi : blockPhis[BB->blockId]) {
+        size_t DestClass = find(*lookupVar(Phi->valDest));
+        for (auto& In : Phi->incoming) {
+          if (!needsCopy(Phi, In))
+            continue;
+          std::optional<size_t> SrcClass;
+          if (auto Src = lookupVar(In.value))
+            SrcClass = find(*Src);
+          BasicBlock* Pred = getIncomingBlock(In);
+          auto& Succs = Pred->successors;
+          size_t i = std::find(Succs.begin(), Succs.end(), BB.get()) -
+                     Succs.begin();
+          EdgeCopies[Pred->blockId][i].push_back(
+              {Phi->valDest, DestClass, In.value, SrcClass});
+        }
+      }
+    }
+
+    std::vector<SplitEdge> Splits;
+    for (auto& BB : CFG.blocks) {
+      auto& Copies = EdgeCopies[BB->blockId];
+      if (Copies.size() == 1 && !Copies.front().empty())
+        sequentializeCopies(getCopyInsertPoint(BB.get()),
+                            std::move(Copies.front()));
+      else if (Copies.size() == 2)
+        lowerCriticalEdges(BB.get(), Copies, Splits);
+    }
+    // the new blocks go at the end, nothing falls through into them
+    assert((Splits.empty() || isa<IRRetNode>(Instructions.back().get()) ||
+            isa<IRJumpNode>(Instructions.back().get())) &&
+           "destructSSA: function doesn't end with a return or a jump");
+    for (auto& Split : Splits) {
+      auto Label = IRFunc.createLabel("split");
+      Split.jump->labelName = Label->labelName;
+      Split.jump->labelId = Label->labelId;
+      Instructions.push_back(std::move(Label));
+      sequentializeCopies(Instructions.end(), std::move(Split.copies));
+      Instructions.push_back(std::make_unique<IRJumpNode>(
+          Split.target->labelName, Split.target->labelId));
+    }
+  }
+
+  void renameToClasses() {
+    std::unordered_set<std::string> Params(IRFunc.parameters.begin(),
+                                           IRFunc.parameters.end());
+    // representative of a class: the parameter in it (the prologue stores it
+    // under its name), else an original variable, else any version
+    std::vector<ValuePtr> RepNode(varNames.size());
+    for (size_t Root = 0; Root < varNames.size(); Root++) {
+      if (find(Root) != Root)
+        continue;
+      size_t Rep = members[Root].front();
+      int RepRank = -1;
+      for (size_t v : members[Root]) {
+        int Rank = Params.contains(varNames[v])                ? 2
+                   : !IRFunc.ssaOrigin.contains(varNames[v]) ? 1
+                                                               : 0;
+        if (Rank > RepRank) {
+          Rep = v;
+          RepRank = Rank;
+        }
+      }
+      RepNode[Root] = std::make_shared<IRVariableNode>(varNames[Rep]);
+    }
+
+    auto rename = [&](IRValSlot Slot) {
+      auto Name = getSSAName(*Slot);
+      if (!Name)
+        return;
+      auto it = varIds.find(*Name);
+      if (it != varIds.end())
+        *Slot = RepNode[find(it->second)];
+    };
+
+    auto& Instructions = IRFunc.IRInstructions;
+    for (auto it = Instructions.begin(); it != Instructions.end();) {
+      if (isa<IRPhiNode>(it->get())) {
+        it = Instructions.erase(it);
+        continue;
+      }
+      for (IRValSlot Slot : (*it)->operands()) {
+        rename(Slot);
+      }
+      if (IRValSlot Slot = (*it)->result())
+        rename(Slot);
+      if (auto* Copy = dyn_cast<IRCopyNode>(it->get())) {
+        if (isSameValue(Copy->ValSrc.get(), Copy->ValDest.get())) {
+          phiCopies.erase(Copy);
+          it = Instructions.erase(it);
+          continue;
+        }
+      }
+      ++it;
+    }
+  }
+
+  /// @return true if the destination of the copy at `Pos` in `BB` holds its
+  /// source already: going back along every path, the last write to it is
+  /// the same copy and the source isn't written since
+  static bool holdsAlready(BasicBlock* BB, BasicBlock::InstrIter Pos,
+                           size_t numBlocks) {
+    auto* Copy = cast<IRCopyNode>(Pos->get());
+    auto& Dest = cast<IRVariableNode>(Copy->ValDest.get())->varName;
+    auto* Src = getSSAName(Copy->ValSrc);
+    if (!Src && !isa<IRConstNode>(Copy->ValSrc.get()))
+      return false; // memory, any call may write it
+    // blocks searched from their end
+    std::vector<bool> Visited(numBlocks, false);
+    std::vector<std::pair<BasicBlock*, BasicBlock::InstrIter>> Worklist = {
+        {BB, Pos}};
+    while (!Worklist.empty()) {
+      auto [Block, it] = Worklist.back();
+      Worklist.pop_back();
+      bool Written = false;
+      while (!Written && it != Block->begin()) {
+        --it;
+        IRValSlot Result = (*it)->result();
+        auto* Name = Result ? getSSAName(*Result) : nullptr;
+        if (!Name || (*Name != Dest && (!Src || *Name != *Src)))
+          continue;
+        auto* Earlier = dyn_cast<IRCopyNode>(it->get());
+        if (*Name != Dest || !Earlier ||
+            !isSameValue(Earlier->ValSrc.get(), Copy->ValSrc.get()))
+          return false;
+        Written = true;
+      }
+      if (Written)
+        continue;
+      if (Block->predecessors.empty())
+        return false; // the value the function starts with
+      for (auto* Pred : Block->predecessors) {
+        if (!Visited[Pred->blockId]) {
+          Visited[Pred->blockId] = true;
+          Worklist.push_back({Pred, Pred->end()});
+        }
+      }
+    }
+    return true;
+  }
+
+  /// @brief Drops the copies of phi operands into a variable that holds the
+  /// value already on every path, e.g. because of a copy above a conditional
+  /// jump. Copy propagation would remove them and the next round trip through
+  /// SSA form put them back.
+  void removeRedundantCopies() {
+    if (phiCopies.empty())
+      return;
+    ControlFlowGraph Lowered(IRFunc);
+    std::unordered_set<IRInstructionNode*> Redundant;
+    for (auto& BB : Lowered.blocks) {
+      for (auto it = BB->begin(); it != BB->end(); ++it) {
+        if (phiCopies.contains(it->get()) &&
+            holdsAlready(BB.get(), it, Lowered.size()))
+          Redundant.insert(it->get());
+      }
+    }
+    std::erase_if(IRFunc.IRInstructions, [&](const auto& IRInstr) {
+      return Redundant.contains(IRInstr.get());
+    });
+  }
+
+  /// @brief drops the labels construction added (and any other dead label)
+  void removeUnusedLabels() {
+    std::vector<bool> Referenced(IRFunc.numLabels, false);
+    for (auto& IRInstr : IRFunc.IRInstructions) {
+      if (auto* Branch = dyn_cast<IRBranchNode>(IRInstr.get()))
+        Referenced[Branch->labelId] = true;
+    }
+    std::erase_if(IRFunc.IRInstructions, [&](const auto& IRInstr) {
+      auto* Label = dyn_cast<IRLabelNode>(IRInstr.get());
+      return Label && !Referenced[Label->labelId];
+    });
+  }
+};
+} // namespace
+
+namespace nanocc {
+void constructSSA(IRFunctionNode& IRFunc) {
+  if (IRFunc.inSSAForm)
+    return;
+  labelAllBlocks(IRFunc);
+  SSABuilder(IRFunc).run();
+  IRFunc.inSSAForm = true;
+}
+
+void destructSSA(IRFunctionNode& IRFunc) {
+  if (!IRFunc.inSSAForm)
+    return;
+  SSADestructor(IRFunc).run();
+  IRFunc.ssaOrigin.clear();
+  IRFunc.inSSAForm = false;
+}
+} // namespace nanocc
@@ -18,7 +18,8 @@ void AsmFunctionNode::fixUpInstructions(const int& stack_size) {
   new_instructions.push_back(std::move(allocate_stack));
   for (auto& instr : this->instructions) {
     if (isa<AsmMovNode>(instr.get()) || isa<AsmBinaryNode>(instr.get()) ||
-        isa<AsmIdivNode>(instr.get()) || isa<AsmCmpNode>(instr.get())) {
+        isa<AsmIdivNode>(instr.get()) || isa<AsmCmpNode>(instr.get()) ||
+        isa<AsmMulHiNode>(instr.get()) || isa<AsmCMovNode>(instr.get())) {
       instr->fixUpInstructions(new_instructions);
     } else {
       new_instructions.push_back(std::move(instr));
@@ -137,6 +138,44 @@ void AsmIdivNode::fixUpInstructions(
   instructions.push_back(std::move(copy));
 }
 
+/// @brief one operand `imul` can't take an immediate either.
+/// @param instructions
+void AsmMulHiNode::fixUpInstructions(
+    std::vector<std::unique_ptr<AsmInstructionNode>>& instructions) {
+  if (isa<AsmImmediateNode>(this->factor.get())) {
+    auto tmp_reg = std::make_shared<AsmRegisterNode>(getRegString(Reg::r10d));
+    instructions.push_back(std::make_unique<AsmMovNode>(this->factor, tmp_reg));
+    instructions.push_back(std::make_unique<AsmMulHiNode>(tmp_reg));
+    return;
+  }
+  instructions.push_back(std::make_unique<AsmMulHiNode>(this->factor));
+}
+
+/// @brief `cmov` needs a register destination and can't take an immediate.
+/// The moves around it leave the flags alone.
+/// @param instructions
+void AsmCMovNode::fixUpInstructions(
+    std::vector<std::unique_ptr<AsmInstructionNode>>& instructions) {
+  auto src = this->src;
+  if (isa<AsmImmediateNode>(src.get())) {
+    src = std::make_shared<AsmRegisterNode>(getRegString(Reg::r10d));
+    instructions.push_back(std::make_unique<AsmMovNode>(this->src, src));
+  }
+  if (isa<AsmRegisterNode>(this->dest.get())) {
+    instructions.push_back(
+        std::make_unique<AsmCMovNode>(this->cond_code, src, this->dest));
+    return;
+  }
+  // Eg:
+  // CMov(cc, src, Stack(-4)) ==Convert=to==>
+  // Move(Stack(-4), TmpReg); CMov(cc, src, TmpReg); Move(TmpReg, Stack(-4))
+  auto tmp_reg = std::make_shared<AsmRegisterNode>(getRegString(Reg::r11d));
+  instructions.push_back(std::make_unique<AsmMovNode>(this->dest, tmp_reg));
+  instructions.push_back(
+      std::make_unique<AsmCMovNode>(this->cond_code, src, tmp_reg));
+  instructions.push_back(std::make_unique<AsmMovNode>(tmp_reg, this->dest));
+}
+
 /// @brief `cmp` can't take both operands as memory addresses.
 /// Also can't take immediate value as destination.
 /// @param instructions
@@ -113,6 +113,22 @@ void AsmIdivNode::resolvePseudoRegisters(
   }
 }
 
+void AsmShiftNode::resolvePseudoRegisters(
+    std::unordered_map<std::string, int>& pseudo_reg_map, int& stack_offset) {
+  if (auto pseudo_dest = dyn_cast<AsmPseudoNode>(this->dest.get())) {
+    this->dest =
+        resolvePseudoRegister(pseudo_dest, pseudo_reg_map, stack_offset);
+  }
+}
+
+void AsmMulHiNode::resolvePseudoRegisters(
+    std::unordered_map<std::string, int>& pseudo_reg_map, int& stack_offset) {
+  if (auto pseudo_factor = dyn_cast<AsmPseudoNode>(this->factor.get())) {
+    this->factor =
+        resolvePseudoRegister(pseudo_factor, pseudo_reg_map, stack_offset);
+  }
+}
+
 void AsmSetCCNode::resolvePseudoRegisters(
     std::unordered_map<std::string, int>& pseudo_reg_map, int& stack_offset) {
   if (auto pseudo_dest = dyn_cast<AsmPseudoNode>(this->dest.get())) {
@@ -121,6 +137,18 @@ void AsmSetCCNode::resolvePseudoRegisters(
   }
 }
 
+void AsmCMovNode::resolvePseudoRegisters(
+    std::unordered_map<std::string, int>& pseudo_reg_map, int& stack_offset) {
+  if (auto pseudo_src = dyn_cast<AsmPseudoNode>(this->src.get())) {
+    this->src =
+        resolvePseudoRegister(pseudo_src, pseudo_reg_map, stack_offset);
+  }
+  if (auto pseudo_dest = dyn_cast<AsmPseudoNode>(this->dest.get())) {
+    this->dest =
+        resolvePseudoRegister(pseudo_dest, pseudo_reg_map, stack_offset);
+  }
+}
+
 void AsmPushNode::resolvePseudoRegisters(
     std::unordered_map<std::string, int>& pseudo_reg_map, int& stack_offset) {
   if (auto pseudo_operand = dyn_cast<AsmPseudoNode>(this->operand.get())) {
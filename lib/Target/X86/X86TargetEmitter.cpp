@@ -118,6 +118,24 @@ void AsmCdqNode::generateAsm(std::ostream& os) {
      << "\n";
 }
 
+void AsmShiftNode::generateAsm(std::ostream& os) {
+  assert(dest && "AsmShiftNode missing operand during emission");
+  os << TAB4 << this->op << "l $" << this->count << ", ";
+  this->dest->generateAsm(os);
+  os << '\n';
+}
+
+/*
+The one operand form of `imul` multiplies `EAX` by its operand into the 64 bit
+`EDX:EAX`; division by a constant keeps only the high half in `EDX`.
+*/
+void AsmMulHiNode::generateAsm(std::ostream& os) {
+  assert(factor && "AsmMulHiNode missing factor during emission");
+  os << TAB4 << "imull ";
+  factor->generateAsm(os);
+  os << '\n';
+}
+
 void AsmJmpNode::generateAsm(std::ostream& os) {
   os << TAB4 << "jmp " << this->label << "\n";
 }
@@ -132,6 +150,15 @@ void AsmSetCCNode::generateAsm(std::ostream& os) {
   os << "\n";
 }
 
+// no size suffix, `cmovl` would read as "move if less"
+void AsmCMovNode::generateAsm(std::ostream& os) {
+  os << TAB4 << "cmov" << this->cond_code << " ";
+  this->src->generateAsm(os);
+  os << ", ";
+  this->dest->generateAsm(os);
+  os << "\n";
+}
+
 void AsmLabelNode::generateAsm(std::ostream& os) {
   os << "  " << this->label << ":\n"; // no `TAB4` for labels
 }
@@ -156,7 +183,16 @@ void AsmPushNode::generateAsm(std::ostream& os) {
 }
 
 void AsmCallNode::generateAsm(std::ostream& os) {
-  os << TAB4 << "call " << func_name;
+  if (tail) {
+    // the frame goes as in `ret`, the return address on top is our caller's
+    os << TAB4 << "movq"
+       << " " << getRegString(Reg::rbp) << ", " << getRegString(Reg::rsp)
+       << "\n";
+    os << TAB4 << "popq " << getRegString(Reg::rbp) << "\n";
+    os << TAB4 << "jmp " << func_name;
+  } else {
+    os << TAB4 << "call " << func_name;
+  }
   // add @PLT suffix for functions without definations
   const Type& func_info = nanocc::global_type_checker_map[func_name].type;
   assert(std::holds_alternative<FuncType>(func_info) &&
@@ -166,7 +202,7 @@ void AsmCallNode::generateAsm(std::ostream& os) {
   if (!func_type.defined) {
     os << "@PLT";
   }
-  os << '\n';
+  os << (tail ? "\n\n" : "\n");
 }
 
 void AsmRetNode::generateAsm(std::ostream& os) {
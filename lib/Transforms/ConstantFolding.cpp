@@ -1,3 +1,6 @@
+#include <limits>
+#include <vector>
+
 #include "nanocc/Transforms/ConstantFolding.hpp"
 #include "nanocc/Utils/Utils.hpp"
 
@@ -5,34 +8,37 @@
 Replace with Copy:
     Unary Instruction with constant operand
     Binary Instruction with constant operands
+    Select with constant comparison operands, or the same value either way
 
 Replace with Jump or remove:
     JumpIfZero with constant condition
     JumpIfNotZero with constant condition
+    JumpIfCmp with constant operands
 */
 
 namespace {
 enum class FoldResult { NoChange, Replace, Erase };
 
+bool sameValue(const IRValNode& A, const IRValNode& B) {
+  if (auto* ConstA = dyn_cast<IRConstNode>(&A)) {
+    auto* ConstB = dyn_cast<IRConstNode>(&B);
+    return ConstB && ConstA->IntVal == ConstB->IntVal;
+  }
+  auto* VarA = cast<IRVariableNode>(&A);
+  auto* VarB = dyn_cast<IRVariableNode>(&B);
+  return VarB && VarA->varName == VarB->varName;
+}
+
 // if operand is a constant evaluate it at compile time.
-// unary ops (as of now): ~, -, !
 static FoldResult
 handleUnaryConstantFolding(IRUnaryNode* IRUnaryOp,
                            std::unique_ptr<IRInstructionNode>& IRInstr) {
   if (auto* IRSrcConst = dyn_cast<IRConstNode>(IRUnaryOp->valSrc.get())) {
-    std::shared_ptr<IRConstNode> constEval;
-    switch (IRUnaryOp->opType) {
-    case TokenType::TILDE: // bitwise not
-      constEval = std::make_shared<IRConstNode>(~IRSrcConst->IntVal);
-      break;
-    case TokenType::MINUS: // negation
-      constEval = std::make_shared<IRConstNode>(-IRSrcConst->IntVal);
-      break;
-    case TokenType::NOT: // logical not
-      constEval = std::make_shared<IRConstNode>(!IRSrcConst->IntVal);
-      break;
-    }
-    auto folded = std::make_unique<IRCopyNode>(constEval, IRUnaryOp->valDest);
+    auto constEval = nanocc::foldUnaryOp(IRUnaryOp->opType, IRSrcConst->IntVal);
+    if (!constEval)
+      return FoldResult::NoChange;
+    auto folded = std::make_unique<IRCopyNode>(
+        std::make_shared<IRConstNode>(*constEval), IRUnaryOp->valDest);
     IRInstr = std::move(folded);
     return FoldResult::Replace;
   }
@@ -40,143 +46,164 @@ handleUnaryConstantFolding(IRUnaryNode* IRUnaryOp,
 }
 
 // if both operands are constant evaluate at compile time
-// binary ops in IR: *, /, %, +, -, <, <=, >, >=, ==, !=, &&, ||
 static FoldResult
 handleBinaryConstantFolding(IRBinaryNode* IRBinaryOp,
                             std::unique_ptr<IRInstructionNode>& IRInstr) {
   if (auto* IRSrc1Const = dyn_cast<IRConstNode>(IRBinaryOp->valSrcL.get()))
     if (auto* IRSrc2Const = dyn_cast<IRConstNode>(IRBinaryOp->valSrcR.get())) {
-      std::shared_ptr<IRConstNode> constEval;
-      int val1 = IRSrc1Const->IntVal;
-      int val2 = IRSrc2Const->IntVal;
-      switch (IRBinaryOp->opType) {
-      case TokenType::STAR:
-        constEval = std::make_shared<IRConstNode>(val1 * val2);
-        break;
-      case TokenType::SLASH:
-        if (val2 == 0)
-          return FoldResult::NoChange;
-        constEval = std::make_shared<IRConstNode>(val1 / val2);
-        break;
-      case TokenType::PERCENT:
-        if (val2 == 0)
-          return FoldResult::NoChange;
-        constEval = std::make_shared<IRConstNode>(val1 % val2);
-        break;
-      case TokenType::PLUS:
-        constEval = std::make_shared<IRConstNode>(val1 + val2);
-        break;
-      case TokenType::MINUS:
-        constEval = std::make_shared<IRConstNode>(val1 - val2);
-        break;
-      case TokenType::LESSTHAN:
-        constEval = std::make_shared<IRConstNode>(val1 < val2);
-        break;
-      case TokenType::LESS_EQUAL:
-        constEval = std::make_shared<IRConstNode>(val1 <= val2);
-        break;
-      case TokenType::GREATERTHAN:
-        constEval = std::make_shared<IRConstNode>(val1 > val2);
-        break;
-      case TokenType::GREATER_EQUAL:
-        constEval = std::make_shared<IRConstNode>(val1 >= val2);
-        break;
-      case TokenType::EQUAL:
-        constEval = std::make_shared<IRConstNode>(val1 == val2);
-        break;
-      case TokenType::NOT_EQUAL:
-        constEval = std::make_shared<IRConstNode>(val1 != val2);
-        break;
-      case TokenType::AND:
-        constEval = std::make_shared<IRConstNode>(val1 && val2);
-        break;
-      case TokenType::OR:
-        constEval = std::make_shared<IRConstNode>(val1 || val2);
-        break;
-      }
-      auto folded =
-          std::make_unique<IRCopyNode>(constEval, IRBinaryOp->valDest);
+      auto constEval = nanocc::foldBinaryOp(
+          IRBinaryOp->opType, IRSrc1Const->IntVal, IRSrc2Const->IntVal);
+      if (!constEval)
+        return FoldResult::NoChange;
+      auto folded = std::make_unique<IRCopyNode>(
+          std::make_shared<IRConstNode>(*constEval), IRBinaryOp->valDest);
       IRInstr = std::move(folded);
       return FoldResult::Replace;
     }
   return FoldResult::NoChange;
 }
 
-// if jump condition is a constant evaluate it at compile time,
-// replace it with just Jump or remove it depending on the condition
+// the value a select picks is known if the comparison is, or if both values
+// are the same constant or variable
 static FoldResult
-handleJumpIfZeroConstantFolding(IRJumpIfZeroNode* IRJumpIfZero,
-                                std::unique_ptr<IRInstructionNode>& IRInstr) {
-  if (auto* IRSrcConst = dyn_cast<IRConstNode>(IRJumpIfZero->condition.get())) {
-    if (IRSrcConst->IntVal == 0) {
-      // condition is always true, replace with unconditional jump
-      auto folded = std::make_unique<IRJumpNode>(IRJumpIfZero->labelName);
-      IRInstr = std::move(folded);
-      return FoldResult::Replace;
-    } else {
-      // condition is always false, remove the instruction
-      return FoldResult::Erase;
-    }
+handleSelectConstantFolding(IRSelectNode* IRSelect,
+                            std::unique_ptr<IRInstructionNode>& IRInstr) {
+  std::shared_ptr<IRValNode> picked;
+  auto* IRSrc1Const = dyn_cast<IRConstNode>(IRSelect->valSrcL.get());
+  auto* IRSrc2Const = dyn_cast<IRConstNode>(IRSelect->valSrcR.get());
+  if (IRSrc1Const && IRSrc2Const) {
+    bool cond = *nanocc::foldBinaryOp(IRSelect->opType, IRSrc1Const->IntVal,
+                                      IRSrc2Const->IntVal);
+    picked = cond ? IRSelect->valTrue : IRSelect->valFalse;
+  } else if (sameValue(*IRSelect->valTrue, *IRSelect->valFalse)) {
+    picked = IRSelect->valTrue;
+  } else {
+    return FoldResult::NoChange;
   }
-  return FoldResult::NoChange;
+  IRInstr = std::make_unique<IRCopyNode>(picked, IRSelect->valDest);
+  return FoldResult::Replace;
 }
 
-// if jump condition is a constant evaluate it at compile time,
-// replace it with just Jump or remove it depending on the condition
-static FoldResult handleJumpIfNotZeroConstantFolding(
-    IRJumpIfNotZeroNode* IRJumpIfNotZero,
-    std::unique_ptr<IRInstructionNode>& IRInstr) {
-  bool changed = false;
-  if (auto* IRSrcConst =
-          dyn_cast<IRConstNode>(IRJumpIfNotZero->condition.get())) {
-    changed = true;
-    if (IRSrcConst->IntVal != 0) {
-      // condition is always true, replace with unconditional jump
-      auto folded = std::make_unique<IRJumpNode>(IRJumpIfNotZero->labelName);
-      IRInstr = std::move(folded);
-      return FoldResult::Replace;
-    } else {
-      // condition is always false, remove the instruction
-      return FoldResult::Erase;
-    }
+// if the operands of a conditional jump are constants evaluate it at compile
+// time, replace it with just Jump or remove it depending on the condition
+static FoldResult
+handleBranchConstantFolding(IRBranchNode* IRBranch,
+                            std::unique_ptr<IRInstructionNode>& IRInstr) {
+  if (!IRBranch->isConditional())
+    return FoldResult::NoChange;
+  std::vector<int> vals;
+  for (IRValSlot Slot : IRBranch->operands()) {
+    auto* IRSrcConst = dyn_cast<IRConstNode>(Slot->get());
+    if (!IRSrcConst)
+      return FoldResult::NoChange;
+    vals.push_back(IRSrcConst->IntVal);
   }
-  return FoldResult::NoChange;
+  if (nanocc::takesBranch(*IRBranch, vals)) {
+    // condition is always true, replace with unconditional jump
+    auto folded =
+        std::make_unique<IRJumpNode>(IRBranch->labelName, IRBranch->labelId);
+    IRInstr = std::move(folded);
+    return FoldResult::Replace;
+  }
+  // condition is always false, remove the instruction
+  return FoldResult::Erase;
 }
 } // namespace
 
 namespace nanocc {
 
-bool ConstantFoldInstructions(IRProgramNode& IRProgram) {
+// unary ops (as of now): ~, -, !
+std::optional<int> foldUnaryOp(TokenType opType, int val) {
+  switch (opType) {
+  case TokenType::TILDE: // bitwise not
+    return ~val;
+  case TokenType::MINUS: // negation, wraps like `negl`
+    return static_cast<int>(0u - static_cast<unsigned>(val));
+  case TokenType::NOT: // logical not
+    return !val;
+  default:
+    return std::nullopt;
+  }
+}
+
+// binary ops in IR: *, /, %, +, -, <, <=, >, >=, ==, !=, &&, ||
+std::optional<int> foldBinaryOp(TokenType opType, int val1, int val2) {
+  switch (opType) {
+  // +, -, * wrap around in two's complement like the emitted instructions
+  case TokenType::STAR:
+    return static_cast<int>(static_cast<unsigned>(val1) *
+                            static_cast<unsigned>(val2));
+  case TokenType::SLASH:
+  case TokenType::PERCENT:
+    // leave the trap to run time, don't trap in the compiler
+    if (val2 == 0 || (val1 == std::numeric_limits<int>::min() && val2 == -1))
+      return std::nullopt;
+    return opType == TokenType::SLASH ? val1 / val2 : val1 % val2;
+  case TokenType::PLUS:
+    return static_cast<int>(static_cast<unsigned>(val1) +
+                            static_cast<unsigned>(val2));
+  case TokenType::MINUS:
+    return static_cast<int>(static_cast<unsigned>(val1) -
+                            static_cast<unsigned>(val2));
+  case TokenType::LESSTHAN:
+    return val1 < val2;
+  case TokenType::LESS_EQUAL:
+    return val1 <= val2;
+  case TokenType::GREATERTHAN:
+    return val1 > val2;
+  case TokenType::GREATER_EQUAL:
+    return val1 >= val2;
+  case TokenType::EQUAL:
+    return val1 == val2;
+  case TokenType::NOT_EQUAL:
+    return val1 != val2;
+  case TokenType::AND:
+    return val1 && val2;
+  case TokenType::OR:
+    return val1 || val2;
+  default:
+    return std::nullopt;
+  }
+}
+
+bool takesBranch(const IRBranchNode& Branch, const std::vector<int>& vals) {
+  if (auto* Compare = dyn_cast<IRJumpIfCmpNode>(&Branch))
+    return *foldBinaryOp(Compare->opType, vals[0], vals[1]) != 0;
+  return (vals[0] == 0) == isa<IRJumpIfZeroNode>(&Branch);
+}
+
+PassResult ConstantFoldInstructions(IRFunctionNode& IRFunc, AnalysisManager&) {
   bool changed = false;
-  for (auto& TopLvl : IRProgram.topLevel) {
-    if (auto* IRFunc = dyn_cast<IRFunctionNode>(TopLvl.get())) {
-      auto& IRVecInstr = IRFunc->IRInstructions;
-      for (auto it = IRVecInstr.begin(); it != IRVecInstr.end();) {
-        auto& IRInstr = *it;
-        FoldResult foldResult = FoldResult::NoChange;
-        if (auto* IRUnaryOp = dyn_cast<IRUnaryNode>(IRInstr.get())) {
-          foldResult = handleUnaryConstantFolding(IRUnaryOp, IRInstr);
-        } else if (auto* IRBinaryOp = dyn_cast<IRBinaryNode>(IRInstr.get())) {
-          foldResult = handleBinaryConstantFolding(IRBinaryOp, IRInstr);
-        } else if (auto* IRJumpIfFalse =
-                       dyn_cast<IRJumpIfZeroNode>(IRInstr.get())) {
-          foldResult = handleJumpIfZeroConstantFolding(IRJumpIfFalse, IRInstr);
-        } else if (auto* IRJumpIfTrue =
-                       dyn_cast<IRJumpIfNotZeroNode>(IRInstr.get())) {
-          foldResult =
-              handleJumpIfNotZeroConstantFolding(IRJumpIfTrue, IRInstr);
-        }
-        if (foldResult == FoldResult::Erase) {
-          changed = true;
-          it = IRVecInstr.erase(it);
-        } else {
-          if (foldResult == FoldResult::Replace)
-            changed = true;
-          ++it;
-        }
-      }
+  // folding arithmetic replaces instructions in place, blocks stay as they are
+  bool changedCFG = false;
+  auto& IRVecInstr = IRFunc.IRInstructions;
+  for (auto it = IRVecInstr.begin(); it != IRVecInstr.end();) {
+    auto& IRInstr = *it;
+    FoldResult foldResult = FoldResult::NoChange;
+    bool isBranch = false;
+    if (auto* IRUnaryOp = dyn_cast<IRUnaryNode>(IRInstr.get())) {
+      foldResult = handleUnaryConstantFolding(IRUnaryOp, IRInstr);
+    } else if (auto* IRBinaryOp = dyn_cast<IRBinaryNode>(IRInstr.get())) {
+      foldResult = handleBinaryConstantFolding(IRBinaryOp, IRInstr);
+    } else if (auto* IRSelect = dyn_cast<IRSelectNode>(IRInstr.get())) {
+      foldResult = handleSelectConstantFolding(IRSelect, IRInstr);
+    } else if (auto* IRBranch = dyn_cast<IRBranchNode>(IRInstr.get())) {
+      isBranch = true;
+      foldResult = handleBranchConstantFolding(IRBranch, IRInstr);
+    }
+    if (foldResult != FoldResult::NoChange) {
+      changed = true;
+      changedCFG |= isBranch;
+    }
+    if (foldResult == FoldResult::Erase) {
+      it = IRVecInstr.erase(it);
+    } else {
+      ++it;
     }
   }
-  return changed;
+  if (!changed)
+    return PassResult::unchanged();
+  return PassResult::modified(changedCFG ? PreservedAnalyses::none()
+                                         : PreservedAnalyses::cfgOnly());
 }
 } // namespace nanocc
@@ -1,9 +1,218 @@
-#include "nanocc/Transforms/CopyPropagation.hpp"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "nanocc/Analysis/DataflowFramework.hpp"
+#include "nanocc/IR/BasicBlock.hpp"
 #include "nanocc/IR/IR.hpp"
+#include "nanocc/Transforms/CopyPropagation.hpp"
+#include "nanocc/Utils/BitVector.hpp"
+#include "nanocc/Utils/Utils.hpp"
+
+/*
+Reaching copies: `x = y` reaches a point if it is on every path to it and
+neither x nor y is written in between. A use of x there can read y instead:
+    x = y          x = y
+    z = x + 1  ->  z = y + 1
+A copy is redundant if `x = y` or `y = x` already reaches it.
+
+Forward must-analysis over the CFG, one bit per copy:
+    in(B)  = n out(P) for P in preds(B), empty for the entry
+    out(B) = transfer(B, in(B))
+A write to x kills every copy reading or writing x. A call may write any
+static variable, so it kills every copy that involves one.
+*/
+
+namespace {
+using ValuePtr = std::shared_ptr<IRValNode>;
+
+bool sameValue(const ValuePtr& A, const ValuePtr& B) {
+  if (auto* ConstA = dyn_cast<IRConstNode>(A.get())) {
+    auto* ConstB = dyn_cast<IRConstNode>(B.get());
+    return ConstB && ConstA->IntVal == ConstB->IntVal;
+  }
+  auto* VarA = cast<IRVariableNode>(A.get());
+  auto* VarB = dyn_cast<IRVariableNode>(B.get());
+  return VarB && VarA->varName == VarB->varName;
+}
+
+const std::string* getVarName(const ValuePtr& val) {
+  if (auto* Var = dyn_cast<IRVariableNode>(val.get()))
+    return &Var->varName;
+  return nullptr;
+}
+
+class ReachingCopies {
+public:
+  struct Copy {
+    // the operands when the analysis ran, rewriting the instruction later
+    // doesn't change what the fact says
+    ValuePtr src;
+    ValuePtr dest;
+  };
+
+  ReachingCopies(IRFunctionNode& IRFunc, const ControlFlowGraph& CFG)
+      : CFG(CFG) {
+    for (auto& IRInstr : IRFunc.IRInstructions) {
+      auto* CopyInstr = dyn_cast<IRCopyNode>(IRInstr.get());
+      if (!CopyInstr)
+        continue;
+      size_t id = copies.size();
+      copyId[CopyInstr] = id;
+      copies.push_back({CopyInstr->ValSrc, CopyInstr->ValDest});
+    }
+    size_t NumCopies = copies.size();
+    involving.reserve(NumCopies);
+    staticCopies = BitVector(NumCopies);
+    for (size_t id = 0; id < NumCopies; id++) {
+      auto& C = copies[id];
+      auto& DestName = *getVarName(C.dest);
+      getInvolving(DestName).set(id);
+      copiesTo[DestName].push_back(id);
+      if (auto* SrcName = getVarName(C.src))
+        getInvolving(*SrcName).set(id);
+      if (nanocc::hasStaticStorage(*C.dest) ||
+          nanocc::hasStaticStorage(*C.src))
+        staticCopies.set(id);
+    }
+    solve();
+  }
+
+  size_t size() const { return copies.size(); }
+  const Copy& getCopy(size_t id) const { return copies[id]; }
+  const BitVector& getIn(const BasicBlock* BB) const {
+    return in[BB->blockId];
+  }
+
+  /// @return the copy `var = src` in `Reaching`, nullptr if there is none.
+  /// There is at most one, each copy to var kills the others.
+  const Copy* findCopyTo(const BitVector& Reaching,
+                         const std::string& var) const {
+    auto it = copiesTo.find(var);
+    if (it == copiesTo.end())
+      return nullptr;
+    for (size_t id : it->second) {
+      if (Reaching.test(id))
+        return &copies[id];
+    }
+    return nullptr;
+  }
+
+  /// @param Reaching a `BitVector` to step over `IRInstr`, or a
+  /// `GenKillTransfer` to summarize a block
+  template <typename Facts>
+  void transfer(IRInstructionNode* IRInstr, Facts& Reaching) const {
+    if (isa<IRFunctionCallNode>(IRInstr))
+      Reaching.reset(staticCopies);
+    if (IRValSlot Result = IRInstr->result()) {
+      auto it = involving.find(*getVarName(*Result));
+      if (it != involving.end())
+        Reaching.reset(it->second);
+    }
+    if (auto* CopyInstr = dyn_cast<IRCopyNode>(IRInstr))
+      Reaching.set(copyId.at(CopyInstr));
+  }
+
+private:
+  const ControlFlowGraph& CFG;
+  std::vector<Copy> copies;
+  std::unordered_map<const IRCopyNode*, size_t> copyId;
+  // variable => copies reading or writing it
+  std::unordered_map<std::string, BitVector> involving;
+  // variable => copies writing it
+  std::unordered_map<std::string, std::vector<size_t>> copiesTo;
+  BitVector staticCopies;
+  std::vector<BitVector> in; // by blockId
+
+  BitVector& getInvolving(const std::string& var) {
+    auto it = involving.find(var);
+    if (it == involving.end())
+      it = involving.emplace(var, BitVector(copies.size())).first;
+    return it->second;
+  }
+
+  // out(B) starts full so the intersection only shrinks, the entry and
+  // blocks without predecessors start with nothing
+  void solve() {
+    IntersectionProblem<DataflowDirection::Forward> Problem(CFG, copies.size());
+    for (auto& BB : CFG.blocks) {
+      auto& Transfer = Problem.getTransfer(BB.get());
+      for (auto& IRInstr : *BB) {
+        transfer(IRInstr.get(), Transfer);
+      }
+    }
+    in = DataflowSolver(CFG, Problem).takeIn();
+  }
+};
+
+struct RewriteResult {
+  bool changed = false;
+  bool erased = false;
+};
+
+RewriteResult rewriteFunction(IRFunctionNode& IRFunc,
+                              const ControlFlowGraph& CFG) {
+  ReachingCopies RC(IRFunc, CFG);
+  RewriteResult Result;
+  if (RC.size() == 0)
+    return Result;
+
+  for (auto& BB : CFG.blocks) {
+    BitVector Reaching = RC.getIn(BB.get());
+    for (auto it = BB->begin(), end = BB->end(); it != end;) {
+      IRInstructionNode* IRInstr = it->get();
+
+      // x = y is redundant if x = y or y = x already holds
+      if (auto* CopyInstr = dyn_cast<IRCopyNode>(IRInstr)) {
+        auto& Dest = *getVarName(CopyInstr->ValDest);
+        auto* ToDest = RC.findCopyTo(Reaching, Dest);
+        bool redundant = ToDest && sameValue(ToDest->src, CopyInstr->ValSrc);
+        bool selfCopy = sameValue(CopyInstr->ValDest, CopyInstr->ValSrc);
+        if (!redundant && !selfCopy) {
+          if (auto* SrcName = getVarName(CopyInstr->ValSrc)) {
+            auto* ToSrc = RC.findCopyTo(Reaching, *SrcName);
+            redundant = ToSrc && sameValue(ToSrc->src, CopyInstr->ValDest);
+          }
+        }
+        if (redundant || selfCopy) {
+          RC.transfer(IRInstr, Reaching);
+          it = IRFunc.IRInstructions.erase(it);
+          Result.changed = Result.erased = true;
+          continue;
+        }
+      }
+
+      for (IRValSlot Slot : IRInstr->operands()) {
+        auto* Name = getVarName(*Slot);
+        if (!Name)
+          continue;
+        if (auto* C = RC.findCopyTo(Reaching, *Name)) {
+          *Slot = C->src;
+          Result.changed = true;
+        }
+      }
+      RC.transfer(IRInstr, Reaching);
+      ++it;
+    }
+  }
+  return Result;
+}
+} // namespace
 
 namespace nanocc {
-/// @brief Yet to be implemented
-/// @param IRProgram
-/// @return
-bool CopyPropagate(IRProgramNode& IRProgram) { return false; }
+/// @brief Global copy propagation over reaching copies.
+/// @return changed if a use was rewritten or a redundant copy erased; the
+/// CFG is preserved unless a copy was erased
+PassResult CopyPropagate(IRFunctionNode& IRFunc, AnalysisManager& AM) {
+  const ControlFlowGraph& CFG = AM.getCFG(IRFunc);
+  if (CFG.empty())
+    return PassResult::unchanged();
+  RewriteResult Result = rewriteFunction(IRFunc, CFG);
+  if (!Result.changed)
+    return PassResult::unchanged();
+  // rewriting operands leaves the blocks alone, erasing a copy may not
+  return PassResult::modified(Result.erased ? PreservedAnalyses::none()
+                                            : PreservedAnalyses::cfgOnly());
+}
 } // namespace nanocc
@@ -1,9 +1,69 @@
-#include "nanocc/Transforms/DeadStoreElimination.hpp"
+#include <iterator>
+
+#include "nanocc/Analysis/Liveness.hpp"
+#include "nanocc/IR/BasicBlock.hpp"
 #include "nanocc/IR/IR.hpp"
+#include "nanocc/Transforms/DeadStoreElimination.hpp"
+#include "nanocc/Utils/BitVector.hpp"
+#include "nanocc/Utils/Utils.hpp"
+
+/*
+Remove:
+    Copy, Unary and Binary instructions whose destination is dead, i.e. not
+    read on any path before it is written again
+
+Keep:
+    writes to static variables, other functions (or later calls of this one)
+    may read them
+    function calls, even if the result is dead
+*/
+
+namespace {
+bool isRemovable(IRInstructionNode* IRInstr) {
+  return isa<IRCopyNode>(IRInstr) || isa<IRUnaryNode>(IRInstr) ||
+         isa<IRBinaryNode>(IRInstr) || isa<IRSelectNode>(IRInstr);
+}
+
+// walks every block backwards from its live-out set
+bool removeDeadStores(IRFunctionNode& IRFunc, const ControlFlowGraph& CFG,
+                      const Liveness& Live) {
+  bool changed = false;
+  for (auto& BB : CFG.blocks) {
+    BitVector LiveNow = Live.getLiveOut(BB.get());
+    auto first = BB->begin();
+    for (auto it = BB->end(); it != first;) {
+      --it;
+      IRInstructionNode* IRInstr = it->get();
+      if (isRemovable(IRInstr)) {
+        // untracked (static) destinations have no index and are kept
+        size_t idx = Live.getVarIndex(*IRInstr->result());
+        if (idx != Liveness::NoVar && !LiveNow.test(idx)) {
+          bool isFirst = it == first;
+          it = IRFunc.IRInstructions.erase(it);
+          changed = true;
+          if (isFirst)
+            break;
+          continue;
+        }
+      }
+      Live.stepBackward(IRInstr, LiveNow);
+    }
+  }
+  return changed;
+}
+} // namespace
 
 namespace nanocc {
-/// @brief Yet to be implemented
-/// @param IRProgram
-/// @return
-bool DeadStoreElimination(IRProgramNode& IRProgram) { return false; }
+/// @brief Liveness based dead store elimination
+/// @return changed if a store was removed; nothing is preserved, a block may
+/// have lost its first instruction
+PassResult DeadStoreElimination(IRFunctionNode& IRFunc, AnalysisManager& AM) {
+  const ControlFlowGraph& CFG = AM.getCFG(IRFunc);
+  if (CFG.empty())
+    return PassResult::unchanged();
+  if (!removeDeadStores(IRFunc, CFG, AM.getLiveness(IRFunc)))
+    return PassResult::unchanged();
+  // a block may have lost its first instruction
+  return PassResult::modified();
+}
 } // namespace nanocc
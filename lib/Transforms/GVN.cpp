@@ -0,0 +1,259 @@
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "nanocc/Analysis/Dominators.hpp"
+#include "nanocc/IR/BasicBlock.hpp"
+#include "nanocc/IR/DefUse.hpp"
+#include "nanocc/IR/IR.hpp"
+#include "nanocc/IR/SSA.hpp"
+#include "nanocc/Transforms/GVN.hpp"
+#include "nanocc/Utils/Utils.hpp"
+
+/*
+Dominator based value numbering (Briggs, Cooper and Simpson, "Value
+Numbering"), on SSA form. Every SSA value, constant and computation gets a
+value number, equal numbers mean equal values:
+    copies and phis whose operands all agree take the number of the operand
+    `op vn1 vn2` is looked up in a table scoped to the dominator tree: a hit
+    in a dominating block means the value is already in a variable, the
+    computation is replaced by a copy of it
+        t1 = a * b          t1 = a * b
+        ...            ->   ...
+        t7 = a * b          t7 = t1
+Static variables aren't in SSA form, any write to them or any call may change
+them. A read gets the number last written to the variable in the same block,
+or a fresh one after the variable was written through a call, at the start of
+a block (another path may have written it) and on first use. Computations on
+a stale number never match again, so the table needs no invalidation.
+*/
+
+namespace {
+using ValuePtr = std::shared_ptr<IRValNode>;
+
+struct ExprKey {
+  bool isUnary;
+  TokenType opType;
+  size_t lhs;
+  size_t rhs; // 0 for unary ops
+
+  bool operator==(const ExprKey&) const = default;
+};
+
+struct ExprKeyHash {
+  size_t operator()(const ExprKey& Key) const {
+    size_t hash = std::hash<size_t>()(Key.lhs);
+    hash = hash * 31 + std::hash<size_t>()(Key.rhs);
+    hash = hash * 31 + static_cast<size_t>(Key.opType);
+    return hash * 2 + Key.isUnary;
+  }
+};
+
+bool isCommutative(TokenType opType) {
+  switch (opType) {
+  case TokenType::PLUS:
+  case TokenType::STAR:
+  case TokenType::EQUAL:
+  case TokenType::NOT_EQUAL:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// @brief `a > b` is `b < a` and `a >= b` is `b <= a`
+ExprKey getBinaryKey(TokenType opType, size_t lhs, size_t rhs) {
+  if (opType == TokenType::GREATERTHAN) {
+    opType = TokenType::LESSTHAN;
+    std::swap(lhs, rhs);
+  } else if (opType == TokenType::GREATER_EQUAL) {
+    opType = TokenType::LESS_EQUAL;
+    std::swap(lhs, rhs);
+  } else if (isCommutative(opType) && rhs < lhs) {
+    std::swap(lhs, rhs);
+  }
+  return {false, opType, lhs, rhs};
+}
+
+class ValueNumbering {
+  ControlFlowGraph CFG;
+  DominatorTree DT;
+  size_t nextNumber = 1;
+  std::unordered_map<std::string, size_t> varNumbers; // SSA values
+  std::unordered_map<int, size_t> constNumbers;
+  // static variable => number of its current value, only within a block
+  std::unordered_map<std::string, size_t> staticNumbers;
+  struct Available {
+    size_t number;
+    std::string leader; // SSA variable holding the value
+  };
+  std::unordered_map<ExprKey, Available, ExprKeyHash> exprs;
+  // keys added by the blocks on the current dominator tree path
+  std::vector<ExprKey> scopeLog;
+  size_t numReplaced = 0;
+
+public:
+  explicit ValueNumbering(IRFunctionNode& IRFunc)
+      : CFG(IRFunc), DT(CFG) {
+    for (auto& Param : IRFunc.parameters) {
+      varNumbers[Param] = nextNumber++;
+    }
+  }
+
+  /// @return number of computations replaced by copies
+  size_t run() {
+    if (CFG.empty())
+      return 0;
+    // preorder over the dominator tree, a block's table entries are dropped
+    // once its subtree is done; iterative, the tree can be as deep as the CFG
+    struct Frame {
+      BasicBlock* BB;
+      size_t nextChild;
+      size_t scopeStart;
+    };
+    std::vector<Frame> stack;
+    auto enter = [&](BasicBlock* BB) {
+      stack.push_back({BB, 0, scopeLog.size()});
+      visitBlock(BB);
+    };
+    enter(CFG.getEntry());
+    while (!stack.empty()) {
+      auto& Top = stack.back();
+      auto& Children = DT.getChildren(Top.BB);
+      if (Top.nextChild < Children.size()) {
+        enter(Children[Top.nextChild++]);
+        continue;
+      }
+      for (size_t i = Top.scopeStart; i < scopeLog.size(); i++) {
+        exprs.erase(scopeLog[i]);
+      }
+      scopeLog.resize(Top.scopeStart);
+      stack.pop_back();
+    }
+    return numReplaced;
+  }
+
+private:
+  size_t getNumber(const ValuePtr& val) {
+    if (auto* Const = dyn_cast<IRConstNode>(val.get())) {
+      auto [it, inserted] = constNumbers.try_emplace(Const->IntVal, nextNumber);
+      if (inserted)
+        nextNumber++;
+      return it->second;
+    }
+    auto& Name = cast<IRVariableNode>(val.get())->varName;
+    // SSA values are numbered at their definition, which dominates every
+    // use outside of phis; what's left are reads of undefined variables
+    auto& Numbers = DefUseChains::isTracked(val.get()) ? varNumbers
+                                                       : staticNumbers;
+    auto [it, inserted] = Numbers.try_emplace(Name, nextNumber);
+    if (inserted)
+      nextNumber++;
+    return it->second;
+  }
+
+  void setNumber(IRInstructionNode* IRInstr, size_t number) {
+    auto* Dest = cast<IRVariableNode>(IRInstr->result()->get());
+    if (DefUseChains::isTracked(Dest))
+      varNumbers[Dest->varName] = number;
+    else
+      staticNumbers[Dest->varName] = number;
+  }
+
+  size_t visitPhi(IRPhiNode* Phi) {
+    // operands along back edges aren't numbered yet
+    size_t same = 0;
+    for (auto& In : Phi->incoming) {
+      size_t number = 0;
+      if (isa<IRConstNode>(In.value.get())) {
+        number = getNumber(In.value);
+      } else {
+        auto& Name = cast<IRVariableNode>(In.value.get())->varName;
+        auto it = varNumbers.find(Name);
+        if (it != varNumbers.end())
+          number = it->second;
+      }
+      if (number == 0 || (same && number != same))
+        return nextNumber++;
+      same = number;
+    }
+    return same ? same : nextNumber++;
+  }
+
+  /// @brief Looks up `Key`, records it with the result of `IRInstr` as
+  /// leader if it's new.
+  /// @return the number of the computation, and the leader holding it if it
+  /// was computed before
+  std::pair<size_t, const std::string*> lookup(const ExprKey& Key,
+                                               IRInstructionNode* IRInstr) {
+    auto it = exprs.find(Key);
+    if (it != exprs.end())
+      return {it->second.number, &it->second.leader};
+    size_t number = nextNumber++;
+    // a static variable can't stand in for the value later on
+    auto* Dest = cast<IRVariableNode>(IRInstr->result()->get());
+    if (DefUseChains::isTracked(Dest)) {
+      exprs.emplace(Key, Available{number, Dest->varName});
+      scopeLog.push_back(Key);
+    }
+    return {number, nullptr};
+  }
+
+  void visitBlock(BasicBlock* BB) {
+    staticNumbers.clear();
+    for (auto& IRInstr : *BB) {
+      if (auto* Phi = dyn_cast<IRPhiNode>(IRInstr.get())) {
+        setNumber(Phi, visitPhi(Phi));
+      } else if (auto* Copy = dyn_cast<IRCopyNode>(IRInstr.get())) {
+        setNumber(Copy, getNumber(Copy->ValSrc));
+      } else if (auto* Unary = dyn_cast<IRUnaryNode>(IRInstr.get())) {
+        ExprKey Key{true, Unary->opType, getNumber(Unary->valSrc), 0};
+        visitComputation(IRInstr, Key);
+      } else if (auto* Binary = dyn_cast<IRBinaryNode>(IRInstr.get())) {
+        ExprKey Key = getBinaryKey(Binary->opType, getNumber(Binary->valSrcL),
+                                   getNumber(Binary->valSrcR));
+        visitComputation(IRInstr, Key);
+      } else if (isa<IRSelectNode>(IRInstr.get())) {
+        setNumber(IRInstr.get(), nextNumber++);
+      } else if (isa<IRFunctionCallNode>(IRInstr.get())) {
+        // the callee may write any static variable
+        staticNumbers.clear();
+        if (IRInstr->result())
+          setNumber(IRInstr.get(), nextNumber++);
+      }
+    }
+  }
+
+  void visitComputation(std::unique_ptr<IRInstructionNode>& IRInstr,
+                        const ExprKey& Key) {
+    auto [number, Leader] = lookup(Key, IRInstr.get());
+    setNumber(IRInstr.get(), number);
+    if (!Leader)
+      return;
+    ValuePtr Dest = *IRInstr->result();
+    IRInstr = std::make_unique<IRCopyNode>(
+        std::make_shared<IRVariableNode>(*Leader), std::move(Dest));
+    numReplaced++;
+  }
+};
+} // namespace
+
+namespace nanocc {
+/// @brief Dominator scoped global value numbering, redundant unary and binary
+/// computations become copies of the variable that already holds the value.
+/// @return changed if a computation was replaced; the copies don't come back
+/// as computations, so the pass manager converges.
+PassResult GlobalValueNumbering(IRFunctionNode& IRFunc, AnalysisManager&) {
+  if (IRFunc.IRInstructions.empty())
+    return PassResult::unchanged();
+  constructSSA(IRFunc);
+  size_t numReplaced = ValueNumbering(IRFunc).run();
+  destructSSA(IRFunc);
+  // nothing is preserved either way, the round trip renames and relabels
+  return {numReplaced != 0, PreservedAnalyses::none()};
+}
+} // namespace nanocc
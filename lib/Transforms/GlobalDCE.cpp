@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <print>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "nanocc/Analysis/CallGraph.hpp"
+#include "nanocc/IR/IR.hpp"
+#include "nanocc/Transforms/GlobalDCE.hpp"
+#include "nanocc/Utils/Utils.hpp"
+
+/*
+Dead global elimination. Other files can only reach what has external
+linkage, so the `global` functions and variables are the roots; `main` is one
+of them anyway. A function reached from a root keeps the functions it calls
+and the static variables it names alive, variables keep nothing alive, their
+initializers are constants. Whatever is left is internal and unused: a
+`static` helper every call of which was inlined, a block scope `static` of a
+removed function, a `static` variable nothing reads. Calls are taken from the
+optimized functions, a call removed as unreachable or inlined doesn't count.
+*/
+
+namespace nanocc {
+bool EliminateDeadGlobals(IRProgramNode& IRProgram, bool debug) {
+  CallGraph CG(IRProgram);
+  std::unordered_set<const CallGraphNode*> liveFunctions;
+  std::unordered_set<std::string> liveVars;
+  std::vector<const CallGraphNode*> worklist;
+  for (auto& TopLvl : IRProgram.topLevel) {
+    if (auto* StaticVar = dyn_cast<IRStaticVarNode>(TopLvl.get());
+        StaticVar && StaticVar->global)
+      liveVars.insert(StaticVar->varName->name);
+  }
+  for (auto& Node : CG.getNodes()) {
+    if (Node->function->global || Node->function->funcName == "main") {
+      liveFunctions.insert(Node.get());
+      worklist.push_back(Node.get());
+    }
+  }
+  while (!worklist.empty()) {
+    const CallGraphNode* Node = worklist.back();
+    worklist.pop_back();
+    for (auto* Callee : Node->callees) {
+      if (liveFunctions.insert(Callee).second)
+        worklist.push_back(Callee);
+    }
+    for (auto& IRInstr : Node->function->IRInstructions) {
+      for (IRValSlot Slot : IRInstr->operands()) {
+        if (hasStaticStorage(**Slot))
+          liveVars.insert(cast<IRVariableNode>(Slot->get())->varName);
+      }
+      IRValSlot Result = IRInstr->result();
+      if (Result && *Result && hasStaticStorage(**Result))
+        liveVars.insert(cast<IRVariableNode>(Result->get())->varName);
+    }
+  }
+
+  auto isDead = [&](const std::unique_ptr<IRTopLevelNode>& TopLvl) {
+    if (auto* IRFunc = dyn_cast<IRFunctionNode>(TopLvl.get()))
+      return !liveFunctions.contains(CG.getNode(IRFunc->funcName));
+    auto* StaticVar = cast<IRStaticVarNode>(TopLvl.get());
+    return !liveVars.contains(StaticVar->varName->name);
+  };
+  auto& TopLevel = IRProgram.topLevel;
+  if (debug) {
+    for (auto& TopLvl : TopLevel) {
+      if (!isDead(TopLvl))
+        continue;
+      auto* IRFunc = dyn_cast<IRFunctionNode>(TopLvl.get());
+      std::println("---- IR Optimization: globaldce removed {} ----",
+                   IRFunc ? IRFunc->funcName
+                          : cast<IRStaticVarNode>(TopLvl.get())->varName->name);
+    }
+  }
+  size_t size = TopLevel.size();
+  TopLevel.erase(std::remove_if(TopLevel.begin(), TopLevel.end(), isDead),
+                 TopLevel.end());
+  return TopLevel.size() != size;
+}
+} // namespace nanocc
@@ -0,0 +1,401 @@
+#include <algorithm>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "nanocc/Analysis/Liveness.hpp"
+#include "nanocc/IR/BasicBlock.hpp"
+#include "nanocc/IR/IR.hpp"
+#include "nanocc/Transforms/IfConversion.hpp"
+#include "nanocc/Transforms/LoopUtils.hpp"
+#include "nanocc/Utils/Utils.hpp"
+
+/*
+If-conversion on the non-SSA instruction list. A branch around one or two
+straight-line arms that only compute values is replaced by both arms and a
+select for every variable they write that is live where they join:
+    jump_if a < b, else             t.1 = x + 1
+    t = x + 1                       r.2 = y
+    r = t                 ->        r = select a < b, r.2, t.1
+    jump end
+  else:
+    r = y
+  end:                            end:
+The arms write fresh variables, so neither sees the other's writes and the
+condition keeps its operands until the selects. Constants an arm copies go
+straight into the select, and choosing between 1 and 0 is the comparison
+itself: `r = a < b ? 1 : 0` becomes `r = a < b`, a `setcc`.
+A block doing nothing but test a second condition after the first, which is
+what `&&` and `||` lower to, is folded into the first one's block:
+    jump_if a >= b, X               t.1 = c == 0
+    jump_if c == 0, Y     ->        t.2 = select a >= b, 1, t.1
+  X:                                jump_if_true t.2, Y
+                                  X:
+for X == Y, with 0 in place of 1 when X is the block after the second test.
+Speculated instructions run on paths that skipped them before, so they must
+not trap (division by a variable) or call, and the work added to one path
+is bounded by `IfConversionBudget`. Blocks a conversion changed wait for the
+next run, converting inner hammocks first lets the outer ones follow.
+*/
+
+namespace {
+using ValuePtr = std::shared_ptr<IRValNode>;
+using InstrList = std::list<std::unique_ptr<IRInstructionNode>>;
+
+/// @brief `L opType R`, what a conditional branch jumps on
+struct Condition {
+  TokenType opType;
+  ValuePtr L;
+  ValuePtr R;
+};
+
+Condition getCondition(IRBranchNode* Branch) {
+  if (auto* JumpIfCmp = dyn_cast<IRJumpIfCmpNode>(Branch))
+    return {JumpIfCmp->opType, JumpIfCmp->valSrcL, JumpIfCmp->valSrcR};
+  auto Zero = std::make_shared<IRConstNode>(0);
+  if (auto* JumpIfZero = dyn_cast<IRJumpIfZeroNode>(Branch))
+    return {TokenType::EQUAL, JumpIfZero->condition, Zero};
+  auto* JumpIfNotZero = cast<IRJumpIfNotZeroNode>(Branch);
+  return {TokenType::NOT_EQUAL, JumpIfNotZero->condition, Zero};
+}
+
+/// @return what running `IRInstr` on every path costs, nullopt if it may trap
+/// or do more than write its result
+std::optional<unsigned> getSpeculationCost(IRInstructionNode* IRInstr) {
+  if (isa<IRCopyNode>(IRInstr) || isa<IRUnaryNode>(IRInstr))
+    return 1;
+  if (isa<IRSelectNode>(IRInstr))
+    return 2;
+  auto* Binary = dyn_cast<IRBinaryNode>(IRInstr);
+  if (!Binary)
+    return std::nullopt;
+  if (Binary->opType == TokenType::STAR)
+    return 3;
+  if (Binary->opType != TokenType::SLASH &&
+      Binary->opType != TokenType::PERCENT)
+    return 1;
+  auto* Divisor = dyn_cast<IRConstNode>(Binary->valSrcR.get());
+  if (!Divisor || Divisor->IntVal == 0 || Divisor->IntVal == -1)
+    return std::nullopt;
+  return 6; // multiplied by the reciprocal
+}
+
+bool sameValue(const ValuePtr& A, const ValuePtr& B) {
+  if (auto* ConstA = dyn_cast<IRConstNode>(A.get())) {
+    auto* ConstB = dyn_cast<IRConstNode>(B.get());
+    return ConstB && ConstA->IntVal == ConstB->IntVal;
+  }
+  auto* VarA = cast<IRVariableNode>(A.get());
+  auto* VarB = dyn_cast<IRVariableNode>(B.get());
+  return VarB && VarA->varName == VarB->varName;
+}
+
+bool isConstant(const ValuePtr& val, int IntVal) {
+  auto* Const = dyn_cast<IRConstNode>(val.get());
+  return Const && Const->IntVal == IntVal;
+}
+
+/// @brief One arm copied to run unconditionally, writing fresh variables.
+struct Arm {
+  InstrList Instructions;
+  /// @brief variable => its value at the end of the arm
+  std::unordered_map<std::string, ValuePtr> values;
+  std::vector<std::string> written; // in the order they're first written
+  unsigned cost = 0;
+
+  ValuePtr getValue(const std::string& var) const {
+    auto it = values.find(var);
+    if (it == values.end())
+      return std::make_shared<IRVariableNode>(var);
+    return nanocc::cloneValue(it->second);
+  }
+  /// @brief reads `Slot` as the arm left it
+  void rewrite(IRValSlot Slot) const {
+    if (auto* Var = dyn_cast<IRVariableNode>(Slot->get()))
+      *Slot = getValue(Var->varName);
+  }
+};
+
+class IfConverter {
+  IRFunctionNode& IRFunc;
+  const ControlFlowGraph& CFG;
+  const Liveness& Live;
+  std::vector<bool> changed; // by blockId
+
+public:
+  IfConverter(IRFunctionNode& IRFunc, const ControlFlowGraph& CFG,
+              const Liveness& Live)
+      : IRFunc(IRFunc), CFG(CFG), Live(Live), changed(CFG.size(), false) {}
+
+  /// @return true if anything was converted
+  bool run() {
+    bool converted = false;
+    for (auto& BB : CFG.blocks) {
+      // erased, or ends where an erased block began
+      if (changed[BB->blockId])
+        continue;
+      auto* Branch = dyn_cast<IRBranchNode>(BB->back());
+      if (!Branch || !Branch->isConditional())
+        continue;
+      converted |= convertHammock(BB.get(), Branch) ||
+                   mergeConditions(BB.get(), Branch);
+    }
+    return converted;
+  }
+
+private:
+  /// @return true if `BB` is only entered from `Head`, falling through or
+  /// jumping, and no earlier conversion touched it
+  bool isArmOf(const BasicBlock* BB, const BasicBlock* Head) const {
+    return BB && !changed[BB->blockId] && BB->predecessors.size() == 1 &&
+           BB->predecessors.front() == Head;
+  }
+
+  /// @return the block `Arm` continues in, nullptr if it ends in another
+  /// kind of branch
+  BasicBlock* getJoin(const BasicBlock* ArmBB) const {
+    auto* Last = ArmBB->back();
+    if (auto* Jump = dyn_cast<IRJumpNode>(Last))
+      return CFG.getBlockForLabel(Jump->labelId);
+    if (Last->isTerminator())
+      return nullptr;
+    return CFG.getLayoutSuccessor(ArmBB);
+  }
+
+  bool isLiveIn(const BasicBlock* BB, const std::string& var) const {
+    // static variables aren't tracked, they're never dead
+    return Live.getVarIndex(var) == Liveness::NoVar || Live.isLiveIn(BB, var);
+  }
+  bool isLiveOut(const BasicBlock* BB, const std::string& var) const {
+    return Live.getVarIndex(var) == Liveness::NoVar ||
+           Live.isLiveOut(BB, var);
+  }
+
+  /// @brief Copies [first, last) of an arm block, its label and a final
+  /// unconditional jump aside, writing fresh variables.
+  /// @return nullopt if an instruction can't be speculated
+  std::optional<Arm> speculate(BasicBlock::InstrIter first,
+                               BasicBlock::InstrIter last) {
+    Arm A;
+    for (auto it = first; it != last; ++it) {
+      IRInstructionNode* IRInstr = it->get();
+      if (isa<IRLabelNode>(IRInstr) || isa<IRJumpNode>(IRInstr))
+        continue;
+      auto* Copy = dyn_cast<IRCopyNode>(IRInstr);
+      bool copiesConstant = Copy && isa<IRConstNode>(Copy->ValSrc.get());
+      std::optional<unsigned> cost = 0;
+      if (!copiesConstant)
+        cost = getSpeculationCost(IRInstr);
+      if (!cost)
+        return std::nullopt;
+      A.cost += *cost;
+      auto& Dest = cast<IRVariableNode>(IRInstr->result()->get())->varName;
+      auto& Written = A.written;
+      if (std::find(Written.begin(), Written.end(), Dest) == Written.end())
+        Written.push_back(Dest);
+      if (copiesConstant) {
+        A.values[Dest] = Copy->ValSrc;
+        continue;
+      }
+      auto Clone = nanocc::cloneInstruction(IRInstr);
+      for (IRValSlot Slot : Clone->operands()) {
+        A.rewrite(Slot);
+      }
+      auto Fresh = std::make_shared<IRVariableNode>(IRFunc.createName(Dest));
+      A.values[Dest] = Fresh;
+      *Clone->result() = Fresh;
+      A.Instructions.push_back(std::move(Clone));
+    }
+    return A;
+  }
+
+  /// @brief `Head: jump_if c, Target` with `Next` falling through behind it,
+  /// both arms joining again, or `Next` alone skipped to `Target`.
+  bool convertHammock(BasicBlock* Head, IRBranchNode* Branch) {
+    BasicBlock* Next = CFG.getLayoutSuccessor(Head);
+    BasicBlock* Target = CFG.getBlockForLabel(Branch->labelId);
+    if (!isArmOf(Next, Head) || !Target || Target == Next)
+      return false;
+    BasicBlock* Join = getJoin(Next);
+    BasicBlock* TakenBB = nullptr; // the arm the branch jumps to, if any
+    if (Join != Target) {
+      if (Target != CFG.getLayoutSuccessor(Next) || !isArmOf(Target, Head) ||
+          getJoin(Target) != Join)
+        return false;
+      TakenBB = Target;
+    }
+    if (!Join || Join == Head || Join == Next || changed[Join->blockId] ||
+        !isa<IRLabelNode>(Join->front()))
+      return false;
+
+    auto Fall = speculate(Next->begin(), Next->end());
+    std::optional<Arm> Taken = Arm{};
+    if (TakenBB)
+      Taken = speculate(TakenBB->begin(), TakenBB->end());
+    if (!Fall || !Taken)
+      return false;
+
+    Condition Cond = getCondition(Branch);
+    auto readsCondition = [&](const std::string& var) {
+      return sameValue(Cond.L, std::make_shared<IRVariableNode>(var)) ||
+             sameValue(Cond.R, std::make_shared<IRVariableNode>(var));
+    };
+    std::vector<std::string> Vars = Fall->written;
+    for (auto& Var : Taken->written) {
+      if (std::find(Vars.begin(), Vars.end(), Var) == Vars.end())
+        Vars.push_back(Var);
+    }
+    std::erase_if(Vars, [&](auto& Var) { return !isLiveIn(Join, Var); });
+    // the selects read the condition, the one overwriting it goes last; if
+    // more do, the condition is computed once before them
+    auto Last = std::stable_partition(Vars.begin(), Vars.end(),
+                                      [&](auto& Var) {
+                                        return !readsCondition(Var);
+                                      });
+    InstrList Merged;
+    unsigned cost = Fall->cost + Taken->cost;
+    if (std::distance(Last, Vars.end()) > 1) {
+      auto Flag = std::make_shared<IRVariableNode>(IRFunc.createName("ifcvt"));
+      Merged.push_back(std::make_unique<IRBinaryNode>(
+          Cond.opType, nanocc::cloneValue(Cond.L), nanocc::cloneValue(Cond.R),
+          Flag));
+      Cond = {TokenType::NOT_EQUAL, Flag, std::make_shared<IRConstNode>(0)};
+      cost += 1;
+    }
+    for (auto& Var : Vars) {
+      ValuePtr ValTrue = Taken->getValue(Var);
+      ValuePtr ValFalse = Fall->getValue(Var);
+      auto Dest = std::make_shared<IRVariableNode>(Var);
+      if (sameValue(ValTrue, ValFalse)) {
+        if (!sameValue(ValTrue, Dest))
+          Merged.push_back(std::make_unique<IRCopyNode>(ValTrue, Dest));
+        cost += 1;
+        continue;
+      }
+      TokenType opType = Cond.opType;
+      bool isBool = isConstant(ValTrue, 1) && isConstant(ValFalse, 0);
+      if (isConstant(ValTrue, 0) && isConstant(ValFalse, 1)) {
+        opType = nanocc::getNegatedComparison(opType);
+        isBool = true;
+      }
+      if (isBool) {
+        Merged.push_back(std::make_unique<IRBinaryNode>(
+            opType, nanocc::cloneValue(Cond.L), nanocc::cloneValue(Cond.R),
+            Dest));
+        cost += 1;
+        continue;
+      }
+      Merged.push_back(std::make_unique<IRSelectNode>(
+          opType, nanocc::cloneValue(Cond.L), nanocc::cloneValue(Cond.R),
+          ValTrue, ValFalse, Dest));
+      cost += 2;
+    }
+    if (cost > nanocc::IfConversionBudget)
+      return false;
+
+    auto& Instructions = IRFunc.IRInstructions;
+    auto BranchIt = std::prev(Head->end());
+    BasicBlock* LastArm = TakenBB ? TakenBB : Next;
+    Instructions.splice(BranchIt, Fall->Instructions);
+    Instructions.splice(BranchIt, Taken->Instructions);
+    Instructions.splice(BranchIt, Merged);
+    auto After = Instructions.erase(BranchIt, LastArm->end());
+    if (CFG.getLayoutSuccessor(LastArm) != Join) {
+      auto* JoinLabel = Join->getLabel();
+      Instructions.insert(After, std::make_unique<IRJumpNode>(
+                                     JoinLabel->labelName, JoinLabel->labelId));
+    }
+    for (auto* BB : {Head, Next, TakenBB, Join}) {
+      if (BB)
+        changed[BB->blockId] = true;
+    }
+    return true;
+  }
+
+  /// @brief `Head: jump_if c1, X` followed by `Next: jump_if c2, Y` where X
+  /// is Y or the block after `Next`: one branch on a select of both.
+  bool mergeConditions(BasicBlock* Head, IRBranchNode* First) {
+    BasicBlock* Next = CFG.getLayoutSuccessor(Head);
+    if (!isArmOf(Next, Head))
+      return false;
+    auto* Second = dyn_cast<IRBranchNode>(Next->back());
+    BasicBlock* X = CFG.getBlockForLabel(First->labelId);
+    BasicBlock* Y = Second ? CFG.getBlockForLabel(Second->labelId) : nullptr;
+    BasicBlock* AfterNext = CFG.getLayoutSuccessor(Next);
+    if (!Second || !Second->isConditional() || !X || !Y || X == Next ||
+        (X != Y && X != AfterNext) || changed[X->blockId] ||
+        changed[Y->blockId])
+      return false;
+
+    auto Body = speculate(Next->begin(), std::prev(Next->end()));
+    if (!Body)
+      return false;
+    // `Next` ran only when `First` fell through, what it writes mustn't be
+    // needed after it
+    for (auto& Var : Body->written) {
+      if (isLiveOut(Next, Var))
+        return false;
+    }
+
+    // taking `Second` when `First` jumps too means X == Y
+    bool jumpIfZero = isa<IRJumpIfZeroNode>(Second);
+    ValuePtr SecondValue;
+    unsigned cost = Body->cost + 2;
+    if (auto* JumpIfCmp = dyn_cast<IRJumpIfCmpNode>(Second)) {
+      SecondValue =
+          std::make_shared<IRVariableNode>(IRFunc.createName("ifcvt"));
+      auto Compare = std::make_unique<IRBinaryNode>(
+          JumpIfCmp->opType, nanocc::cloneValue(JumpIfCmp->valSrcL),
+          nanocc::cloneValue(JumpIfCmp->valSrcR), SecondValue);
+      for (IRValSlot Slot : Compare->operands()) {
+        Body->rewrite(Slot);
+      }
+      Body->Instructions.push_back(std::move(Compare));
+      cost += 1;
+    } else {
+      SecondValue = nanocc::cloneValue(*Second->operands().front());
+      Body->rewrite(&SecondValue);
+    }
+    if (cost > nanocc::IfConversionBudget)
+      return false;
+
+    Condition Cond = getCondition(First);
+    int whenFirstJumps = (X == Y) != jumpIfZero;
+    auto Dest = std::make_shared<IRVariableNode>(IRFunc.createName("ifcvt"));
+    Body->Instructions.push_back(std::make_unique<IRSelectNode>(
+        Cond.opType, nanocc::cloneValue(Cond.L), nanocc::cloneValue(Cond.R),
+        std::make_shared<IRConstNode>(whenFirstJumps), SecondValue, Dest));
+    if (jumpIfZero)
+      Body->Instructions.push_back(std::make_unique<IRJumpIfZeroNode>(
+          nanocc::cloneValue(Dest), Second->labelName, Second->labelId));
+    else
+      Body->Instructions.push_back(std::make_unique<IRJumpIfNotZeroNode>(
+          nanocc::cloneValue(Dest), Second->labelName, Second->labelId));
+
+    auto& Instructions = IRFunc.IRInstructions;
+    auto FirstIt = std::prev(Head->end());
+    Instructions.splice(FirstIt, Body->Instructions);
+    Instructions.erase(FirstIt, Next->end());
+    changed[Head->blockId] = changed[Next->blockId] = true;
+    changed[X->blockId] = changed[Y->blockId] = true;
+    return true;
+  }
+};
+} // namespace
+
+namespace nanocc {
+/// @return changed if a branch was converted
+PassResult IfConversion(IRFunctionNode& IRFunc, AnalysisManager& AM) {
+  if (IRFunc.inSSAForm)
+    return PassResult::unchanged();
+  const ControlFlowGraph& CFG = AM.getCFG(IRFunc);
+  IfConverter Converter(IRFunc, CFG, AM.getLiveness(IRFunc));
+  if (!Converter.run())
+    return PassResult::unchanged();
+  return PassResult::modified();
+}
+} // namespace nanocc
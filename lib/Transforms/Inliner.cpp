@@ -0,0 +1,210 @@
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "nanocc/Analysis/CallGraph.hpp"
+#include "nanocc/IR/IR.hpp"
+#include "nanocc/Transforms/Inliner.hpp"
+#include "nanocc/Transforms/LoopUtils.hpp"
+#include "nanocc/Utils/Utils.hpp"
+
+/*
+Inlining on the non-SSA instruction lists, before the function passes run on
+the caller so they see through the copies. A call to a function defined in
+the program is replaced by its body, with fresh variables and labels, the
+arguments copied into the parameters and every return turned into a copy to
+the call's result and a jump past the body:
+                             a.2.main.0 = i.6
+                             b.3.main.1 = 3
+  tmp.9 = max(i.6, 3)  ->    jump_if a.2.main.0 >= b.3.main.1, inline.main.4
+                             tmp.9 = b.3.main.1
+                             jump inline.main.5
+                           inline.main.4:
+                             tmp.9 = a.2.main.0
+                           inline.main.5:
+Static variables keep their name, they're the same object in every copy.
+It runs on the components of the call graph bottom-up, a callee comes
+optimized and with its own calls inlined already. Calls within a component
+are recursion and stay, and a recursive function isn't inlined anywhere: a
+copy of it still makes all the calls but the first. One calling only itself
+is looked at again, tail recursion elimination may have made it a loop.
+A call is worth inlining when the callee isn't much bigger than the call
+sequence it saves (moving the arguments, spilling the parameters in the
+prologue, the call and the return), counting a constant argument as the
+instructions reading the parameter, which folding should make constant too.
+*/
+
+namespace {
+using InstrList = std::list<std::unique_ptr<IRInstructionNode>>;
+
+/// @return true if control never falls through `IRInstr`
+bool isUnconditionalExit(const IRInstructionNode* IRInstr) {
+  if (isa<IRRetNode>(IRInstr))
+    return true;
+  auto* Jump = dyn_cast<IRBranchNode>(IRInstr);
+  return Jump && !Jump->isConditional();
+}
+
+class Inliner {
+  const CallGraph& CG;
+
+public:
+  explicit Inliner(const CallGraph& CG) : CG(CG) {}
+
+  /// @return true if a call in `IRFunc` was inlined
+  bool run(IRFunctionNode& IRFunc) {
+    const CallGraphNode* Node = CG.getNode(IRFunc.funcName);
+    auto& Instructions = IRFunc.IRInstructions;
+    bool inlined = false;
+    for (auto it = Instructions.begin(); it != Instructions.end();) {
+      auto* Call = dyn_cast<IRFunctionCallNode>(it->get());
+      // not a call, or to a function defined elsewhere
+      const CallGraphNode* Callee = Call ? CG.getNode(Call->funcName) : nullptr;
+      if (!Callee || Callee->sccId == Node->sccId || isRecursive(*Callee) ||
+          !isWorthInlining(IRFunc, *Call, *Callee->function)) {
+        ++it;
+        continue;
+      }
+      // the body's calls were looked at when the callee was optimized
+      it = inlineCall(IRFunc, it, *Callee->function);
+      inlined = true;
+    }
+    return inlined;
+  }
+
+private:
+  bool isRecursive(const CallGraphNode& Node) {
+    if (CG.getSCCs()[Node.sccId].size() > 1)
+      return true;
+    for (auto& IRInstr : Node.function->IRInstructions) {
+      auto* Call = dyn_cast<IRFunctionCallNode>(IRInstr.get());
+      if (Call && Call->funcName == Node.function->funcName)
+        return true;
+    }
+    return false;
+  }
+
+  bool isWorthInlining(const IRFunctionNode& Caller,
+                       const IRFunctionCallNode& Call,
+                       const IRFunctionNode& Callee) {
+    if (Call.arguments.size() != Callee.parameters.size())
+      return false;
+    // what the call sequence costs: the call, the return, the result move,
+    // and per argument a move and the parameter's spill in the prologue
+    size_t saved = 3 + 2 * Call.arguments.size();
+    size_t size = 0;
+    bool reachable = true;
+    for (auto& IRInstr : Callee.IRInstructions) {
+      if (isa<IRLabelNode>(IRInstr.get())) {
+        reachable = true;
+        continue;
+      }
+      if (!reachable)
+        continue; // the `return 0` after the last return, mostly
+      size++;
+      reachable = !isUnconditionalExit(IRInstr.get());
+      for (IRValSlot Slot : IRInstr->operands()) {
+        auto* Var = dyn_cast<IRVariableNode>(Slot->get());
+        if (Var && isConstantParameter(Call, Callee, Var->varName))
+          saved++;
+      }
+    }
+    if (Caller.IRInstructions.size() + size > nanocc::InlineFunctionBudget)
+      return false;
+    return size <= nanocc::InlineSizeBudget + saved;
+  }
+
+  /// @return true if `varName` is a parameter of `Callee` that `Call` passes
+  /// a constant for
+  bool isConstantParameter(const IRFunctionCallNode& Call,
+                           const IRFunctionNode& Callee,
+                           const std::string& varName) {
+    for (size_t i = 0; i < Callee.parameters.size(); i++) {
+      if (Callee.parameters[i] == varName)
+        return isa<IRConstNode>(Call.arguments[i].get());
+    }
+    return false;
+  }
+
+  /// @brief Replaces the call at `CallIt` by a copy of `Callee`'s body.
+  /// @return the instruction after the copy
+  InstrList::iterator inlineCall(IRFunctionNode& Caller,
+                                 InstrList::iterator CallIt,
+                                 IRFunctionNode& Callee) {
+    auto* Call = cast<IRFunctionCallNode>(CallIt->get());
+    auto& Body = Callee.IRInstructions;
+    InstrList Clones =
+        nanocc::cloneRange(Caller, Body.begin(), Body.end(), "inline");
+    auto End = Caller.createLabel("inline");
+
+    // callee variable => its caller variable, static ones aren't in it
+    std::unordered_map<std::string, std::string> Renamed;
+    auto rename = [&](IRValSlot Slot) {
+      auto* Var = dyn_cast<IRVariableNode>(Slot->get());
+      if (!Var || nanocc::hasStaticStorage(*Var))
+        return;
+      auto [it, inserted] = Renamed.try_emplace(Var->varName);
+      if (inserted)
+        it->second = Caller.createName(Var->varName);
+      *Slot = std::make_shared<IRVariableNode>(it->second);
+    };
+
+    InstrList Inlined;
+    for (size_t i = 0; i < Call->arguments.size(); i++) {
+      std::shared_ptr<IRValNode> Param =
+          std::make_shared<IRVariableNode>(Callee.parameters[i]);
+      rename(&Param);
+      Inlined.push_back(std::make_unique<IRCopyNode>(
+          nanocc::cloneValue(Call->arguments[i]), Param));
+    }
+    bool reachable = true;
+    for (auto it = Clones.begin(); it != Clones.end(); ++it) {
+      IRInstructionNode* IRInstr = it->get();
+      if (isa<IRLabelNode>(IRInstr))
+        reachable = true;
+      else if (!reachable)
+        continue;
+      else
+        reachable = !isUnconditionalExit(IRInstr);
+
+      for (IRValSlot Slot : IRInstr->operands()) {
+        rename(Slot);
+      }
+      if (IRValSlot Result = IRInstr->result(); Result && *Result)
+        rename(Result);
+      auto* Ret = dyn_cast<IRRetNode>(IRInstr);
+      if (!Ret) {
+        Inlined.push_back(std::move(*it));
+        continue;
+      }
+      if (Ret->retValue && Call->returnDest)
+        Inlined.push_back(std::make_unique<IRCopyNode>(
+            Ret->retValue, nanocc::cloneValue(Call->returnDest)));
+      Inlined.push_back(
+          std::make_unique<IRJumpNode>(End->labelName, End->labelId));
+    }
+    // the last return falls through to the end instead
+    if (!Inlined.empty() && isa<IRJumpNode>(Inlined.back().get()) &&
+        cast<IRJumpNode>(Inlined.back().get())->labelId == End->labelId)
+      Inlined.pop_back();
+    Inlined.push_back(std::move(End));
+
+    auto& Instructions = Caller.IRInstructions;
+    Instructions.splice(CallIt, Inlined);
+    return Instructions.erase(CallIt);
+  }
+};
+} // namespace
+
+namespace nanocc {
+bool InlineCalls(const std::vector<CallGraphNode*>& SCC, const CallGraph& CG) {
+  Inliner Inline(CG);
+  bool changed = false;
+  for (auto* Node : SCC) {
+    changed |= Inline.run(*Node->function);
+  }
+  return changed;
+}
+} // namespace nanocc
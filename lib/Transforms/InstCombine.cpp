@@ -0,0 +1,484 @@
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "nanocc/IR/DefUse.hpp"
+#include "nanocc/IR/IR.hpp"
+#include "nanocc/IR/SSA.hpp"
+#include "nanocc/Transforms/ConstantFolding.hpp"
+#include "nanocc/Transforms/InstCombine.hpp"
+#include "nanocc/Transforms/LoopUtils.hpp"
+#include "nanocc/Utils/Utils.hpp"
+
+/*
+Instruction combining on SSA form, driven by a worklist like the sparse
+propagation: every rewrite revisits the users of the value it changed.
+Constants go to the right first:
+    c + x -> x + c    c * x -> x * c    c == x -> x == c    c < x -> x > c
+    x - c -> x + -c
+then binary instructions are matched against the tables below, `x` any value,
+`c` a constant and `b` a value that is 0 or 1 (a comparison, `!`, `&&`, `||`):
+    x + 0, x * 1, x / 1            -> x
+    x * 0, x % 1, x && 0           -> 0
+    x * -1                         -> -x
+    x && c, x || 0                 -> x != 0  (c != 0)
+    x || c                         -> 1       (c != 0)
+    x - x, x != x, x < x, x > x    -> 0
+    x == x, x <= x, x >= x         -> 1
+    x && x, x || x                 -> x != 0
+    b != 0, b == 1                 -> b
+    b == c, b != c                 -> 0, 1    (c not 0 or 1)
+    (a < d) == 0, (a < d) != 1     -> a >= d  (any comparison, negated)
+    (x + c1) + c2                  -> x + (c1 + c2)
+    (c1 - x) + c2                  -> (c1 + c2) - x
+    (x * c1) * c2                  -> x * (c1 * c2)
+and unary instructions and branches against
+    --x, ~~x                       -> x
+    !(a < d)                       -> a >= d
+    !!x                            -> x != 0
+    jz (x != 0), jnz (x != 0)      -> jz x, jnz x
+    jz (x == 0), jz !x             -> jnz x, and jnz likewise
+    jnz (a < d), jz (a < d)        -> jump_if a < d, jump_if a >= d
+    jump_if c < x                  -> jump_if x > c
+    jump_if x != 0, jump_if x == 0 -> jnz x, jz x
+Constants are combined with the wrapping folds constant folding uses, and
+divisions by -1 stay, they trap for INT_MIN. A rule that looks through the
+definition of an operand only does so if that definition's operands are
+constants or SSA values; a static variable may have changed in between.
+*/
+
+namespace {
+using ValuePtr = std::shared_ptr<IRValNode>;
+
+const std::string* getSSAName(const ValuePtr& val) {
+  if (!DefUseChains::isTracked(val.get()))
+    return nullptr;
+  return &cast<IRVariableNode>(val.get())->varName;
+}
+
+/// @return true if `val` reads the same anywhere it's dominated
+bool isStable(const ValuePtr& val) {
+  return isa<IRConstNode>(val.get()) || getSSAName(val);
+}
+
+std::optional<int> getConst(const ValuePtr& val) {
+  if (auto* Const = dyn_cast<IRConstNode>(val.get()))
+    return Const->IntVal;
+  return std::nullopt;
+}
+
+bool isSameValue(const ValuePtr& A, const ValuePtr& B) {
+  auto* VarA = dyn_cast<IRVariableNode>(A.get());
+  auto* VarB = dyn_cast<IRVariableNode>(B.get());
+  // static variables too, both operands are read at the same time
+  return VarA && VarB && VarA->varName == VarB->varName;
+}
+
+bool isCommutative(TokenType opType) {
+  switch (opType) {
+  case TokenType::PLUS:
+  case TokenType::STAR:
+  case TokenType::EQUAL:
+  case TokenType::NOT_EQUAL:
+  case TokenType::AND:
+  case TokenType::OR:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// @brief what a rule of the tables turns `x op ...` into
+enum class Combined { Operand, Zero, One, Negated, NotZero };
+
+/// @brief `x op c`; `c` nullopt matches any constant but 0
+struct ConstantRule {
+  TokenType opType;
+  std::optional<int> rhs;
+  Combined result;
+};
+
+const ConstantRule ConstantRules[] = {
+    {TokenType::PLUS, 0, Combined::Operand},
+    {TokenType::STAR, 1, Combined::Operand},
+    {TokenType::SLASH, 1, Combined::Operand},
+    {TokenType::STAR, 0, Combined::Zero},
+    {TokenType::PERCENT, 1, Combined::Zero},
+    {TokenType::AND, 0, Combined::Zero},
+    {TokenType::STAR, -1, Combined::Negated},
+    {TokenType::AND, std::nullopt, Combined::NotZero},
+    {TokenType::OR, 0, Combined::NotZero},
+    {TokenType::OR, std::nullopt, Combined::One},
+};
+
+/// @brief `x op x`
+struct SameOperandRule {
+  TokenType opType;
+  Combined result;
+};
+
+const SameOperandRule SameOperandRules[] = {
+    {TokenType::MINUS, Combined::Zero},
+    {TokenType::NOT_EQUAL, Combined::Zero},
+    {TokenType::LESSTHAN, Combined::Zero},
+    {TokenType::GREATERTHAN, Combined::Zero},
+    {TokenType::EQUAL, Combined::One},
+    {TokenType::LESS_EQUAL, Combined::One},
+    {TokenType::GREATER_EQUAL, Combined::One},
+    {TokenType::AND, Combined::NotZero},
+    {TokenType::OR, Combined::NotZero},
+};
+
+class InstCombiner {
+  DefUseChains DU;
+  std::deque<IRInstructionNode*> worklist;
+  size_t numCombined = 0;
+
+public:
+  explicit InstCombiner(IRFunctionNode& IRFunc) : DU(IRFunc) {
+    for (auto& IRInstr : IRFunc.IRInstructions) {
+      worklist.push_back(IRInstr.get());
+    }
+  }
+
+  /// @return number of rewritten or removed instructions
+  size_t run() {
+    while (!worklist.empty()) {
+      IRInstructionNode* IRInstr = worklist.front();
+      worklist.pop_front();
+      if (DU.contains(IRInstr))
+        visit(IRInstr);
+    }
+    return numCombined;
+  }
+
+private:
+  /// @return the instruction computing `val`, through copies of SSA values
+  IRInstructionNode* getDef(const ValuePtr& val) const {
+    const std::string* Name = getSSAName(val);
+    IRInstructionNode* Def = Name ? DU.getDef(*Name) : nullptr;
+    while (auto* Copy = dyn_cast<IRCopyNode>(Def)) {
+      Name = getSSAName(Copy->ValSrc);
+      Def = Name ? DU.getDef(*Name) : nullptr;
+    }
+    return Def;
+  }
+
+  /// @return the comparison defining `val`, if its operands are stable
+  IRBinaryNode* getComparison(const ValuePtr& val) const {
+    auto* Compare = dyn_cast<IRBinaryNode>(getDef(val));
+    if (!Compare || !nanocc::isComparison(Compare->opType) ||
+        !isStable(Compare->valSrcL) || !isStable(Compare->valSrcR))
+      return nullptr;
+    return Compare;
+  }
+
+  bool isBoolean(const ValuePtr& val) const {
+    if (auto Const = getConst(val))
+      return *Const == 0 || *Const == 1;
+    IRInstructionNode* Def = getDef(val);
+    if (auto* Unary = dyn_cast<IRUnaryNode>(Def))
+      return Unary->opType == TokenType::NOT;
+    auto* Binary = dyn_cast<IRBinaryNode>(Def);
+    return Binary && (nanocc::isComparison(Binary->opType) ||
+                      Binary->opType == TokenType::AND ||
+                      Binary->opType == TokenType::OR);
+  }
+
+  void pushOperandDefs(IRInstructionNode* IRInstr) {
+    for (IRValSlot Slot : IRInstr->operands()) {
+      const std::string* Name = getSSAName(*Slot);
+      if (IRInstructionNode* Def = Name ? DU.getDef(*Name) : nullptr)
+        worklist.push_back(Def);
+    }
+  }
+
+  /// @brief the users of `val`, and of copies of it
+  void pushUsers(const ValuePtr& val) {
+    const std::string* Name = getSSAName(val);
+    if (!Name)
+      return;
+    for (auto& U : DU.getUses(*Name)) {
+      worklist.push_back(U.user);
+      if (auto* Copy = dyn_cast<IRCopyNode>(U.user))
+        pushUsers(Copy->ValDest);
+    }
+  }
+
+  /// @brief Puts `NewInstr` in place of `IRInstr` and revisits both it and
+  /// the users of its result.
+  void replace(IRInstructionNode* IRInstr,
+               std::unique_ptr<IRInstructionNode> NewInstr) {
+    pushOperandDefs(IRInstr);
+    IRInstructionNode* New = DU.replace(IRInstr, std::move(NewInstr));
+    worklist.push_back(New);
+    if (IRValSlot Result = New->result())
+      pushUsers(*Result);
+    numCombined++;
+  }
+
+  /// @brief The result of `IRInstr` is `val`: uses of an SSA result read
+  /// `val` instead, a static one (or one that is `val` only here) gets a copy.
+  void forward(IRInstructionNode* IRInstr, const ValuePtr& val) {
+    ValuePtr Dest = *IRInstr->result();
+    const std::string* Name = getSSAName(Dest);
+    if (!Name || !isStable(val)) {
+      replace(IRInstr, std::make_unique<IRCopyNode>(val, Dest));
+      return;
+    }
+    auto Users = DU.replaceAllUsesWith(*Name, val);
+    worklist.insert(worklist.end(), Users.begin(), Users.end());
+    pushOperandDefs(IRInstr);
+    DU.erase(IRInstr);
+    numCombined++;
+  }
+
+  void apply(IRInstructionNode* IRInstr, Combined result, const ValuePtr& x) {
+    ValuePtr Dest = *IRInstr->result();
+    switch (result) {
+    case Combined::Operand:
+      forward(IRInstr, x);
+      break;
+    case Combined::Zero:
+    case Combined::One:
+      forward(IRInstr,
+              std::make_shared<IRConstNode>(result == Combined::One ? 1 : 0));
+      break;
+    case Combined::Negated:
+      replace(IRInstr,
+              std::make_unique<IRUnaryNode>(TokenType::MINUS, x, Dest));
+      break;
+    case Combined::NotZero:
+      replace(IRInstr, std::make_unique<IRBinaryNode>(
+                           TokenType::NOT_EQUAL, x,
+                           std::make_shared<IRConstNode>(0), Dest));
+      break;
+    }
+  }
+
+  /// @brief `Compare` with the opposite outcome, written to `Dest`
+  std::unique_ptr<IRInstructionNode> negate(IRBinaryNode* Compare,
+                                            const ValuePtr& Dest) {
+    return std::make_unique<IRBinaryNode>(
+        nanocc::getNegatedComparison(Compare->opType), Compare->valSrcL,
+        Compare->valSrcR, Dest);
+  }
+
+  void visit(IRInstructionNode* IRInstr) {
+    IRValSlot Result = IRInstr->result();
+    if (Result && getSSAName(*Result) &&
+        !isa<IRFunctionCallNode>(IRInstr) &&
+        DU.use_empty(*getSSAName(*Result))) {
+      pushOperandDefs(IRInstr);
+      DU.erase(IRInstr);
+      numCombined++;
+      return;
+    }
+    if (auto* Binary = dyn_cast<IRBinaryNode>(IRInstr))
+      visitBinary(Binary);
+    else if (auto* Unary = dyn_cast<IRUnaryNode>(IRInstr))
+      visitUnary(Unary);
+    else if (auto* Branch = dyn_cast<IRBranchNode>(IRInstr))
+      visitBranch(Branch);
+  }
+
+  void visitBinary(IRBinaryNode* Binary) {
+    TokenType opType = Binary->opType;
+    const ValuePtr& L = Binary->valSrcL;
+    const ValuePtr& R = Binary->valSrcR;
+    auto ConstL = getConst(L);
+    auto ConstR = getConst(R);
+    if (ConstL && ConstR) {
+      if (auto Folded = nanocc::foldBinaryOp(opType, *ConstL, *ConstR))
+        forward(Binary, std::make_shared<IRConstNode>(*Folded));
+      return;
+    }
+    if (ConstL && (isCommutative(opType) || nanocc::isComparison(opType))) {
+      if (!isCommutative(opType))
+        opType = nanocc::getSwappedComparison(opType);
+      replace(Binary,
+              std::make_unique<IRBinaryNode>(opType, R, L, Binary->valDest));
+      return;
+    }
+    if (ConstR && opType == TokenType::MINUS) {
+      auto Negated = nanocc::foldUnaryOp(TokenType::MINUS, *ConstR);
+      replace(Binary, std::make_unique<IRBinaryNode>(
+                          TokenType::PLUS, L,
+                          std::make_shared<IRConstNode>(*Negated),
+                          Binary->valDest));
+      return;
+    }
+
+    if (isSameValue(L, R)) {
+      for (auto& Rule : SameOperandRules) {
+        if (Rule.opType == opType) {
+          apply(Binary, Rule.result, L);
+          return;
+        }
+      }
+    }
+    if (!ConstR)
+      return;
+    for (auto& Rule : ConstantRules) {
+      if (Rule.opType == opType &&
+          (Rule.rhs ? *Rule.rhs == *ConstR : *ConstR != 0)) {
+        apply(Binary, Rule.result, L);
+        return;
+      }
+    }
+    if ((opType == TokenType::EQUAL || opType == TokenType::NOT_EQUAL) &&
+        isBoolean(L)) {
+      combineBooleanTest(Binary, *ConstR);
+      return;
+    }
+    if (opType == TokenType::PLUS || opType == TokenType::STAR)
+      reassociate(Binary, *ConstR);
+  }
+
+  /// @brief `b == c` and `b != c` with `b` 0 or 1
+  void combineBooleanTest(IRBinaryNode* Binary, int c) {
+    bool isEqual = Binary->opType == TokenType::EQUAL;
+    if (c != 0 && c != 1) {
+      apply(Binary, isEqual ? Combined::Zero : Combined::One, nullptr);
+      return;
+    }
+    // true when b is c for ==, when it isn't for !=
+    if (isEqual == (c == 1)) {
+      apply(Binary, Combined::Operand, Binary->valSrcL);
+      return;
+    }
+    if (auto* Compare = getComparison(Binary->valSrcL))
+      replace(Binary, negate(Compare, Binary->valDest));
+  }
+
+  /// @brief `(x op c1) op c2`, `op` + or *
+  void reassociate(IRBinaryNode* Binary, int c2) {
+    auto* Inner = dyn_cast<IRBinaryNode>(getDef(Binary->valSrcL));
+    if (!Inner)
+      return;
+    auto c1L = getConst(Inner->valSrcL);
+    auto c1R = getConst(Inner->valSrcR);
+    if (Inner->opType == Binary->opType && c1R && isStable(Inner->valSrcL)) {
+      auto c = nanocc::foldBinaryOp(Binary->opType, *c1R, c2);
+      replace(Binary, std::make_unique<IRBinaryNode>(
+                          Binary->opType, Inner->valSrcL,
+                          std::make_shared<IRConstNode>(*c), Binary->valDest));
+    } else if (Binary->opType == TokenType::PLUS &&
+               Inner->opType == TokenType::MINUS && c1L &&
+               isStable(Inner->valSrcR)) {
+      auto c = nanocc::foldBinaryOp(TokenType::PLUS, *c1L, c2);
+      replace(Binary, std::make_unique<IRBinaryNode>(
+                          TokenType::MINUS, std::make_shared<IRConstNode>(*c),
+                          Inner->valSrcR, Binary->valDest));
+    }
+  }
+
+  void visitUnary(IRUnaryNode* Unary) {
+    if (auto Const = getConst(Unary->valSrc)) {
+      if (auto Folded = nanocc::foldUnaryOp(Unary->opType, *Const))
+        forward(Unary, std::make_shared<IRConstNode>(*Folded));
+      return;
+    }
+    if (Unary->opType == TokenType::NOT) {
+      if (auto* Compare = getComparison(Unary->valSrc)) {
+        replace(Unary, negate(Compare, Unary->valDest));
+        return;
+      }
+    }
+    auto* Inner = dyn_cast<IRUnaryNode>(getDef(Unary->valSrc));
+    if (!Inner || Inner->opType != Unary->opType || !isStable(Inner->valSrc))
+      return;
+    if (Unary->opType == TokenType::NOT)
+      apply(Unary, Combined::NotZero, Inner->valSrc);
+    else
+      apply(Unary, Combined::Operand, Inner->valSrc);
+  }
+
+  /// @brief Branches on `x != 0`, `x == 0` and `!x` test `x` directly,
+  /// branches on any other comparison make it themselves.
+  void visitBranch(IRBranchNode* Branch) {
+    if (auto* JumpIfCmp = dyn_cast<IRJumpIfCmpNode>(Branch)) {
+      visitCompareBranch(JumpIfCmp);
+      return;
+    }
+    if (!Branch->isConditional())
+      return;
+    const ValuePtr& Cond = *Branch->operands().front();
+    IRInstructionNode* Def = getDef(Cond);
+    ValuePtr x;
+    bool flip = false;
+    auto* Binary = dyn_cast<IRBinaryNode>(Def);
+    if (Binary &&
+        (Binary->opType == TokenType::NOT_EQUAL ||
+         Binary->opType == TokenType::EQUAL) &&
+        getConst(Binary->valSrcR) == 0) {
+      x = Binary->valSrcL;
+      flip = Binary->opType == TokenType::EQUAL;
+    } else if (auto* Compare = getComparison(Cond)) {
+      TokenType opType = isa<IRJumpIfZeroNode>(Branch)
+                             ? nanocc::getNegatedComparison(Compare->opType)
+                             : Compare->opType;
+      replace(Branch, std::make_unique<IRJumpIfCmpNode>(
+                          opType, Compare->valSrcL, Compare->valSrcR,
+                          Branch->labelName, Branch->labelId));
+      return;
+    } else if (auto* Unary = dyn_cast<IRUnaryNode>(Def)) {
+      if (Unary->opType != TokenType::NOT)
+        return;
+      x = Unary->valSrc;
+      flip = true;
+    }
+    if (!x || !isStable(x))
+      return;
+    replaceWithTest(Branch, x, isa<IRJumpIfZeroNode>(Branch) != flip);
+  }
+
+  void visitCompareBranch(IRJumpIfCmpNode* Branch) {
+    auto ConstL = getConst(Branch->valSrcL);
+    auto ConstR = getConst(Branch->valSrcR);
+    if (ConstL && !ConstR) {
+      replace(Branch, std::make_unique<IRJumpIfCmpNode>(
+                          nanocc::getSwappedComparison(Branch->opType),
+                          Branch->valSrcR, Branch->valSrcL, Branch->labelName,
+                          Branch->labelId));
+      return;
+    }
+    if (!ConstL && ConstR == 0 &&
+        (Branch->opType == TokenType::EQUAL ||
+         Branch->opType == TokenType::NOT_EQUAL))
+      replaceWithTest(Branch, Branch->valSrcL,
+                      Branch->opType == TokenType::EQUAL);
+  }
+
+  /// @brief `Branch` becomes `jz x` or `jnz x` to the same label
+  void replaceWithTest(IRBranchNode* Branch, const ValuePtr& x,
+                       bool jumpIfZero) {
+    std::unique_ptr<IRInstructionNode> New;
+    if (jumpIfZero)
+      New = std::make_unique<IRJumpIfZeroNode>(x, Branch->labelName,
+                                               Branch->labelId);
+    else
+      New = std::make_unique<IRJumpIfNotZeroNode>(x, Branch->labelName,
+                                                  Branch->labelId);
+    replace(Branch, std::move(New));
+  }
+};
+} // namespace
+
+namespace nanocc {
+/// @brief Algebraic simplification of unary and binary instructions and of
+/// branch conditions, see the tables above.
+/// @return changed if an instruction was rewritten or removed
+PassResult InstCombine(IRFunctionNode& IRFunc, AnalysisManager&) {
+  if (IRFunc.IRInstructions.empty())
+    return PassResult::unchanged();
+  constructSSA(IRFunc);
+  size_t numCombined = InstCombiner(IRFunc).run();
+  destructSSA(IRFunc);
+  // nothing is preserved either way, the round trip renames and relabels
+  return {numCombined != 0, PreservedAnalyses::none()};
+}
+} // namespace nanocc
@@ -0,0 +1,168 @@
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "nanocc/Analysis/Dominators.hpp"
+#include "nanocc/Analysis/LoopInfo.hpp"
+#include "nanocc/IR/BasicBlock.hpp"
+#include "nanocc/IR/DefUse.hpp"
+#include "nanocc/IR/IR.hpp"
+#include "nanocc/IR/SSA.hpp"
+#include "nanocc/Transforms/LICM.hpp"
+#include "nanocc/Transforms/LoopUtils.hpp"
+#include "nanocc/Utils/Utils.hpp"
+
+/*
+Loop invariant code motion on SSA form, inner loops first:
+    preheader:                    preheader:
+                                    t = a * b
+    header:                       header:
+      t = a * b          ->         ...
+      x = x + t                     x = x + t
+A unary, binary or select instruction is invariant if every operand is a
+constant, an SSA value defined outside the loop (or already hoisted), or a
+static variable the loop neither writes nor may write through a call. Hoisted
+instructions run even when the loop body wouldn't have, so divisions are
+only hoisted by constants that can't trap (0, and -1 for INT_MIN / -1).
+SSA values have a single definition that dominates their uses, so there is
+no other write to clobber and no use that could see an older value.
+*/
+
+namespace {
+bool isSafeToSpeculate(IRInstructionNode* IRInstr) {
+  auto* Binary = dyn_cast<IRBinaryNode>(IRInstr);
+  if (!Binary)
+    return isa<IRUnaryNode>(IRInstr) || isa<IRSelectNode>(IRInstr);
+  if (Binary->opType != TokenType::SLASH &&
+      Binary->opType != TokenType::PERCENT)
+    return true;
+  auto* Divisor = dyn_cast<IRConstNode>(Binary->valSrcR.get());
+  return Divisor && Divisor->IntVal != 0 && Divisor->IntVal != -1;
+}
+
+class LoopHoister {
+  IRFunctionNode& IRFunc;
+  ControlFlowGraph CFG;
+  DominatorTree DT;
+  LoopInfo LI;
+  DefUseChains DU;
+  std::unordered_map<IRInstructionNode*, BasicBlock*> blockOf;
+  size_t numHoisted = 0;
+
+  // what a loop may write besides its SSA values
+  struct SideEffects {
+    bool hasCall = false;
+    std::unordered_set<std::string> writtenStatics;
+  };
+
+public:
+  explicit LoopHoister(IRFunctionNode& IRFunc)
+      : IRFunc(IRFunc), CFG(IRFunc), DT(CFG), LI(CFG, DT), DU(IRFunc) {
+    for (auto& BB : CFG.blocks) {
+      for (auto& IRInstr : *BB) {
+        blockOf[IRInstr.get()] = BB.get();
+      }
+    }
+  }
+
+  /// @return number of hoisted instructions
+  size_t run() {
+    // inner loops first, what they hoist lands in their preheader, which is
+    // part of the enclosing loop
+    for (auto& L : LI.getLoops()) {
+      hoistFrom(*L);
+    }
+    return numHoisted;
+  }
+
+private:
+  SideEffects getSideEffects(const Loop& L) {
+    SideEffects Effects;
+    for (auto* BB : L.blocks) {
+      for (auto& IRInstr : *BB) {
+        if (isa<IRFunctionCallNode>(IRInstr.get()))
+          Effects.hasCall = true;
+        IRValSlot Result = IRInstr->result();
+        if (Result && nanocc::hasStaticStorage(**Result))
+          Effects.writtenStatics.insert(
+              cast<IRVariableNode>(Result->get())->varName);
+      }
+    }
+    return Effects;
+  }
+
+  bool isInvariant(const std::shared_ptr<IRValNode>& val, const Loop& L,
+                   const SideEffects& Effects) {
+    if (isa<IRConstNode>(val.get()))
+      return true;
+    auto& Name = cast<IRVariableNode>(val.get())->varName;
+    if (!DefUseChains::isTracked(val.get()))
+      return !Effects.hasCall && !Effects.writtenStatics.contains(Name);
+    // parameters and undefined values have no definition
+    IRInstructionNode* Def = DU.getDef(Name);
+    return !Def || !L.contains(blockOf.at(Def));
+  }
+
+  bool canHoist(IRInstructionNode* IRInstr, const Loop& L,
+                const SideEffects& Effects) {
+    if (!isSafeToSpeculate(IRInstr))
+      return false;
+    if (!DefUseChains::isTracked(IRInstr->result()->get()))
+      return false; // writes a static variable
+    for (IRValSlot Slot : IRInstr->operands()) {
+      if (!isInvariant(*Slot, L, Effects))
+        return false;
+    }
+    return true;
+  }
+
+  void hoistFrom(const Loop& L) {
+    BasicBlock* Preheader = L.getPreheader();
+    if (!Preheader)
+      return;
+    SideEffects Effects = getSideEffects(L);
+    // before the jump to the header, or where the preheader falls into it
+    auto InsertPos = Preheader->end();
+    if (isa<IRBranchNode>(Preheader->back()))
+      InsertPos = std::prev(Preheader->end());
+
+    auto& Instructions = IRFunc.IRInstructions;
+    // reverse postorder visits definitions before their uses, phis aside
+    for (auto* BB : DT.getReversePostOrder()) {
+      if (!L.contains(BB))
+        continue;
+      for (auto it = BB->begin(); it != BB->end();) {
+        auto next = std::next(it);
+        IRInstructionNode* IRInstr = it->get();
+        if (canHoist(IRInstr, L, Effects)) {
+          Instructions.splice(InsertPos, Instructions, it);
+          blockOf[IRInstr] = Preheader;
+          numHoisted++;
+        }
+        it = next;
+      }
+    }
+  }
+};
+} // namespace
+
+namespace nanocc {
+/// @brief Hoists loop invariant computations into the loop preheaders,
+/// inserting preheaders where loops have none.
+/// @return changed if an instruction was hoisted; an added preheader alone
+/// doesn't count, `destructSSA` drops it again if nothing jumps to it.
+PassResult LoopInvariantCodeMotion(IRFunctionNode& IRFunc,
+                                   AnalysisManager& AM) {
+  const LoopInfo& LI = AM.getLoopInfo(IRFunc);
+  if (LI.empty())
+    return PassResult::unchanged();
+  insertLoopPreheaders(IRFunc, AM.getCFG(IRFunc), LI);
+  constructSSA(IRFunc);
+  size_t numHoisted = LoopHoister(IRFunc).run();
+  destructSSA(IRFunc);
+  // nothing is preserved either way, the round trip renames and relabels
+  return {numHoisted != 0, PreservedAnalyses::none()};
+}
+} // namespace nanocc
@@ -0,0 +1,421 @@
+#include <algorithm>
+#include <climits>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "nanocc/Analysis/Dominators.hpp"
+#include "nanocc/Analysis/LoopInfo.hpp"
+#include "nanocc/IR/BasicBlock.hpp"
+#include "nanocc/IR/IR.hpp"
+#include "nanocc/Transforms/LoopUnroll.hpp"
+#include "nanocc/Transforms/LoopUtils.hpp"
+#include "nanocc/Utils/Utils.hpp"
+
+/*
+Unrolling of innermost counting loops in the bottom-tested shape IRGen gives
+`while` and `for`, on the non-SSA instruction list: copies of the body write
+the same variables, only their labels need new names.
+    i = 0
+  header:
+    <body>
+    i = i + 1
+    jump_if i < 8, header     (or t = i < 8, jnz t, header)
+The induction variable `i` is a local written by a single block of the loop,
+one that runs once per iteration and adds the same constant every time. It
+enters the loop with the constant last copied into it, and the branch back to
+the header compares it against a constant; that gives the trip count T. Then
+    T * size fits the budget: T copies of the body without the back edges
+    else: a new loop of `factor` copies that leaves once `i` has the value it
+          has after T - T % factor iterations, followed by the original loop
+          for the T % factor iterations left (nothing if that's 0)
+The copies compute the same conditions as before, constant folding and copy
+propagation take it from there.
+*/
+
+namespace {
+// what the main loop of a partial unroll is called, it isn't unrolled again
+const std::string UnrolledPrefix = "unrolled";
+
+/// @brief Follows a block instruction by instruction, keeping the variables
+/// that hold the induction variable plus a constant, as offsets from its
+/// value at the start of the iteration, and the comparisons of those against
+/// constants.
+class AffineTracker {
+public:
+  /// @brief `iv + offset opType bound`
+  struct Comparison {
+    TokenType opType;
+    long long offset;
+    long long bound;
+  };
+
+  AffineTracker(const std::string& IV, long long ivOffset) {
+    offsets[IV] = ivOffset;
+  }
+
+  void visit(IRInstructionNode* IRInstr) {
+    IRValSlot Result = IRInstr->result();
+    if (!Result || !*Result)
+      return;
+    std::optional<long long> Offset;
+    std::optional<Comparison> Cmp;
+    if (auto* Copy = dyn_cast<IRCopyNode>(IRInstr)) {
+      Offset = getOffset(Copy->ValSrc);
+    } else if (auto* Binary = dyn_cast<IRBinaryNode>(IRInstr)) {
+      auto L = getOffset(Binary->valSrcL);
+      auto R = getOffset(Binary->valSrcR);
+      auto* ConstL = dyn_cast<IRConstNode>(Binary->valSrcL.get());
+      auto* ConstR = dyn_cast<IRConstNode>(Binary->valSrcR.get());
+      if (Binary->opType == TokenType::PLUS) {
+        if (L && ConstR)
+          Offset = *L + ConstR->IntVal;
+        else if (ConstL && R)
+          Offset = ConstL->IntVal + *R;
+      } else if (Binary->opType == TokenType::MINUS) {
+        if (L && ConstR)
+          Offset = *L - ConstR->IntVal;
+      } else {
+        Cmp = compare(Binary->opType, Binary->valSrcL, Binary->valSrcR);
+      }
+    }
+    // after reading the operands, `i = i + 1` reads the old offset
+    auto& Dest = cast<IRVariableNode>(Result->get())->varName;
+    offsets.erase(Dest);
+    comparisons.erase(Dest);
+    if (Offset)
+      offsets[Dest] = *Offset;
+    if (Cmp)
+      comparisons[Dest] = *Cmp;
+  }
+
+  std::optional<long long> getOffset(const std::shared_ptr<IRValNode>& val) {
+    auto* Var = dyn_cast<IRVariableNode>(val.get());
+    if (!Var)
+      return std::nullopt;
+    auto it = offsets.find(Var->varName);
+    if (it == offsets.end())
+      return std::nullopt;
+    return it->second;
+  }
+
+  /// @return `L opType R` as a comparison of the induction variable against
+  /// a constant, if it is one
+  std::optional<Comparison> compare(TokenType opType,
+                                    const std::shared_ptr<IRValNode>& L,
+                                    const std::shared_ptr<IRValNode>& R) {
+    if (!nanocc::isComparison(opType))
+      return std::nullopt;
+    auto OffsetL = getOffset(L);
+    auto OffsetR = getOffset(R);
+    auto* ConstL = dyn_cast<IRConstNode>(L.get());
+    auto* ConstR = dyn_cast<IRConstNode>(R.get());
+    if (OffsetL && ConstR)
+      return Comparison{opType, *OffsetL, ConstR->IntVal};
+    if (ConstL && OffsetR)
+      return Comparison{nanocc::getSwappedComparison(opType), *OffsetR,
+                        ConstL->IntVal};
+    return std::nullopt;
+  }
+
+  const Comparison* getComparison(const std::shared_ptr<IRValNode>& val) {
+    auto* Var = dyn_cast<IRVariableNode>(val.get());
+    if (!Var)
+      return nullptr;
+    auto it = comparisons.find(Var->varName);
+    return it == comparisons.end() ? nullptr : &it->second;
+  }
+
+private:
+  std::unordered_map<std::string, long long> offsets;
+  std::unordered_map<std::string, Comparison> comparisons;
+};
+
+bool fitsInt(long long val) { return val >= INT_MIN && val <= INT_MAX; }
+
+int wrapToInt(long long val) {
+  return static_cast<int>(static_cast<unsigned>(val));
+}
+
+struct CountedLoop {
+  BasicBlock* Header;
+  BasicBlock* Latch;
+  IRBranchNode* Entering; // jump from outside to the header, if any
+  std::string IV;
+  long long start; // value of the induction variable entering the loop
+  long long step;
+  long long latchOffset; // added to it since the iteration started, at the
+                         // branch back to the header
+  // stay in the loop while `iv + offset opType bound` at the back edge
+  AffineTracker::Comparison stay;
+  long long tripCount;
+  size_t size; // instructions, labels aside
+};
+
+class LoopUnroller {
+  IRFunctionNode& IRFunc;
+  const ControlFlowGraph& CFG;
+  const DominatorTree& DT;
+  unsigned factor;
+
+public:
+  LoopUnroller(IRFunctionNode& IRFunc, const ControlFlowGraph& CFG,
+               const DominatorTree& DT, unsigned factor)
+      : IRFunc(IRFunc), CFG(CFG), DT(DT), factor(factor) {}
+
+  /// @return the loop if it's an innermost loop laid out as one stretch of
+  /// blocks, header first and a single latch last, with a constant trip count
+  std::optional<CountedLoop> analyze(const Loop& L) {
+    if (!L.subLoops.empty() || L.latches.size() != 1)
+      return std::nullopt;
+    BasicBlock* Header = L.header;
+    BasicBlock* Latch = L.latches.front();
+    IRLabelNode* HeaderLabel = Header->getLabel();
+    if (!HeaderLabel || L.blocks.front() != Header ||
+        L.blocks.back() != Latch ||
+        L.blocks.size() != Latch->blockId - Header->blockId + 1)
+      return std::nullopt;
+    auto* BackEdge = dyn_cast<IRBranchNode>(Latch->back());
+    if (!BackEdge || !BackEdge->isConditional() ||
+        BackEdge->labelId != HeaderLabel->labelId)
+      return std::nullopt;
+
+    BasicBlock* Entry = nullptr;
+    for (auto* Pred : Header->predecessors) {
+      if (L.contains(Pred))
+        continue;
+      if (Entry)
+        return std::nullopt;
+      Entry = Pred;
+    }
+    if (!Entry)
+      return std::nullopt;
+    auto* Entering = dyn_cast<IRBranchNode>(Entry->back());
+    if (Entering && Entering->labelId != HeaderLabel->labelId)
+      Entering = nullptr;
+
+    // the rest is filled in below, the size counted up from 0
+    CountedLoop CL{Header, Latch, Entering, {}, 0, 0, 0, {}, 0, 0};
+    if (!analyzeInductionVariable(L, *BackEdge, CL))
+      return std::nullopt;
+    auto Start = getEntryValue(Entry, CL.IV);
+    if (!Start)
+      return std::nullopt;
+    CL.start = *Start;
+    long long first = CL.start + CL.stay.offset;
+    auto Trips =
+        nanocc::getTripCount(CL.stay.opType, first, CL.step, CL.stay.bound);
+    if (!Trips || !fitsInt(first) || !fitsInt(first + (*Trips - 1) * CL.step))
+      return std::nullopt;
+    CL.tripCount = *Trips;
+
+    for (auto it = Header->begin(); it != Latch->end(); ++it) {
+      if (!isa<IRLabelNode>(it->get()))
+        CL.size++;
+    }
+    return CL;
+  }
+
+  /// @return true if `CL` was unrolled
+  bool unroll(const CountedLoop& CL) {
+    if (CL.tripCount * CL.size <= nanocc::UnrollSizeBudget) {
+      unrollFully(CL);
+      return true;
+    }
+    if (factor < 2 || CL.tripCount / factor < 2)
+      return false;
+    // the original loop stays for the remainder
+    size_t numBodies = factor + (CL.tripCount % factor ? 1 : 0);
+    if (numBodies * CL.size > nanocc::UnrollSizeBudget ||
+        CL.Header->getLabel()->labelName.starts_with(UnrolledPrefix + "."))
+      return false;
+    unrollPartially(CL);
+    return true;
+  }
+
+private:
+  /// @brief Finds the induction variable in the comparison the back edge
+  /// tests and fills in its step, latch offset and `stay`.
+  bool analyzeInductionVariable(const Loop& L, IRBranchNode& BackEdge,
+                                CountedLoop& CL) {
+    // the comparison is made by the branch, or computed into its condition
+    auto* JumpIfCmp = dyn_cast<IRJumpIfCmpNode>(&BackEdge);
+    std::vector<IRValSlot> Compared = BackEdge.operands();
+    if (!JumpIfCmp) {
+      auto* CondVar = dyn_cast<IRVariableNode>(Compared.front()->get());
+      if (!CondVar)
+        return false;
+      IRBinaryNode* Compare = nullptr;
+      for (auto it = std::prev(CL.Latch->end()); it != CL.Latch->begin();) {
+        --it;
+        IRValSlot Result = (*it)->result();
+        if (Result && *Result &&
+            cast<IRVariableNode>(Result->get())->varName == CondVar->varName) {
+          Compare = dyn_cast<IRBinaryNode>(it->get());
+          break;
+        }
+      }
+      if (!Compare || !nanocc::isComparison(Compare->opType))
+        return false;
+      Compared = Compare->operands();
+    }
+    auto* IVar = dyn_cast<IRVariableNode>(Compared[0]->get());
+    if (!IVar)
+      IVar = dyn_cast<IRVariableNode>(Compared[1]->get());
+    if (!IVar)
+      return false;
+    CL.IV = IVar->varName;
+
+    auto Var = IRVariableNode(CL.IV);
+    if (nanocc::hasStaticStorage(Var))
+      return false;
+    BasicBlock* Update = nullptr;
+    for (auto* BB : L.blocks) {
+      for (auto& IRInstr : *BB) {
+        IRValSlot Result = IRInstr->result();
+        if (!Result || !*Result ||
+            cast<IRVariableNode>(Result->get())->varName != CL.IV)
+          continue;
+        if (Update && Update != BB)
+          return false;
+        Update = BB;
+      }
+    }
+    // once per iteration: a block every path to the back edge goes through
+    if (!Update || !DT.dominates(Update, CL.Latch))
+      return false;
+    AffineTracker UpdateTracker(CL.IV, 0);
+    for (auto& IRInstr : *Update) {
+      UpdateTracker.visit(IRInstr.get());
+    }
+    auto Step =
+        UpdateTracker.getOffset(std::make_shared<IRVariableNode>(CL.IV));
+    if (!Step || *Step == 0 || !fitsInt(*Step))
+      return false;
+    CL.step = *Step;
+
+    AffineTracker LatchTracker(CL.IV, Update == CL.Latch ? 0 : CL.step);
+    for (auto it = CL.Latch->begin(); it != std::prev(CL.Latch->end()); ++it) {
+      LatchTracker.visit(it->get());
+    }
+    auto LatchOffset =
+        LatchTracker.getOffset(std::make_shared<IRVariableNode>(CL.IV));
+    std::optional<AffineTracker::Comparison> Cmp;
+    if (JumpIfCmp) {
+      Cmp = LatchTracker.compare(JumpIfCmp->opType, JumpIfCmp->valSrcL,
+                                 JumpIfCmp->valSrcR);
+    } else if (auto* Computed =
+                   LatchTracker.getComparison(*BackEdge.operands().front())) {
+      Cmp = *Computed;
+    }
+    if (!LatchOffset || !Cmp || !fitsInt(Cmp->offset))
+      return false;
+    CL.latchOffset = *LatchOffset;
+    CL.stay = *Cmp;
+    if (isa<IRJumpIfZeroNode>(&BackEdge))
+      CL.stay.opType = nanocc::getNegatedComparison(Cmp->opType);
+    return true;
+  }
+
+  /// @brief the constant copied into `IV` last before `Entry` ends, looking
+  /// up through blocks with a single predecessor
+  std::optional<long long> getEntryValue(BasicBlock* Entry,
+                                         const std::string& IV) {
+    BasicBlock* BB = Entry;
+    for (size_t steps = 0; BB && steps < CFG.size(); steps++) {
+      for (auto it = BB->end(); it != BB->begin();) {
+        --it;
+        IRValSlot Result = (*it)->result();
+        if (!Result || !*Result ||
+            cast<IRVariableNode>(Result->get())->varName != IV)
+          continue;
+        auto* Copy = dyn_cast<IRCopyNode>(it->get());
+        auto* Const =
+            Copy ? dyn_cast<IRConstNode>(Copy->ValSrc.get()) : nullptr;
+        if (!Const)
+          return std::nullopt;
+        return Const->IntVal;
+      }
+      BB = BB->predecessors.size() == 1 ? BB->predecessors.front() : nullptr;
+    }
+    return std::nullopt; // parameters and uninitialized variables
+  }
+
+  void unrollFully(const CountedLoop& CL) {
+    auto& Instructions = IRFunc.IRInstructions;
+    auto BackEdge = std::prev(CL.Latch->end());
+    std::list<std::unique_ptr<IRInstructionNode>> Copies;
+    for (long long i = 1; i < CL.tripCount; i++) {
+      auto Copy =
+          nanocc::cloneRange(IRFunc, CL.Header->begin(), BackEdge, "unroll");
+      Copies.splice(Copies.end(), Copy);
+    }
+    // every copy falls into the next one, the last one out of the loop
+    Instructions.splice(CL.Latch->end(), Copies);
+    Instructions.erase(BackEdge);
+  }
+
+  void unrollPartially(const CountedLoop& CL) {
+    auto& Instructions = IRFunc.IRInstructions;
+    auto BackEdge = std::prev(CL.Latch->end());
+    std::list<std::unique_ptr<IRInstructionNode>> Main;
+    for (unsigned i = 0; i < factor; i++) {
+      auto Copy = nanocc::cloneRange(IRFunc, CL.Header->begin(), BackEdge,
+                             i == 0 ? UnrolledPrefix : "unroll");
+      Main.splice(Main.end(), Copy);
+    }
+    auto* MainHeader = cast<IRLabelNode>(Main.front().get());
+
+    // leave after the last full round of `factor` iterations
+    long long numMainIterations = CL.tripCount - CL.tripCount % factor;
+    long long exitValue =
+        CL.start + (numMainIterations - 1) * CL.step + CL.latchOffset;
+    Main.push_back(std::make_unique<IRJumpIfCmpNode>(
+        TokenType::NOT_EQUAL, std::make_shared<IRVariableNode>(CL.IV),
+        std::make_shared<IRConstNode>(wrapToInt(exitValue)),
+        MainHeader->labelName, MainHeader->labelId));
+
+    if (CL.Entering) {
+      CL.Entering->labelName = MainHeader->labelName;
+      CL.Entering->labelId = MainHeader->labelId;
+    }
+    Instructions.splice(CL.Header->begin(), Main);
+    if (CL.tripCount % factor == 0)
+      Instructions.erase(CL.Header->begin(), CL.Latch->end());
+  }
+};
+} // namespace
+
+namespace nanocc {
+/// @brief Loops are analyzed first and unrolled last to first in layout
+/// order, so the blocks still to be unrolled aren't touched before.
+/// @return changed if a loop was unrolled
+PassResult LoopUnroll(IRFunctionNode& IRFunc, AnalysisManager& AM,
+                      unsigned factor) {
+  if (IRFunc.inSSAForm)
+    return PassResult::unchanged();
+  const LoopInfo& LI = AM.getLoopInfo(IRFunc);
+  if (LI.empty())
+    return PassResult::unchanged();
+  LoopUnroller Unroller(IRFunc, AM.getCFG(IRFunc), AM.getDomTree(IRFunc),
+                        factor);
+  std::vector<CountedLoop> Loops;
+  for (auto& L : LI.getLoops()) {
+    if (auto CL = Unroller.analyze(*L))
+      Loops.push_back(*CL);
+  }
+  std::sort(Loops.begin(), Loops.end(),
+            [](const CountedLoop& A, const CountedLoop& B) {
+              return A.Header->blockId > B.Header->blockId;
+            });
+  bool changed = false;
+  for (auto& CL : Loops) {
+    changed |= Unroller.unroll(CL);
+  }
+  if (!changed)
+    return PassResult::unchanged();
+  return PassResult::modified();
+}
+} // namespace nanocc
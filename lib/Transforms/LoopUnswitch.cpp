@@ -0,0 +1,241 @@
+#include <iterator>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_set>
+
+#include "nanocc/Analysis/LoopInfo.hpp"
+#include "nanocc/IR/BasicBlock.hpp"
+#include "nanocc/IR/IR.hpp"
+#include "nanocc/Transforms/LoopUnswitch.hpp"
+#include "nanocc/Transforms/LoopUtils.hpp"
+#include "nanocc/Utils/Utils.hpp"
+
+/*
+Loop unswitching on the non-SSA instruction list, for loops laid out header
+first and latch last. The blocks from header to latch are copied as a whole,
+blocks `break` leaves through included. A conditional branch inside the loop
+on variables the loop never writes goes the same way every iteration, so it
+is tested once in front of the loop instead:
+                                    jz c, header'
+    header:                         header:
+      ...                             ...
+      jz c, else          ->          (never taken, gone)
+      ...                             ...
+    latch:                          latch:
+      jnz t, header                   jnz t, header
+                                      jmp exit
+                                    header':
+                                      ...
+                                      jmp else'
+                                      ...
+                                    latch':
+                                      jnz t', header'
+    exit:                           exit:
+Jumps from outside the loop to the header go to the test instead. The arm a
+copy never takes is left to unreachable code elimination. A run unswitches
+every loop it can, inner loops first, but none twice and none holding code
+it made: the test of an inner loop is a branch on an invariant condition of
+the enclosing loop, and both copies of a loop may have more. Those follow in
+a later run, once the arms the copies never take are gone, if they are small
+enough. Loops over `UnswitchSizeBudget` aren't copied, nor is anything once
+the function has `UnswitchFunctionBudget` instructions, which bounds the
+copies made for several conditions.
+*/
+
+namespace {
+using InstrList = std::list<std::unique_ptr<IRInstructionNode>>;
+
+struct UnswitchCandidate {
+  const Loop* L;
+  BasicBlock* Latch;
+  IRBranchNode* Branch;
+  size_t branchIndex; // position of `Branch` from the header label on
+  size_t size;        // instructions, labels aside
+};
+
+class LoopUnswitcher {
+  IRFunctionNode& IRFunc;
+  const ControlFlowGraph& CFG;
+
+public:
+  LoopUnswitcher(IRFunctionNode& IRFunc, const ControlFlowGraph& CFG)
+      : IRFunc(IRFunc), CFG(CFG) {}
+
+  /// @return the first branch on an invariant condition in `L`, if `L` has
+  /// the layout unswitching needs and fits the budget
+  std::optional<UnswitchCandidate> analyze(const Loop& L) {
+    if (L.latches.size() != 1)
+      return std::nullopt;
+    BasicBlock* Header = L.header;
+    BasicBlock* Latch = L.latches.front();
+    if (!Header->getLabel() || L.blocks.front() != Header ||
+        L.blocks.back() != Latch)
+      return std::nullopt;
+    // the first copy needs a label after the loop to jump over the second
+    if (nanocc::fallsThrough(Latch) && !CFG.getLayoutSuccessor(Latch))
+      return std::nullopt;
+
+    UnswitchCandidate Candidate{&L, Latch, nullptr, 0, 0};
+    bool hasCall = false;
+    for (auto it = Header->begin(); it != Latch->end(); ++it) {
+      if (!isa<IRLabelNode>(it->get()))
+        Candidate.size++;
+      if (isa<IRFunctionCallNode>(it->get()))
+        hasCall = true;
+    }
+    if (Candidate.size > nanocc::UnswitchSizeBudget ||
+        IRFunc.IRInstructions.size() + Candidate.size >
+            nanocc::UnswitchFunctionBudget)
+      return std::nullopt;
+
+    size_t index = 0;
+    for (size_t id = Header->blockId; id <= Latch->blockId; id++) {
+      BasicBlock* BB = CFG.blocks[id].get();
+      index += std::distance(BB->begin(), BB->end());
+      // blocks in between that aren't in the loop run once at most
+      auto* Branch = dyn_cast<IRBranchNode>(BB->back());
+      if (!L.contains(BB) || !Branch || !Branch->isConditional())
+        continue;
+      if (isInvariant(*Branch, Header, Latch, hasCall)) {
+        Candidate.Branch = Branch;
+        Candidate.branchIndex = index - 1;
+        return Candidate;
+      }
+    }
+    return std::nullopt;
+  }
+
+  void unswitch(const UnswitchCandidate& Candidate) {
+    auto& Instructions = IRFunc.IRInstructions;
+    BasicBlock* Header = Candidate.L->header;
+    BasicBlock* Latch = Candidate.Latch;
+    auto LoopBegin = Header->begin();
+    auto LoopEnd = Latch->end();
+    bool exits = nanocc::fallsThrough(Latch);
+    auto Copy = nanocc::cloneRange(IRFunc, LoopBegin, LoopEnd, "unswitch");
+    auto* CopyHeader = cast<IRLabelNode>(Copy.front().get());
+
+    // jumps to the copy when the condition is false
+    std::unique_ptr<IRBranchNode> Test;
+    if (auto* JumpIfCmp = dyn_cast<IRJumpIfCmpNode>(Candidate.Branch))
+      Test = std::make_unique<IRJumpIfCmpNode>(
+          nanocc::getNegatedComparison(JumpIfCmp->opType),
+          nanocc::cloneValue(JumpIfCmp->valSrcL),
+          nanocc::cloneValue(JumpIfCmp->valSrcR),
+          CopyHeader->labelName, CopyHeader->labelId);
+    else
+      Test = std::make_unique<IRJumpIfZeroNode>(
+          nanocc::cloneValue(*Candidate.Branch->operands().front()),
+          CopyHeader->labelName, CopyHeader->labelId);
+    std::unique_ptr<IRLabelNode> TestLabel;
+    for (auto* Pred : Header->predecessors) {
+      auto* Entering = dyn_cast<IRBranchNode>(Pred->back());
+      if (Candidate.L->contains(Pred) || !Entering ||
+          Entering->labelId != Header->getLabel()->labelId)
+        continue;
+      if (!TestLabel)
+        TestLabel = IRFunc.createLabel("unswitch");
+      Entering->labelName = TestLabel->labelName;
+      Entering->labelId = TestLabel->labelId;
+    }
+    // the original runs while the condition is true, the copy otherwise
+    simplifyBranch(Instructions,
+                   std::next(LoopBegin, Candidate.branchIndex), true);
+    simplifyBranch(Copy, std::next(Copy.begin(), Candidate.branchIndex),
+                   false);
+    if (TestLabel)
+      Instructions.insert(LoopBegin, std::move(TestLabel));
+    Instructions.insert(LoopBegin, std::move(Test));
+
+    if (exits) {
+      auto* Exit = dyn_cast<IRLabelNode>(LoopEnd->get());
+      if (!Exit) {
+        LoopEnd =
+            Instructions.insert(LoopEnd, IRFunc.createLabel("unswitch"));
+        Exit = cast<IRLabelNode>(LoopEnd->get());
+      }
+      Instructions.insert(LoopEnd, std::make_unique<IRJumpNode>(
+                                       Exit->labelName, Exit->labelId));
+    }
+    Instructions.splice(LoopEnd, Copy);
+  }
+
+private:
+  /// @return true if `Branch` tests variables and nothing in the loop writes
+  /// them, and no call may either if they're static
+  bool isInvariant(IRBranchNode& Branch, BasicBlock* Header,
+                   BasicBlock* Latch, bool hasCall) {
+    bool readsVariable = false;
+    for (IRValSlot Slot : Branch.operands()) {
+      auto* Cond = dyn_cast<IRVariableNode>(Slot->get());
+      if (!Cond)
+        continue; // constants
+      readsVariable = true;
+      if (nanocc::hasStaticStorage(*Cond) && hasCall)
+        return false;
+      for (auto it = Header->begin(); it != Latch->end(); ++it) {
+        IRValSlot Result = (*it)->result();
+        if (Result && *Result &&
+            cast<IRVariableNode>(Result->get())->varName == Cond->varName)
+          return false;
+      }
+    }
+    return readsVariable;
+  }
+
+  /// @brief Turns `Branch` into the jump it makes when its condition is
+  /// `condValue`: an unconditional one, or none.
+  void simplifyBranch(InstrList& List, InstrList::iterator it,
+                      bool condValue) {
+    auto* Branch = cast<IRBranchNode>(it->get());
+    // `jz` jumps when the condition is false, the others when it's true
+    if (isa<IRJumpIfZeroNode>(Branch) != condValue)
+      List.insert(it, std::make_unique<IRJumpNode>(Branch->labelName,
+                                                   Branch->labelId));
+    List.erase(it);
+  }
+};
+} // namespace
+
+namespace nanocc {
+/// @return changed if a loop was unswitched
+PassResult LoopUnswitch(IRFunctionNode& IRFunc, AnalysisManager& AM) {
+  if (IRFunc.inSSAForm)
+    return PassResult::unchanged();
+  // labels from `firstNewLabel` on are the copies and tests of this run
+  size_t firstNewLabel = IRFunc.numLabels;
+  std::unordered_set<size_t> Unswitched; // header labelIds
+  auto isUntouched = [&](const Loop& L) {
+    if (Unswitched.contains(L.header->getLabel()->labelId))
+      return false;
+    for (auto it = L.header->begin(); it != L.latches.front()->end(); ++it) {
+      auto* Label = dyn_cast<IRLabelNode>(it->get());
+      if (Label && Label->labelId >= firstNewLabel)
+        return false;
+    }
+    return true;
+  };
+  bool changed = false;
+  while (true) {
+    // unswitching invalidates the loops, they're found again every time
+    const LoopInfo& LI = AM.getLoopInfo(IRFunc);
+    LoopUnswitcher Unswitcher(IRFunc, AM.getCFG(IRFunc));
+    std::optional<UnswitchCandidate> Candidate;
+    for (auto& L : LI.getLoops()) {
+      Candidate = Unswitcher.analyze(*L);
+      if (Candidate && isUntouched(*L))
+        break;
+      Candidate.reset();
+    }
+    if (!Candidate)
+      break;
+    Unswitched.insert(Candidate->L->header->getLabel()->labelId);
+    Unswitcher.unswitch(*Candidate);
+    AM.invalidate(IRFunc, PreservedAnalyses::none());
+    changed = true;
+  }
+  return changed ? PassResult::modified() : PassResult::unchanged();
+}
+} // namespace nanocc
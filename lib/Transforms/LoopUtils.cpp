@@ -0,0 +1,250 @@
+#include <optional>
+#include <stdexcept>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+#include "nanocc/Transforms/LoopUtils.hpp"
+#include "nanocc/Utils/Utils.hpp"
+
+namespace nanocc {
+std::shared_ptr<IRValNode> cloneValue(const std::shared_ptr<IRValNode>& val) {
+  if (!val)
+    return nullptr;
+  if (auto* Const = dyn_cast<IRConstNode>(val.get()))
+    return std::make_shared<IRConstNode>(Const->IntVal);
+  return std::make_shared<IRVariableNode>(
+      cast<IRVariableNode>(val.get())->varName);
+}
+
+bool fallsThrough(const BasicBlock* BB) {
+  IRInstructionNode* Last = BB->back();
+  if (isa<IRRetNode>(Last))
+    return false;
+  auto* Branch = dyn_cast<IRBranchNode>(Last);
+  return !Branch || Branch->isConditional();
+}
+
+bool insertLoopPreheaders(IRFunctionNode& IRFunc, const ControlFlowGraph& CFG,
+                          const LoopInfo& LI) {
+  // find everything first, the blocks are views that inserting a label into
+  // the middle of would make lie
+  struct Plan {
+    BasicBlock* Header;
+    std::vector<IRBranchNode*> entering; // jumps from outside to the header
+  };
+  std::vector<Plan> Plans;
+  for (auto& L : LI.getLoops()) {
+    BasicBlock* Header = L->header;
+    IRLabelNode* HeaderLabel = Header->getLabel();
+    if (L->getPreheader() || !HeaderLabel)
+      continue;
+    if (Header->blockId != 0) {
+      BasicBlock* Prev = CFG.blocks[Header->blockId - 1].get();
+      if (L->contains(Prev) && fallsThrough(Prev))
+        continue;
+    }
+    Plan P{Header, {}};
+    for (auto* Pred : Header->predecessors) {
+      if (L->contains(Pred))
+        continue;
+      auto* Branch = dyn_cast<IRBranchNode>(Pred->back());
+      if (Branch && Branch->labelId == HeaderLabel->labelId)
+        P.entering.push_back(Branch);
+    }
+    Plans.push_back(std::move(P));
+  }
+
+  for (auto& P : Plans) {
+    auto Label = IRFunc.createLabel("preheader");
+    for (auto* Branch : P.entering) {
+      Branch->labelName = Label->labelName;
+      Branch->labelId = Label->labelId;
+    }
+    // the layout predecessor now falls into the preheader
+    IRFunc.IRInstructions.insert(P.Header->begin(), std::move(Label));
+  }
+  return !Plans.empty();
+}
+
+std::unique_ptr<IRInstructionNode>
+cloneInstruction(IRInstructionNode* IRInstr) {
+  if (auto* Ret = dyn_cast<IRRetNode>(IRInstr))
+    return std::make_unique<IRRetNode>(cloneValue(Ret->retValue));
+  if (auto* Unary = dyn_cast<IRUnaryNode>(IRInstr))
+    return std::make_unique<IRUnaryNode>(Unary->opType,
+                                         cloneValue(Unary->valSrc),
+                                         cloneValue(Unary->valDest));
+  if (auto* Binary = dyn_cast<IRBinaryNode>(IRInstr))
+    return std::make_unique<IRBinaryNode>(
+        Binary->opType, cloneValue(Binary->valSrcL),
+        cloneValue(Binary->valSrcR), cloneValue(Binary->valDest));
+  if (auto* Copy = dyn_cast<IRCopyNode>(IRInstr))
+    return std::make_unique<IRCopyNode>(cloneValue(Copy->ValSrc),
+                                        cloneValue(Copy->ValDest));
+  if (auto* Jump = dyn_cast<IRJumpNode>(IRInstr))
+    return std::make_unique<IRJumpNode>(Jump->labelName, Jump->labelId);
+  if (auto* JumpIfZero = dyn_cast<IRJumpIfZeroNode>(IRInstr))
+    return std::make_unique<IRJumpIfZeroNode>(cloneValue(JumpIfZero->condition),
+                                              JumpIfZero->labelName,
+                                              JumpIfZero->labelId);
+  if (auto* JumpIfNotZero = dyn_cast<IRJumpIfNotZeroNode>(IRInstr))
+    return std::make_unique<IRJumpIfNotZeroNode>(
+        cloneValue(JumpIfNotZero->condition), JumpIfNotZero->labelName,
+        JumpIfNotZero->labelId);
+  if (auto* JumpIfCmp = dyn_cast<IRJumpIfCmpNode>(IRInstr))
+    return std::make_unique<IRJumpIfCmpNode>(
+        JumpIfCmp->opType, cloneValue(JumpIfCmp->valSrcL),
+        cloneValue(JumpIfCmp->valSrcR), JumpIfCmp->labelName,
+        JumpIfCmp->labelId);
+  if (auto* Label = dyn_cast<IRLabelNode>(IRInstr))
+    return std::make_unique<IRLabelNode>(Label->labelName, Label->labelId);
+  if (auto* Call = dyn_cast<IRFunctionCallNode>(IRInstr)) {
+    std::vector<std::shared_ptr<IRValNode>> Args;
+    for (auto& Arg : Call->arguments) {
+      Args.push_back(cloneValue(Arg));
+    }
+    auto Clone = std::make_unique<IRFunctionCallNode>(
+        Call->funcName, std::move(Args), cloneValue(Call->returnDest));
+    Clone->tail = Call->tail;
+    return Clone;
+  }
+  if (auto* Select = dyn_cast<IRSelectNode>(IRInstr))
+    return std::make_unique<IRSelectNode>(
+        Select->opType, cloneValue(Select->valSrcL),
+        cloneValue(Select->valSrcR), cloneValue(Select->valTrue),
+        cloneValue(Select->valFalse), cloneValue(Select->valDest));
+  if (auto* Phi = dyn_cast<IRPhiNode>(IRInstr)) {
+    auto Clone = std::make_unique<IRPhiNode>(cloneValue(Phi->valDest));
+    for (auto& In : Phi->incoming) {
+      Clone->incoming.push_back(
+          {cloneValue(In.value), In.labelName, In.labelId});
+    }
+    return Clone;
+  }
+  throw std::runtime_error("IR Optimization Error: can't clone instruction");
+}
+
+namespace {
+bool isSameValue(const std::shared_ptr<IRValNode>& A,
+                 const std::shared_ptr<IRValNode>& B) {
+  if (!A || !B)
+    return A == B;
+  if (auto* ConstA = dyn_cast<IRConstNode>(A.get())) {
+    auto* ConstB = dyn_cast<IRConstNode>(B.get());
+    return ConstB && ConstA->IntVal == ConstB->IntVal;
+  }
+  auto* VarB = dyn_cast<IRVariableNode>(B.get());
+  return VarB && cast<IRVariableNode>(A.get())->varName == VarB->varName;
+}
+
+std::optional<TokenType> getOpType(IRInstructionNode* IRInstr) {
+  if (auto* Unary = dyn_cast<IRUnaryNode>(IRInstr))
+    return Unary->opType;
+  if (auto* Binary = dyn_cast<IRBinaryNode>(IRInstr))
+    return Binary->opType;
+  if (auto* JumpIfCmp = dyn_cast<IRJumpIfCmpNode>(IRInstr))
+    return JumpIfCmp->opType;
+  if (auto* Select = dyn_cast<IRSelectNode>(IRInstr))
+    return Select->opType;
+  return std::nullopt;
+}
+} // namespace
+
+bool isSameInstruction(IRInstructionNode* A, IRInstructionNode* B) {
+  if (typeid(*A) != typeid(*B) || getOpType(A) != getOpType(B))
+    return false;
+  auto OperandsA = A->operands();
+  auto OperandsB = B->operands();
+  if (OperandsA.size() != OperandsB.size())
+    return false;
+  for (size_t i = 0; i < OperandsA.size(); i++) {
+    if (!isSameValue(*OperandsA[i], *OperandsB[i]))
+      return false;
+  }
+  IRValSlot Result = A->result();
+  if (Result && !isSameValue(*Result, *B->result()))
+    return false;
+  if (auto* Branch = dyn_cast<IRBranchNode>(A))
+    return Branch->labelId == cast<IRBranchNode>(B)->labelId;
+  if (auto* Label = dyn_cast<IRLabelNode>(A))
+    return Label->labelId == cast<IRLabelNode>(B)->labelId;
+  if (auto* Call = dyn_cast<IRFunctionCallNode>(A)) {
+    auto* CallB = cast<IRFunctionCallNode>(B);
+    return Call->funcName == CallB->funcName && Call->tail == CallB->tail;
+  }
+  if (auto* Phi = dyn_cast<IRPhiNode>(A)) {
+    auto& InB = cast<IRPhiNode>(B)->incoming;
+    for (size_t i = 0; i < Phi->incoming.size(); i++) {
+      if (Phi->incoming[i].labelId != InB[i].labelId)
+        return false;
+    }
+  }
+  return true;
+}
+
+std::list<std::unique_ptr<IRInstructionNode>>
+cloneRange(IRFunctionNode& IRFunc, BasicBlock::InstrIter first,
+           BasicBlock::InstrIter last, const std::string& prefix) {
+  std::list<std::unique_ptr<IRInstructionNode>> Clones;
+  // old label id => new label, a branch may come before its label
+  std::unordered_map<size_t, IRLabelNode*> NewLabels;
+  for (auto it = first; it != last; ++it) {
+    if (auto* Label = dyn_cast<IRLabelNode>(it->get())) {
+      Clones.push_back(IRFunc.createLabel(prefix));
+      NewLabels[Label->labelId] = cast<IRLabelNode>(Clones.back().get());
+    } else {
+      Clones.push_back(cloneInstruction(it->get()));
+    }
+  }
+  auto remap = [&](std::string& labelName, size_t& labelId) {
+    auto it = NewLabels.find(labelId);
+    if (it == NewLabels.end())
+      return;
+    labelName = it->second->labelName;
+    labelId = it->second->labelId;
+  };
+  for (auto& IRInstr : Clones) {
+    if (auto* Branch = dyn_cast<IRBranchNode>(IRInstr.get())) {
+      remap(Branch->labelName, Branch->labelId);
+    } else if (auto* Phi = dyn_cast<IRPhiNode>(IRInstr.get())) {
+      for (auto& In : Phi->incoming) {
+        remap(In.labelName, In.labelId);
+      }
+    }
+  }
+  return Clones;
+}
+
+std::optional<long long> getTripCount(TokenType opType, long long first,
+                                      long long step, long long bound) {
+  switch (opType) {
+  case TokenType::GREATERTHAN:
+    return getTripCount(TokenType::LESSTHAN, -first, -step, -bound);
+  case TokenType::GREATER_EQUAL:
+    return getTripCount(TokenType::LESS_EQUAL, -first, -step, -bound);
+  case TokenType::LESS_EQUAL:
+    return getTripCount(TokenType::LESSTHAN, first, step, bound + 1);
+  case TokenType::LESSTHAN:
+    if (first >= bound)
+      return 1;
+    if (step <= 0)
+      return std::nullopt;
+    return (bound - first + step - 1) / step + 1;
+  case TokenType::NOT_EQUAL:
+    if (first == bound)
+      return 1;
+    if (step == 0 || (bound - first) % step != 0 || (bound - first) / step < 0)
+      return std::nullopt;
+    return (bound - first) / step + 1;
+  case TokenType::EQUAL:
+    if (first != bound)
+      return 1;
+    if (step == 0)
+      return std::nullopt;
+    return 2;
+  default:
+    return std::nullopt;
+  }
+}
+} // namespace nanocc
@@ -1,54 +1,262 @@
+#include <algorithm>
+#include <cctype>
 #include <print>
+#include <string>
+#include <unordered_map>
 
 #include "nanocc/IR/IRDump.hpp"
+#include "nanocc/IR/SSA.hpp"
 
 #include "nanocc/Transforms/PassManager.hpp"
+#include "nanocc/Utils/ThreadPool.hpp"
+#include "nanocc/Utils/Utils.hpp"
 
 #include "nanocc/Transforms/ConstantFolding.hpp" // ConstantFoldInstructions
 #include "nanocc/Transforms/CopyPropagation.hpp" // CopyPropagate
 #include "nanocc/Transforms/DeadStoreElimination.hpp" // DeadStoreElimination
+#include "nanocc/Transforms/GVN.hpp" // GlobalValueNumbering
+#include "nanocc/Transforms/GlobalDCE.hpp" // EliminateDeadGlobals
+#include "nanocc/Transforms/IfConversion.hpp" // IfConversion
+#include "nanocc/Transforms/Inliner.hpp" // InlineCalls
+#include "nanocc/Transforms/InstCombine.hpp" // InstCombine
+#include "nanocc/Transforms/LICM.hpp" // LoopInvariantCodeMotion
+#include "nanocc/Transforms/LoopUnroll.hpp" // LoopUnroll
+#include "nanocc/Transforms/LoopUnswitch.hpp" // LoopUnswitch
+#include "nanocc/Transforms/SCCP.hpp" // SparseConditionalConstantPropagation
+#include "nanocc/Transforms/SSAPropagation.hpp" // SSAPropagate
 #include "nanocc/Transforms/SimplifyCFG.hpp" // UnreachableCodeElimination
+#include "nanocc/Transforms/StrengthReduction.hpp" // InductionVariableStrengthReduction
+#include "nanocc/Transforms/TailCallElim.hpp" // TailCallElimination
 
-template <typename PassType> void PassManager::AddPass(PassType Pass) {
-  Passes.push_back(Pass);
+template <typename PassType>
+void PassManager::AddPass(std::string name, PassType Pass, PassTraits traits) {
+  Passes.push_back({std::move(name), Pass, traits});
 }
 
-void PassManager::run(IRProgramNode& IRProgram, bool debug) {
-  int iteration = 1;
-  do {
-    bool changed = false;
-    for (auto& Pass : Passes) {
-      changed |= Pass(IRProgram);
+void PassManager::AddSCCPass(std::string name, SCCPassFn Pass) {
+  SCCPasses.emplace_back(std::move(name), std::move(Pass));
+}
+
+void PassManager::runOnFunction(IRFunctionNode& IRFunc, bool debug) {
+  // analyses never look across functions, one cache per task needs no locks
+  AnalysisManager AM;
+  std::vector<bool> pending(Passes.size(), true);
+  unsigned iteration = 0;
+  while (std::find(pending.begin(), pending.end(), true) != pending.end()) {
+    if (iteration == iterationBudget) {
+      // passes undoing each other's work, or a pass reporting a change that
+      // isn't one
+      std::string stillPending;
+      for (size_t i = 0; i < Passes.size(); i++) {
+        if (pending[i])
+          stillPending += (stillPending.empty() ? "" : ", ") + Passes[i].name;
+      }
+      std::println(stderr,
+                   "Warning: {}: iteration budget ({}) exhausted with {} "
+                   "still pending",
+                   IRFunc.funcName, iterationBudget, stillPending);
+      break;
+    }
+    iteration++;
+    for (size_t i = 0; i < Passes.size(); i++) {
+      if (!pending[i])
+        continue;
+      pending[i] = false;
+      PassResult Result = Passes[i].run(IRFunc, AM);
+      AM.invalidate(IRFunc, Result.preserved);
+      if (!Result.changed)
+        continue;
+      ChangeKinds Made = Passes[i].traits.makes;
+      // keeping the CFG means leaving every branch and label alone
+      if (Result.preserved.isPreserved(AnalysisKind::CFG))
+        Made.remove(ChangeKind::ControlFlow);
+      for (size_t j = 0; j < Passes.size(); j++) {
+        auto& Traits = Passes[j].traits;
+        if (j == i ? !Traits.idempotent : Traits.enabledBy.intersects(Made))
+          pending[j] = true;
+      }
       if (debug) {
-        std::println("---- IR Optimization Iteration {} ----", iteration);
-        IRGen::programNodeIRDump(IRProgram, 0);
+        std::println("---- IR Optimization: {} on {}, iteration {} ----",
+                     Passes[i].name, IRFunc.funcName, iteration);
+        IRGen::functionNodeIRDump(IRFunc, 0);
         std::println("--------------------------------------");
       }
     }
-    // stop if no changes were made by any pass
-    if (!changed)
-      break;
-    iteration++;
-  } while (true);
+  }
+}
+
+void PassManager::runOnSCC(const std::vector<CallGraphNode*>& SCC,
+                           const CallGraph& CG, bool debug) {
+  for (auto& [name, Pass] : SCCPasses) {
+    if (!Pass(SCC, CG) || !debug)
+      continue;
+    for (auto* Node : SCC) {
+      std::println("---- IR Optimization: {} on {} ----", name,
+                   Node->function->funcName);
+      IRGen::functionNodeIRDump(*Node->function, 0);
+      std::println("--------------------------------------");
+    }
+  }
+  for (auto* Node : SCC) {
+    runOnFunction(*Node->function, debug);
+  }
+}
+
+// functions stay where they are in `topLevel`, only the order they're
+// optimized in follows the calls
+void PassManager::run(IRProgramNode& IRProgram, bool debug) {
+  CallGraph CG(IRProgram);
+  if (debug)
+    CG.print();
+  std::vector<std::vector<size_t>> byHeight; // sccIds
+  for (size_t id = 0; id < CG.getSCCs().size(); id++) {
+    unsigned height = CG.getHeight(id);
+    if (byHeight.size() <= height)
+      byHeight.resize(height + 1);
+    byHeight[height].push_back(id);
+  }
+  ThreadPool Pool(debug ? 1 : numThreads);
+  for (auto& SCCIds : byHeight) {
+    Pool.parallelFor(SCCIds.size(), [&](size_t i) {
+      runOnSCC(CG.getSCCs()[SCCIds[i]], CG, debug);
+    });
+  }
 }
 
 namespace nanocc {
 
+bool parseOptFlag(const std::string& flag, OptFlags& flags) {
+  static const std::unordered_map<std::string, OptPass> optFlagToPass = {
+      {"-fopt-constfold", OptPass::ConstantFolding},
+      {"-fopt-unreach", OptPass::UnreachableCodeElim},
+      {"-fopt-copyprop", OptPass::CopyPropagation},
+      {"-fopt-dse", OptPass::DeadStoreElim},
+      {"-fopt-ssa", OptPass::SSAPropagation},
+      {"-fopt-sccp", OptPass::SCCP},
+      {"-fopt-gvn", OptPass::GVN},
+      {"-fopt-instcombine", OptPass::InstCombine},
+      {"-fopt-licm", OptPass::LICM},
+      {"-fopt-unswitch", OptPass::LoopUnswitch},
+      {"-fopt-ivsr", OptPass::IVStrengthReduction},
+      {"-fopt-unroll", OptPass::LoopUnroll},
+      {"-fopt-ifconvert", OptPass::IfConversion},
+      {"-fopt-inline", OptPass::Inline},
+      {"-fopt-tailcall", OptPass::TailCallElim},
+      {"-fopt-globaldce", OptPass::GlobalDCE},
+  };
+  // -fopt-<name>=<unsigned>
+  static const std::unordered_map<std::string, unsigned OptFlags::*>
+      numericFlags = {
+          {"-fopt-budget=", &OptFlags::iterationBudget},
+          {"-fopt-threads=", &OptFlags::numThreads},
+          {"-fopt-unroll-factor=", &OptFlags::unrollFactor},
+      };
+  for (auto& [prefix, field] : numericFlags) {
+    if (!flag.starts_with(prefix))
+      continue;
+    std::string value = flag.substr(prefix.size());
+    if (value.empty() || value.size() > 9 ||
+        !std::all_of(value.begin(), value.end(), ::isdigit))
+      return false;
+    flags.*field = std::stoul(value);
+    return true;
+  }
+  auto it = optFlagToPass.find(flag);
+  if (it == optFlagToPass.end())
+    return false;
+  flags.optPasses.insert(it->second);
+  return true;
+}
+
 void runIROptimizationPipeline(IRProgramNode& IRProgram, const OptFlags& flags,
                                bool debug) {
   PassManager PM;
+  PM.setIterationBudget(flags.iterationBudget);
+  PM.setNumThreads(flags.numThreads);
+  // the passes on SSA form only see definitions some use reads, removing a
+  // dead store gives them nothing
+  const ChangeKinds ValueFlow = {ChangeKind::Values, ChangeKind::Insertion,
+                                 ChangeKind::ControlFlow};
+  if (flags.optPasses.contains(OptPass::Inline)) {
+    PM.AddSCCPass("inline", InlineCalls);
+  }
+  if (flags.optPasses.contains(OptPass::TailCallElim)) {
+    // first, the other passes should see the loops it makes
+    PM.AddPass("tailcall", TailCallElimination);
+  }
   if (flags.optPasses.contains(OptPass::ConstantFolding)) {
-    PM.AddPass(ConstantFoldInstructions);
+    // looks at one instruction at a time, only constant operands matter
+    PM.AddPass("constfold", ConstantFoldInstructions,
+               {.makes = {ChangeKind::Values, ChangeKind::Removal,
+                          ChangeKind::ControlFlow},
+                .enabledBy = {ChangeKind::Values, ChangeKind::Insertion}});
+  }
+  if (flags.optPasses.contains(OptPass::InstCombine)) {
+    PM.AddPass("instcombine", InstCombine, {.enabledBy = ValueFlow});
+  }
+  if (flags.optPasses.contains(OptPass::SCCP)) {
+    PM.AddPass("sccp", SparseConditionalConstantPropagation,
+               {.enabledBy = ValueFlow});
+  }
+  if (flags.optPasses.contains(OptPass::SSAPropagation)) {
+    PM.AddPass("ssa", SSAPropagate, {.enabledBy = ValueFlow});
+  }
+  if (flags.optPasses.contains(OptPass::GVN)) {
+    PM.AddPass("gvn", GlobalValueNumbering, {.enabledBy = ValueFlow});
+  }
+  if (flags.optPasses.contains(OptPass::LICM)) {
+    PM.AddPass("licm", LoopInvariantCodeMotion, {.enabledBy = ValueFlow});
+  }
+  if (flags.optPasses.contains(OptPass::LoopUnswitch)) {
+    // the copies of a loop may have more invariant branches to unswitch
+    PM.AddPass("unswitch", LoopUnswitch, {.idempotent = false});
+  }
+  if (flags.optPasses.contains(OptPass::IVStrengthReduction)) {
+    PM.AddPass("ivsr", InductionVariableStrengthReduction);
+  }
+  if (flags.optPasses.contains(OptPass::LoopUnroll)) {
+    // fully unrolling an inner loop can leave the outer one innermost
+    unsigned factor = flags.unrollFactor;
+    PM.AddPass(
+        "unroll",
+        [factor](IRFunctionNode& IRFunc, AnalysisManager& AM) {
+          return LoopUnroll(IRFunc, AM, factor);
+        },
+        {.idempotent = false});
+  }
+  if (flags.optPasses.contains(OptPass::IfConversion)) {
+    // after the loop passes, which want the branches; converting a hammock
+    // can make the one around it small enough
+    PM.AddPass("ifconvert", IfConversion, {.idempotent = false});
   }
   if (flags.optPasses.contains(OptPass::UnreachableCodeElim)) {
-    PM.AddPass(SimplifyCFG);
+    // removing a jump can make the branch before it redundant; values don't
+    // decide where a branch goes, constant folding turns those into jumps
+    PM.AddPass("unreach", SimplifyCFG,
+               {.makes = {ChangeKind::Removal, ChangeKind::ControlFlow},
+                .enabledBy = {ChangeKind::Removal, ChangeKind::Insertion,
+                              ChangeKind::ControlFlow},
+                .idempotent = false});
   }
   if (flags.optPasses.contains(OptPass::CopyPropagation)) {
-    PM.AddPass(CopyPropagate);
+    PM.AddPass("copyprop", CopyPropagate,
+               {.makes = {ChangeKind::Values, ChangeKind::Removal}});
   }
   if (flags.optPasses.contains(OptPass::DeadStoreElim)) {
-    PM.AddPass(DeadStoreElimination);
+    // a store removed in one block can make stores in its predecessors dead
+    PM.AddPass("dse", DeadStoreElimination,
+               {.makes = {ChangeKind::Removal}, .idempotent = false});
   }
   PM.run(IRProgram, debug);
+  if (flags.optPasses.contains(OptPass::GlobalDCE)) {
+    // after the function passes, the calls they removed don't count
+    EliminateDeadGlobals(IRProgram, debug);
+  }
+
+  // codegen only knows the non-SSA instructions
+  for (auto& TopLvl : IRProgram.topLevel) {
+    if (auto* IRFunc = dyn_cast<IRFunctionNode>(TopLvl.get()))
+      destructSSA(*IRFunc);
+  }
 }
 } // namespace nanocc
@@ -0,0 +1,362 @@
+#include <algorithm>
+#include <cassert>
+#include <deque>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "nanocc/IR/BasicBlock.hpp"
+#include "nanocc/IR/DefUse.hpp"
+#include "nanocc/IR/IR.hpp"
+#include "nanocc/IR/SSA.hpp"
+#include "nanocc/Transforms/ConstantFolding.hpp"
+#include "nanocc/Transforms/LoopUtils.hpp"
+#include "nanocc/Transforms/SCCP.hpp"
+#include "nanocc/Utils/Utils.hpp"
+
+/*
+Sparse conditional constant propagation (Wegman and Zadeck, "Constant
+Propagation with Conditional Branches"), on SSA form. Every value sits on
+    unknown  ->  constant c  ->  overdefined
+and only moves right. Two worklists drive the solver:
+    CFG edges: the first edge into a block visits all of it, later edges
+               only re-evaluate its phis
+    SSA edges: a value that moved re-evaluates its users in executable blocks
+A phi only meets the operands of executable edges, a conditional branch on a
+constant only marks the edge it takes, so code behind a branch that is never
+taken doesn't spoil the values after the join:
+    x = 3                 x = 3
+    y = x + 4             if (7 > 5) -> jump L
+    if (y > 5) ... else   (else side deleted)
+Afterwards constant values and the sources of copies replace their uses,
+branches on constants become jumps, and the blocks no executable edge reaches
+are deleted.
+*/
+
+namespace {
+using ValuePtr = std::shared_ptr<IRValNode>;
+
+struct LatticeValue {
+  enum Kind { Unknown, Constant, Overdefined };
+  Kind kind = Unknown;
+  int value = 0; // only for Constant
+
+  static LatticeValue getConstant(int val) { return {Constant, val}; }
+  static LatticeValue getOverdefined() { return {Overdefined, 0}; }
+  bool isUnknown() const { return kind == Unknown; }
+  bool isConstant() const { return kind == Constant; }
+  bool isOverdefined() const { return kind == Overdefined; }
+  bool operator==(const LatticeValue&) const = default;
+
+  void meet(const LatticeValue& RHS) {
+    if (isOverdefined() || RHS.isUnknown())
+      return;
+    if (isUnknown() || RHS.isOverdefined())
+      *this = RHS;
+    else if (value != RHS.value)
+      *this = getOverdefined();
+  }
+};
+
+class SCCPSolver {
+  IRFunctionNode& IRFunc;
+  ControlFlowGraph CFG;
+  DefUseChains DU;
+  std::unordered_map<IRInstructionNode*, BasicBlock*> blockOf;
+  std::unordered_map<std::string, LatticeValue> values;
+  std::vector<bool> executable; // by blockId
+  std::set<std::pair<size_t, size_t>> executableEdges; // (from, to) blockIds
+  std::deque<BasicBlock*> blockWorklist;
+  std::deque<IRInstructionNode*> instrWorklist;
+
+public:
+  explicit SCCPSolver(IRFunctionNode& IRFunc)
+      : IRFunc(IRFunc), CFG(IRFunc), DU(IRFunc), executable(CFG.size()) {
+    for (auto& BB : CFG.blocks) {
+      for (auto& IRInstr : *BB) {
+        blockOf[IRInstr.get()] = BB.get();
+      }
+    }
+  }
+
+  void solve() {
+    if (CFG.empty())
+      return;
+    executable[CFG.getEntry()->blockId] = true;
+    blockWorklist.push_back(CFG.getEntry());
+    while (!blockWorklist.empty() || !instrWorklist.empty()) {
+      while (!instrWorklist.empty()) {
+        IRInstructionNode* IRInstr = instrWorklist.front();
+        instrWorklist.pop_front();
+        if (executable[blockOf.at(IRInstr)->blockId])
+          visit(IRInstr);
+      }
+      if (!blockWorklist.empty()) {
+        BasicBlock* BB = blockWorklist.front();
+        blockWorklist.pop_front();
+        for (auto& IRInstr : *BB) {
+          visit(IRInstr.get());
+        }
+        visitSuccessors(BB);
+      }
+    }
+  }
+
+  /// @brief Rewrites the function with what `solve` found.
+  void rewrite() {
+    replaceConstantValues();
+    forwardCopies();
+    // the def-use chains are out of date from here on: phis lose operands
+    // and whole blocks go away
+    for (auto& BB : CFG.blocks) {
+      if (!executable[BB->blockId])
+        continue;
+      removeDeadIncoming(BB.get());
+      foldBranch(BB.get());
+    }
+    // blocks are views into the instruction list, erasing one block's range
+    // leaves the others valid
+    for (auto& BB : CFG.blocks) {
+      if (!executable[BB->blockId])
+        IRFunc.IRInstructions.erase(BB->begin(), BB->end());
+    }
+  }
+
+private:
+  LatticeValue getValue(const ValuePtr& val) {
+    if (auto* Const = dyn_cast<IRConstNode>(val.get()))
+      return LatticeValue::getConstant(Const->IntVal);
+    if (!DefUseChains::isTracked(val.get()))
+      return LatticeValue::getOverdefined(); // may change behind our back
+    auto& Name = cast<IRVariableNode>(val.get())->varName;
+    auto it = values.find(Name);
+    if (it != values.end())
+      return it->second;
+    // parameters and reads of undefined variables
+    if (!DU.getDef(Name))
+      return LatticeValue::getOverdefined();
+    return {};
+  }
+
+  void setValue(IRInstructionNode* IRInstr, const LatticeValue& val) {
+    IRValSlot Result = IRInstr->result();
+    if (!Result || !DefUseChains::isTracked(Result->get()))
+      return;
+    auto& Name = cast<IRVariableNode>(Result->get())->varName;
+    auto& Current = values[Name];
+    if (Current == val)
+      return;
+    assert(Current.isUnknown() || val.isOverdefined());
+    Current = val;
+    for (auto& U : DU.getUses(Name)) {
+      instrWorklist.push_back(U.user);
+    }
+  }
+
+  bool isExecutableEdge(const BasicBlock* From, const BasicBlock* To) const {
+    return executableEdges.contains({From->blockId, To->blockId});
+  }
+
+  void markEdge(BasicBlock* From, BasicBlock* To) {
+    if (!executableEdges.insert({From->blockId, To->blockId}).second)
+      return;
+    if (!executable[To->blockId]) {
+      executable[To->blockId] = true;
+      blockWorklist.push_back(To);
+      return;
+    }
+    // already visited, only the phis see the new edge
+    for (auto& IRInstr : *To) {
+      if (auto* Phi = dyn_cast<IRPhiNode>(IRInstr.get()))
+        visit(Phi);
+    }
+  }
+
+  void visitSuccessors(BasicBlock* BB) {
+    IRInstructionNode* Last = BB->back();
+    if (isa<IRRetNode>(Last))
+      return;
+    BasicBlock* Next = CFG.getLayoutSuccessor(BB);
+    auto* Branch = dyn_cast<IRBranchNode>(Last);
+    if (!Branch) {
+      if (Next)
+        markEdge(BB, Next);
+      return;
+    }
+    BasicBlock* Target = CFG.getBlockForLabel(Branch->labelId);
+    if (!Branch->isConditional()) {
+      markEdge(BB, Target);
+      return;
+    }
+    // the branch decides once all its operands are known
+    std::vector<int> vals;
+    bool overdefined = false;
+    for (IRValSlot Slot : Branch->operands()) {
+      LatticeValue Operand = getValue(*Slot);
+      if (Operand.isUnknown())
+        return;
+      overdefined |= Operand.isOverdefined();
+      vals.push_back(Operand.value);
+    }
+    bool jumps = !overdefined && nanocc::takesBranch(*Branch, vals);
+    bool mayJump = overdefined || jumps;
+    bool mayFallThrough = overdefined || !jumps;
+    if (mayJump)
+      markEdge(BB, Target);
+    if (mayFallThrough && Next)
+      markEdge(BB, Next);
+  }
+
+  void visit(IRInstructionNode* IRInstr) {
+    if (auto* Phi = dyn_cast<IRPhiNode>(IRInstr)) {
+      BasicBlock* BB = blockOf.at(Phi);
+      LatticeValue Merged;
+      for (auto& In : Phi->incoming) {
+        BasicBlock* Pred = CFG.getBlockForLabel(In.labelId);
+        if (Pred && isExecutableEdge(Pred, BB))
+          Merged.meet(getValue(In.value));
+      }
+      setValue(Phi, Merged);
+    } else if (auto* Copy = dyn_cast<IRCopyNode>(IRInstr)) {
+      setValue(Copy, getValue(Copy->ValSrc));
+    } else if (auto* Unary = dyn_cast<IRUnaryNode>(IRInstr)) {
+      LatticeValue Src = getValue(Unary->valSrc);
+      if (Src.isConstant()) {
+        auto Folded = nanocc::foldUnaryOp(Unary->opType, Src.value);
+        Src = Folded ? LatticeValue::getConstant(*Folded)
+                     : LatticeValue::getOverdefined();
+      }
+      setValue(Unary, Src);
+    } else if (auto* Binary = dyn_cast<IRBinaryNode>(IRInstr)) {
+      setValue(Binary, evaluateBinary(Binary));
+    } else if (auto* Select = dyn_cast<IRSelectNode>(IRInstr)) {
+      setValue(Select, evaluateSelect(Select));
+    } else if (isa<IRBranchNode>(IRInstr)) {
+      // the condition changed
+      visitSuccessors(blockOf.at(IRInstr));
+    } else {
+      setValue(IRInstr, LatticeValue::getOverdefined()); // calls
+    }
+  }
+
+  LatticeValue evaluateBinary(IRBinaryNode* Binary) {
+    LatticeValue SrcL = getValue(Binary->valSrcL);
+    LatticeValue SrcR = getValue(Binary->valSrcR);
+    if (SrcL.isOverdefined() || SrcR.isOverdefined())
+      return LatticeValue::getOverdefined();
+    if (SrcL.isUnknown() || SrcR.isUnknown())
+      return {};
+    // division traps are left to run time
+    auto Folded = nanocc::foldBinaryOp(Binary->opType, SrcL.value, SrcR.value);
+    return Folded ? LatticeValue::getConstant(*Folded)
+                  : LatticeValue::getOverdefined();
+  }
+
+  LatticeValue evaluateSelect(IRSelectNode* Select) {
+    LatticeValue SrcL = getValue(Select->valSrcL);
+    LatticeValue SrcR = getValue(Select->valSrcR);
+    if (SrcL.isConstant() && SrcR.isConstant()) {
+      bool cond = *nanocc::foldBinaryOp(Select->opType, SrcL.value, SrcR.value);
+      return getValue(cond ? Select->valTrue : Select->valFalse);
+    }
+    if (!SrcL.isOverdefined() && !SrcR.isOverdefined())
+      return {};
+    // either value, the same constant for both is still a constant
+    LatticeValue Merged = getValue(Select->valTrue);
+    Merged.meet(getValue(Select->valFalse));
+    return Merged;
+  }
+
+  void replaceConstantValues() {
+    for (auto& [Name, Val] : values) {
+      if (!Val.isConstant())
+        continue;
+      DU.replaceAllUsesWith(Name, std::make_shared<IRConstNode>(Val.value));
+      if (auto* Def = DU.getDef(Name))
+        DU.erase(Def);
+    }
+  }
+
+  /// @brief uses of `dest = var` read `var`, like in `SSAPropagate`: the
+  /// copies left behind would end up elsewhere than those of the phis
+  void forwardCopies() {
+    std::vector<IRCopyNode*> Copies;
+    for (auto& BB : CFG.blocks) {
+      if (!executable[BB->blockId])
+        continue;
+      for (auto& IRInstr : *BB) {
+        auto* Copy = dyn_cast<IRCopyNode>(IRInstr.get());
+        if (Copy && DefUseChains::isTracked(Copy->ValSrc.get()) &&
+            DefUseChains::isTracked(Copy->ValDest.get()))
+          Copies.push_back(Copy);
+      }
+    }
+    for (auto* Copy : Copies) {
+      DU.replaceAllUsesWith(cast<IRVariableNode>(Copy->ValDest.get())->varName,
+                            Copy->ValSrc);
+      DU.erase(Copy);
+    }
+  }
+
+  void removeDeadIncoming(BasicBlock* BB) {
+    for (auto& IRInstr : *BB) {
+      auto* Phi = dyn_cast<IRPhiNode>(IRInstr.get());
+      if (!Phi)
+        continue;
+      std::erase_if(Phi->incoming, [&](const IRPhiNode::Incoming& In) {
+        BasicBlock* Pred = CFG.getBlockForLabel(In.labelId);
+        return !Pred || !isExecutableEdge(Pred, BB);
+      });
+    }
+  }
+
+  // conditions on constants were replaced by the constant already
+  void foldBranch(BasicBlock* BB) {
+    auto Last = std::prev(BB->end());
+    auto* Branch = dyn_cast<IRBranchNode>(Last->get());
+    if (!Branch || !Branch->isConditional())
+      return;
+    std::vector<int> vals;
+    for (IRValSlot Slot : Branch->operands()) {
+      auto* Const = dyn_cast<IRConstNode>(Slot->get());
+      if (!Const)
+        return;
+      vals.push_back(Const->IntVal);
+    }
+    if (nanocc::takesBranch(*Branch, vals))
+      *Last = std::make_unique<IRJumpNode>(Branch->labelName, Branch->labelId);
+    else
+      IRFunc.IRInstructions.erase(Last);
+  }
+};
+} // namespace
+
+namespace nanocc {
+/// @brief Sparse conditional constant propagation, unreachable blocks are
+/// removed on the way.
+/// @return changed if the code differs from before the SSA round trip, as in
+/// `SSAPropagate`
+PassResult SparseConditionalConstantPropagation(IRFunctionNode& IRFunc,
+                                                AnalysisManager&) {
+  if (IRFunc.IRInstructions.empty())
+    return PassResult::unchanged();
+  std::vector<std::unique_ptr<IRInstructionNode>> Before;
+  for (auto& IRInstr : IRFunc.IRInstructions)
+    Before.push_back(cloneInstruction(IRInstr.get()));
+  constructSSA(IRFunc);
+  SCCPSolver Solver(IRFunc);
+  Solver.solve();
+  Solver.rewrite();
+  destructSSA(IRFunc);
+  return {!std::equal(Before.begin(), Before.end(),
+                      IRFunc.IRInstructions.begin(),
+                      IRFunc.IRInstructions.end(),
+                      [](auto& A, auto& B) {
+                        return isSameInstruction(A.get(), B.get());
+                      }),
+          PreservedAnalyses::none()};
+}
+} // namespace nanocc
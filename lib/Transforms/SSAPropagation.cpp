@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "nanocc/IR/DefUse.hpp"
+#include "nanocc/IR/IR.hpp"
+#include "nanocc/IR/SSA.hpp"
+#include "nanocc/Transforms/ConstantFolding.hpp"
+#include "nanocc/Transforms/LoopUtils.hpp"
+#include "nanocc/Transforms/SSAPropagation.hpp"
+#include "nanocc/Utils/Utils.hpp"
+
+/*
+On SSA form every value has exactly one definition, so each rewrite only
+revisits the users of the value it changed (found through `DefUseChains`):
+    dest = const / dest = var        -> uses of dest read the source
+    dest = const op const            -> folded, then as above
+    dest = phi [v, ..], [v, ..]      -> uses of dest read v
+    dest = ... (no uses, no call)    -> removed, its operands are revisited
+Variables with static storage aren't in SSA form and are left alone.
+*/
+
+namespace {
+using ValuePtr = std::shared_ptr<IRValNode>;
+
+const std::string* getSSAName(const ValuePtr& val) {
+  if (!DefUseChains::isTracked(val.get()))
+    return nullptr;
+  return &cast<IRVariableNode>(val.get())->varName;
+}
+
+class SparsePropagation {
+  DefUseChains DU;
+  std::deque<IRInstructionNode*> worklist;
+
+public:
+  explicit SparsePropagation(IRFunctionNode& IRFunc) : DU(IRFunc) {
+    for (auto& IRInstr : IRFunc.IRInstructions) {
+      worklist.push_back(IRInstr.get());
+    }
+  }
+
+  void run() {
+    while (!worklist.empty()) {
+      IRInstructionNode* IRInstr = worklist.front();
+      worklist.pop_front();
+      if (DU.contains(IRInstr))
+        visit(IRInstr);
+    }
+  }
+
+private:
+  void eraseDef(IRInstructionNode* IRInstr) {
+    // operands may lose their last use
+    std::vector<IRInstructionNode*> OperandDefs;
+    for (IRValSlot Slot : IRInstr->operands()) {
+      if (auto* Name = getSSAName(*Slot)) {
+        if (auto* Def = DU.getDef(*Name))
+          OperandDefs.push_back(Def);
+      }
+    }
+    DU.erase(IRInstr);
+    worklist.insert(worklist.end(), OperandDefs.begin(), OperandDefs.end());
+  }
+
+  /// @brief dest := val everywhere, then drop the definition
+  void forwardDef(IRInstructionNode* IRInstr, const ValuePtr& val) {
+    std::string Name = *getSSAName(*IRInstr->result());
+    auto Users = DU.replaceAllUsesWith(Name, val);
+    worklist.insert(worklist.end(), Users.begin(), Users.end());
+    eraseDef(IRInstr);
+  }
+
+  void visit(IRInstructionNode* IRInstr) {
+    IRValSlot Result = IRInstr->result();
+    if (!Result || !getSSAName(*Result))
+      return;
+
+    // a call may have side effects, keep it even if the result is unused
+    if (!isa<IRFunctionCallNode>(IRInstr) &&
+        DU.use_empty(*getSSAName(*Result))) {
+      eraseDef(IRInstr);
+      return;
+    }
+
+    if (auto* Copy = dyn_cast<IRCopyNode>(IRInstr)) {
+      if (isa<IRConstNode>(Copy->ValSrc.get()) || getSSAName(Copy->ValSrc))
+        forwardDef(IRInstr, Copy->ValSrc);
+    } else if (auto* Unary = dyn_cast<IRUnaryNode>(IRInstr)) {
+      if (auto* Src = dyn_cast<IRConstNode>(Unary->valSrc.get())) {
+        if (auto Folded = nanocc::foldUnaryOp(Unary->opType, Src->IntVal))
+          forwardDef(IRInstr, std::make_shared<IRConstNode>(*Folded));
+      }
+    } else if (auto* Binary = dyn_cast<IRBinaryNode>(IRInstr)) {
+      auto* SrcL = dyn_cast<IRConstNode>(Binary->valSrcL.get());
+      auto* SrcR = dyn_cast<IRConstNode>(Binary->valSrcR.get());
+      if (SrcL && SrcR) {
+        if (auto Folded = nanocc::foldBinaryOp(Binary->opType, SrcL->IntVal,
+                                               SrcR->IntVal))
+          forwardDef(IRInstr, std::make_shared<IRConstNode>(*Folded));
+      }
+    } else if (auto* Select = dyn_cast<IRSelectNode>(IRInstr)) {
+      auto* SrcL = dyn_cast<IRConstNode>(Select->valSrcL.get());
+      auto* SrcR = dyn_cast<IRConstNode>(Select->valSrcR.get());
+      if (SrcL && SrcR) {
+        ValuePtr Picked =
+            *nanocc::foldBinaryOp(Select->opType, SrcL->IntVal, SrcR->IntVal)
+                ? Select->valTrue
+                : Select->valFalse;
+        if (isa<IRConstNode>(Picked.get()) || getSSAName(Picked))
+          forwardDef(IRInstr, Picked);
+      }
+    } else if (auto* Phi = dyn_cast<IRPhiNode>(IRInstr)) {
+      visitPhi(Phi);
+    }
+  }
+
+  /// @brief all operands the same value (ignoring the phi itself) => that value
+  void visitPhi(IRPhiNode* Phi) {
+    auto* DestName = getSSAName(Phi->valDest);
+    ValuePtr Same;
+    for (auto& In : Phi->incoming) {
+      auto* InName = getSSAName(In.value);
+      if (InName && *InName == *DestName)
+        continue;
+      if (Same) {
+        auto* SameConst = dyn_cast<IRConstNode>(Same.get());
+        auto* InConst = dyn_cast<IRConstNode>(In.value.get());
+        auto* SameName = getSSAName(Same);
+        bool equal = (SameConst && InConst &&
+                      SameConst->IntVal == InConst->IntVal) ||
+                     (SameName && InName && *SameName == *InName);
+        if (!equal)
+          return;
+        continue;
+      }
+      // static variables may differ between the predecessors
+      if (!InName && !isa<IRConstNode>(In.value.get()))
+        return;
+      Same = In.value;
+    }
+    if (Same)
+      forwardDef(Phi, Same);
+  }
+};
+} // namespace
+
+namespace nanocc {
+/// @brief Sparse constant/copy propagation and dead code elimination on SSA.
+/// @return changed if the code differs from before the SSA round trip. Nothing
+/// is preserved either way, the round trip recreates every instruction.
+PassResult SSAPropagate(IRFunctionNode& IRFunc, AnalysisManager&) {
+  std::vector<std::unique_ptr<IRInstructionNode>> Before;
+  for (auto& IRInstr : IRFunc.IRInstructions)
+    Before.push_back(cloneInstruction(IRInstr.get()));
+  constructSSA(IRFunc);
+  SparsePropagation(IRFunc).run();
+  destructSSA(IRFunc);
+  return {!std::equal(Before.begin(), Before.end(),
+                      IRFunc.IRInstructions.begin(),
+                      IRFunc.IRInstructions.end(),
+                      [](auto& A, auto& B) {
+                        return isSameInstruction(A.get(), B.get());
+                      }),
+          PreservedAnalyses::none()};
+}
+} // namespace nanocc
@@ -1,7 +1,5 @@
 #include <queue>
-#include <string>
-#include <unordered_map>
-#include <unordered_set>
+#include <vector>
 
 #include "nanocc/IR/BasicBlock.hpp"
 #include "nanocc/IR/IR.hpp"
@@ -9,129 +7,94 @@
 #include "nanocc/Utils/Utils.hpp"
 
 namespace {
-bool removeUnreachableBlocks(std::list<std::shared_ptr<BasicBlock>>& BBList) {
-  if (BBList.empty()) {
+bool removeUnreachableBlocks(IRFunctionNode& IRFunc, AnalysisManager& AM) {
+  const ControlFlowGraph& CFG = AM.getCFG(IRFunc);
+  if (CFG.empty()) {
     return false;
   }
 
   // perform BFS and mark reachable blocks as visited
-  std::unordered_set<size_t> visited;
+  std::vector<bool> visited(CFG.size(), false);
 
-  std::queue<BasicBlock::Iter> que;
-  BasicBlock::Iter EntryBlock = BBList.begin();
-  que.push(EntryBlock);
-  visited.insert((*EntryBlock)->blockId);
+  std::queue<BasicBlock*> que;
+  que.push(CFG.getEntry());
+  visited[CFG.getEntry()->blockId] = true;
 
   while (!que.empty()) {
-    BasicBlock::Iter BBIter = que.front();
+    BasicBlock* BB = que.front();
     que.pop();
 
     // go to adjacent nodes and add to que if they are not yet visited
-    for (auto childBBIter : BasicBlock::getSuccessors(BBIter, BBList)) {
-      if (!visited.contains((*childBBIter)->blockId)) {
-        visited.insert((*childBBIter)->blockId);
-        que.push(childBBIter);
+    for (BasicBlock* ChildBB : BB->successors) {
+      if (!visited[ChildBB->blockId]) {
+        visited[ChildBB->blockId] = true;
+        que.push(ChildBB);
       }
     }
   }
 
-  // remove unvisited blocks from BBList
+  // blocks are views into the instruction list; erasing one block's range
+  // leaves the iterators of the others valid
   bool changed = false;
-  for (auto BBIter = BBList.begin(); BBIter != BBList.end();) {
-    if (!visited.contains((*BBIter)->blockId)) {
+  for (auto& BB : CFG.blocks) {
+    if (!visited[BB->blockId]) {
+      IRFunc.IRInstructions.erase(BB->begin(), BB->end());
       changed = true;
-      // if first IR Instruction is Label, remove that from `LabelToBBMap`
-      if (!(*BBIter)->IRInstructions.empty()) {
-        auto& FirstIRInstr = (*BBIter)->IRInstructions.front();
-        if (auto* IRLabelInstr = dyn_cast<IRLabelNode>(FirstIRInstr.get())) {
-          LabelBBMap::obj().erase(IRLabelInstr->labelName);
-        }
-      }
-      BBIter = BBList.erase(BBIter);
-    } else {
-      BBIter++;
     }
   }
   return changed;
 }
 
-bool removeRedundantJumpsLabelsEmptyBlocks(
-    std::list<std::shared_ptr<BasicBlock>>& BBList) {
+// remove redundant Jumps:
+// If the jump target is reached by falling through anyway (only labels in
+// between), the Jump instruction is not useful
+bool removeRedundantJumps(IRFunctionNode& IRFunc) {
   bool changed = false;
-
-  // returns true if BB was erased, due to being empty else false
-  auto eraseBBIfEmpty = [&](BasicBlock::Iter& BBIter) -> bool {
-    if ((*BBIter)->IRInstructions.empty()) {
-      BBIter = BBList.erase(BBIter);
-      changed = true;
-      return true;
-    }
-    return false;
-  };
-
-  for (auto BBIter = BBList.begin(); BBIter != BBList.end();) {
-    BasicBlock* BB = (*BBIter).get();
-
-    if (eraseBBIfEmpty(BBIter))
-      continue;
-
-    // remove redundant Jumps:
-    // If the default next block is the only child, then
-    // remove the Jump instruction, it's not useful
-    IRInstructionNode* BBLastIRInstr = BB->IRInstructions.back().get();
-    if (std::next(BBIter) != BBList.end() &&
-        (isa<IRJumpNode>(BBLastIRInstr) ||
-         isa<IRJumpIfZeroNode>(BBLastIRInstr) ||
-         isa<IRJumpIfNotZeroNode>(BBLastIRInstr))) {
-      bool keepJump = false;
-      auto BBDefaultNextIter = std::next(BBIter);
-      // if BBDefaultNextIter is the only child, then remove that Instruction
-      for (auto BBChildIter : BasicBlock::getSuccessors(BBIter, BBList)) {
-        if (BBChildIter != BBDefaultNextIter) {
-          keepJump = true;
+  auto& IRInstructions = IRFunc.IRInstructions;
+  for (auto it = IRInstructions.begin(); it != IRInstructions.end();) {
+    auto* Branch = dyn_cast<IRBranchNode>(it->get());
+    bool redundant = false;
+    if (Branch) {
+      for (auto next = std::next(it); next != IRInstructions.end(); ++next) {
+        auto* Label = dyn_cast<IRLabelNode>(next->get());
+        if (!Label)
+          break;
+        if (Label->labelId == Branch->labelId) {
+          redundant = true;
           break;
         }
       }
-      if (!keepJump) {
-        BB->IRInstructions.pop_back();
-        changed = true;
-        if (eraseBBIfEmpty(BBIter))
-          continue;
-      }
     }
+    if (redundant) {
+      it = IRInstructions.erase(it);
+      changed = true;
+    } else {
+      ++it;
+    }
+  }
+  return changed;
+}
 
-    // remove redundant Label:
-    // If the only parent BasicBlock is the one before BB
-    // in the BBList also then remove it, anyway it will
-    // reach the BasicBlock BB without the label
-    auto& BBFirstIRInstr = BB->IRInstructions.front();
-    if (auto* IRLabelInstr = dyn_cast<IRLabelNode>(BBFirstIRInstr.get());
-        IRLabelInstr) {
-      bool keepLabel = false;
-      if (BBIter == BBList.begin()) {
-        // entry block, but has predecessors => keep label
-        //            , has no predecessors  => remove label
-        keepLabel = !BasicBlock::getPredecessor(BBIter, BBList).empty();
-      } else {
-        auto BBDefaultPrevIter = std::prev(BBIter);
-        for (auto BBParentIter : BasicBlock::getPredecessor(BBIter, BBList)) {
-          if (BBParentIter != BBDefaultPrevIter) {
-            keepLabel = true;
-            break;
-          }
-        }
-      }
-      if (!keepLabel) {
-        LabelBBMap::obj().erase(IRLabelInstr->labelName);
-        BB->IRInstructions.pop_front();
-        if (eraseBBIfEmpty(BBIter))
-          continue;
-      }
+// remove redundant Labels:
+// Once redundant jumps are gone, a label nobody jumps to is only ever reached
+// by falling through, so it doesn't need to start a new BasicBlock
+bool removeUnusedLabels(IRFunctionNode& IRFunc) {
+  std::vector<size_t> numJumpsTo(IRFunc.numLabels, 0);
+  for (auto& IRInstr : IRFunc.IRInstructions) {
+    if (auto* Branch = dyn_cast<IRBranchNode>(IRInstr.get())) {
+      numJumpsTo[Branch->labelId]++;
     }
+  }
 
-    // remove BasicBlock if it has no Instructions left
-    if (!eraseBBIfEmpty(BBIter)) {
-      ++BBIter;
+  bool changed = false;
+  auto& IRInstructions = IRFunc.IRInstructions;
+  for (auto it = IRInstructions.begin(); it != IRInstructions.end();) {
+    auto* Label = dyn_cast<IRLabelNode>(it->get());
+    if (Label && numJumpsTo[Label->labelId] == 0) {
+      it = IRInstructions.erase(it);
+      changed = true;
+    } else {
+      ++it;
     }
   }
   return changed;
@@ -140,25 +103,13 @@ bool removeRedundantJumpsLabelsEmptyBlocks(
 
 namespace nanocc {
 /// @brief Unreachable code elimination
-/// @param IRProgram
-/// @return
-bool SimplifyCFG(IRProgramNode& IRProgram) {
+/// @return changed if a block, jump or label was removed; nothing is
+/// preserved
+PassResult SimplifyCFG(IRFunctionNode& IRFunc, AnalysisManager& AM) {
   bool changed = false;
-  for (auto& topLevel : IRProgram.topLevel) {
-    if (auto* funcNode = dyn_cast<IRFunctionNode>(topLevel.get())) {
-      auto& IRInstructions = funcNode->IRInstructions;
-      auto BBList = BasicBlock::getBasicBlocks(IRInstructions);
-      changed |= removeUnreachableBlocks(BBList);
-      changed |= removeRedundantJumpsLabelsEmptyBlocks(BBList);
-
-      IRInstructions.clear();
-      for (auto& BB : BBList) {
-        for (auto& IRInstr : BB->IRInstructions) {
-          IRInstructions.push_back(std::move(IRInstr));
-        }
-      }
-    }
-  }
-  return changed;
+  changed |= removeUnreachableBlocks(IRFunc, AM);
+  changed |= removeRedundantJumps(IRFunc);
+  changed |= removeUnusedLabels(IRFunc);
+  return changed ? PassResult::modified() : PassResult::unchanged();
 }
 } // namespace nanocc
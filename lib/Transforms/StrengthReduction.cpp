@@ -0,0 +1,464 @@
+#include <climits>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "nanocc/Analysis/Dominators.hpp"
+#include "nanocc/Analysis/LoopInfo.hpp"
+#include "nanocc/IR/BasicBlock.hpp"
+#include "nanocc/IR/DefUse.hpp"
+#include "nanocc/IR/IR.hpp"
+#include "nanocc/IR/SSA.hpp"
+#include "nanocc/Transforms/LoopUtils.hpp"
+#include "nanocc/Transforms/StrengthReduction.hpp"
+#include "nanocc/Utils/Utils.hpp"
+
+/*
+Induction variable strength reduction on SSA form, inner loops first.
+A basic induction variable is a header phi that enters the loop with a
+constant or loop invariant value and comes back around as itself plus a
+constant. Values that are a basic induction variable plus a constant
+(through copies, `+` and `-`) are its affine values. A multiplication of one
+by a constant or loop invariant `k` gets a derived induction variable that
+holds `iv * k` and grows by `step * k`:
+    preheader:                       preheader:
+                                       iv.0 = i.0 * k
+                                       st = 1 * k
+    header:                          header:
+      i = phi [i.0], [i.2]     ->      i = phi [i.0], [i.2]
+                                       iv = phi [iv.0], [iv.1]
+                                       iv.1 = iv + st
+      t = i * k                        t = iv
+      i.2 = i + 1                      i.2 = i + 1
+Everything wraps around like the target does, so `(i + n * step) * k` and
+`i * k + n * step * k` agree without any overflow check.
+If the back edge then tests the basic induction variable against a constant
+and the trip count is known, the test is rewritten against `iv` with the
+bound multiplied by `k` (linear function test replacement), which needs the
+products of all the compared values to fit an int. A basic induction variable
+left with no use outside its own update cycle is deleted.
+*/
+
+namespace {
+using ValuePtr = std::shared_ptr<IRValNode>;
+
+bool fitsInt(long long val) { return val >= INT_MIN && val <= INT_MAX; }
+
+ValuePtr makeVar(const std::string& name) {
+  return std::make_shared<IRVariableNode>(name);
+}
+
+/// @brief the name of `val` if it's a variable
+const std::string* getName(const ValuePtr& val) {
+  auto* Var = dyn_cast<IRVariableNode>(val.get());
+  return Var ? &Var->varName : nullptr;
+}
+
+/// @brief `base + offset`, `base` a header phi
+struct Affine {
+  std::string base;
+  long long offset;
+};
+
+struct BasicIV {
+  ValuePtr init; // value entering the loop
+  long long step;
+  // derived induction variables by multiplier, constants by their digits
+  // (names can't start with a digit or '-')
+  std::map<std::string, std::pair<std::string, std::string>> derived;
+  long long constMultiplier = 0; // of some derived one, 0 if none
+};
+
+class IVReducer {
+  IRFunctionNode& IRFunc;
+  ControlFlowGraph CFG;
+  DominatorTree DT;
+  LoopInfo LI;
+  DefUseChains DU;
+  std::unordered_map<IRInstructionNode*, BasicBlock*> blockOf;
+  bool changed = false;
+
+  // state of the loop being reduced
+  BasicBlock* Preheader = nullptr;
+  BasicBlock* Latch = nullptr;
+  std::unordered_map<std::string, Affine> affines;
+  std::unordered_map<std::string, BasicIV> basicIVs;
+
+public:
+  explicit IVReducer(IRFunctionNode& IRFunc)
+      : IRFunc(IRFunc), CFG(IRFunc), DT(CFG), LI(CFG, DT), DU(IRFunc) {
+    for (auto& BB : CFG.blocks) {
+      for (auto& IRInstr : *BB) {
+        blockOf[IRInstr.get()] = BB.get();
+      }
+    }
+  }
+
+  /// @return true if the function changed
+  bool run() {
+    // values an inner loop computes in its preheader are still in the outer
+    // loop and get reduced there
+    for (auto& L : LI.getLoops()) {
+      reduce(*L);
+    }
+    return changed;
+  }
+
+private:
+  bool isInvariant(const ValuePtr& val, const Loop& L) const {
+    if (isa<IRConstNode>(val.get()))
+      return true;
+    if (!DefUseChains::isTracked(val.get()))
+      return false; // static variables may change in the loop
+    IRInstructionNode* Def = DU.getDef(*getName(val));
+    return !Def || !L.contains(blockOf.at(Def));
+  }
+
+  /// @return the constant `val` is a copy of, else `val`
+  ValuePtr lookThroughCopy(const ValuePtr& val) const {
+    if (!DefUseChains::isTracked(val.get()))
+      return val;
+    auto* Copy = dyn_cast<IRCopyNode>(DU.getDef(*getName(val)));
+    if (Copy && isa<IRConstNode>(Copy->ValSrc.get()))
+      return Copy->ValSrc;
+    return val;
+  }
+
+  const Affine* getAffine(const ValuePtr& val) const {
+    const std::string* Name = getName(val);
+    if (!Name)
+      return nullptr;
+    auto it = affines.find(*Name);
+    if (it == affines.end() || !basicIVs.contains(it->second.base))
+      return nullptr;
+    return &it->second;
+  }
+
+  void reduce(const Loop& L) {
+    Preheader = L.getPreheader();
+    if (!Preheader || L.latches.size() != 1)
+      return;
+    Latch = L.latches.front();
+    findAffineValues(L);
+    findBasicIVs(L);
+    if (basicIVs.empty())
+      return;
+
+    std::vector<IRBinaryNode*> Products;
+    for (auto* BB : L.blocks) {
+      for (auto& IRInstr : *BB) {
+        auto* Binary = dyn_cast<IRBinaryNode>(IRInstr.get());
+        if (Binary && Binary->opType == TokenType::STAR)
+          Products.push_back(Binary);
+      }
+    }
+    for (auto* Product : Products) {
+      reduceProduct(Product, L);
+    }
+    for (auto& [Name, IV] : basicIVs) {
+      replaceExitTest(Name, IV, L);
+      removeIfUnused(Name);
+    }
+  }
+
+  void findAffineValues(const Loop& L) {
+    affines.clear();
+    for (auto& IRInstr : *L.header) {
+      auto* Phi = dyn_cast<IRPhiNode>(IRInstr.get());
+      if (Phi && Phi->incoming.size() == 2)
+        affines[*getName(Phi->valDest)] = {*getName(Phi->valDest), 0};
+    }
+    // definitions come before their uses in reverse postorder, phis aside
+    for (auto* BB : DT.getReversePostOrder()) {
+      if (!L.contains(BB))
+        continue;
+      for (auto& IRInstr : *BB) {
+        std::optional<Affine> Value;
+        if (auto* Copy = dyn_cast<IRCopyNode>(IRInstr.get())) {
+          if (const std::string* Src = getName(Copy->ValSrc)) {
+            auto it = affines.find(*Src);
+            if (it != affines.end())
+              Value = it->second;
+          }
+        } else if (auto* Binary = dyn_cast<IRBinaryNode>(IRInstr.get())) {
+          Value = getAffineSum(*Binary);
+        }
+        // a static variable is memory, not a value of the cycle
+        if (!Value || !fitsInt(Value->offset))
+          continue;
+        const ValuePtr& Result = *IRInstr->result();
+        if (DefUseChains::isTracked(Result.get()))
+          affines[*getName(Result)] = *Value;
+      }
+    }
+  }
+
+  std::optional<Affine> getAffineSum(IRBinaryNode& Binary) const {
+    auto lookup = [&](const ValuePtr& val) -> const Affine* {
+      const std::string* Name = getName(val);
+      if (!Name)
+        return nullptr;
+      auto it = affines.find(*Name);
+      return it == affines.end() ? nullptr : &it->second;
+    };
+    auto* ConstL = dyn_cast<IRConstNode>(Binary.valSrcL.get());
+    auto* ConstR = dyn_cast<IRConstNode>(Binary.valSrcR.get());
+    const Affine* L = lookup(Binary.valSrcL);
+    const Affine* R = lookup(Binary.valSrcR);
+    if (Binary.opType == TokenType::PLUS) {
+      if (L && ConstR)
+        return Affine{L->base, L->offset + ConstR->IntVal};
+      if (ConstL && R)
+        return Affine{R->base, R->offset + ConstL->IntVal};
+    } else if (Binary.opType == TokenType::MINUS && L && ConstR) {
+      return Affine{L->base, L->offset - ConstR->IntVal};
+    }
+    return std::nullopt;
+  }
+
+  void findBasicIVs(const Loop& L) {
+    basicIVs.clear();
+    size_t PreheaderId = Preheader->getLabel()->labelId;
+    size_t LatchId = Latch->getLabel()->labelId;
+    for (auto& IRInstr : *L.header) {
+      auto* Phi = dyn_cast<IRPhiNode>(IRInstr.get());
+      if (!Phi || Phi->incoming.size() != 2)
+        continue;
+      const std::string& Name = *getName(Phi->valDest);
+      ValuePtr Init, Next;
+      for (auto& In : Phi->incoming) {
+        if (In.labelId == PreheaderId)
+          Init = In.value;
+        else if (In.labelId == LatchId)
+          Next = In.value;
+      }
+      if (!Init || !Next || !isInvariant(Init, L))
+        continue;
+      const std::string* NextName = getName(Next);
+      auto it = NextName ? affines.find(*NextName) : affines.end();
+      if (it == affines.end() || it->second.base != Name ||
+          it->second.offset == 0)
+        continue;
+      basicIVs[Name] =
+          BasicIV{lookThroughCopy(Init), it->second.offset, {}, 0};
+    }
+  }
+
+  /// @brief before the jump out of the preheader, or at its end if it falls
+  /// into the header
+  DefUseChains::InstrIter getPreheaderInsertPos() const {
+    if (isa<IRBranchNode>(Preheader->back()))
+      return std::prev(Preheader->end());
+    return Preheader->end();
+  }
+
+  /// @return `lhs * rhs`, computed in the preheader unless it folds
+  ValuePtr multiply(const ValuePtr& lhs, const ValuePtr& rhs) {
+    auto* ConstL = dyn_cast<IRConstNode>(lhs.get());
+    auto* ConstR = dyn_cast<IRConstNode>(rhs.get());
+    if (ConstL && ConstR) {
+      long long product = 1LL * ConstL->IntVal * ConstR->IntVal;
+      return std::make_shared<IRConstNode>(
+          static_cast<int>(static_cast<unsigned>(product)));
+    }
+    for (auto* Const : {ConstL, ConstR}) {
+      if (Const && Const->IntVal == 0)
+        return std::make_shared<IRConstNode>(0);
+    }
+    if (ConstL && ConstL->IntVal == 1)
+      return rhs;
+    if (ConstR && ConstR->IntVal == 1)
+      return lhs;
+    ValuePtr Dest = makeVar(IRFunc.createName("iv"));
+    auto* Mul = DU.insert(getPreheaderInsertPos(),
+                          std::make_unique<IRBinaryNode>(TokenType::STAR, lhs,
+                                                         rhs, Dest));
+    blockOf[Mul] = Preheader;
+    return Dest;
+  }
+
+  /// @return the derived induction variable holding `IV * Multiplier` at the
+  /// start of the iteration, and the one holding it for the next iteration
+  const std::pair<std::string, std::string>&
+  getDerivedIV(BasicIV& IV, const ValuePtr& Multiplier, const Loop& L) {
+    auto* Const = dyn_cast<IRConstNode>(Multiplier.get());
+    std::string Key =
+        Const ? std::to_string(Const->IntVal) : *getName(Multiplier);
+    auto it = IV.derived.find(Key);
+    if (it != IV.derived.end())
+      return it->second;
+    if (Const && Const->IntVal != 0 && !IV.constMultiplier)
+      IV.constMultiplier = Const->IntVal;
+
+    ValuePtr Start = multiply(IV.init, Multiplier);
+    ValuePtr Step =
+        multiply(std::make_shared<IRConstNode>(IV.step), Multiplier);
+    std::string Current = IRFunc.createName("iv");
+    std::string Next = IRFunc.createName("iv");
+    IRLabelNode* PreheaderLabel = Preheader->getLabel();
+    IRLabelNode* LatchLabel = Latch->getLabel();
+    auto Phi = std::make_unique<IRPhiNode>(makeVar(Current));
+    Phi->incoming.push_back(
+        {Start, PreheaderLabel->labelName, PreheaderLabel->labelId});
+    Phi->incoming.push_back(
+        {makeVar(Next), LatchLabel->labelName, LatchLabel->labelId});
+    // phis right after the header label, the update after the phis
+    auto Pos = std::next(L.header->begin());
+    blockOf[DU.insert(Pos, std::move(Phi))] = L.header;
+    while (Pos != L.header->end() && isa<IRPhiNode>(Pos->get()))
+      ++Pos;
+    auto Update = std::make_unique<IRBinaryNode>(
+        TokenType::PLUS, makeVar(Current), Step, makeVar(Next));
+    blockOf[DU.insert(Pos, std::move(Update))] = L.header;
+    return IV.derived.emplace(Key, std::make_pair(Current, Next))
+        .first->second;
+  }
+
+  void reduceProduct(IRBinaryNode* Product, const Loop& L) {
+    const Affine* Value = getAffine(Product->valSrcL);
+    ValuePtr Multiplier = Product->valSrcR;
+    if (!Value) {
+      Value = getAffine(Product->valSrcR);
+      Multiplier = Product->valSrcL;
+    }
+    if (!Value || !isInvariant(Multiplier, L))
+      return;
+    Affine Operand = *Value;
+    auto& [Current, Next] =
+        getDerivedIV(basicIVs[Operand.base], Multiplier, L);
+    ValuePtr Dest = Product->valDest;
+    std::unique_ptr<IRInstructionNode> Replacement;
+    if (Operand.offset == 0) {
+      Replacement = std::make_unique<IRCopyNode>(makeVar(Current), Dest);
+    } else {
+      ValuePtr Offset = multiply(
+          std::make_shared<IRConstNode>(Operand.offset), Multiplier);
+      Replacement = std::make_unique<IRBinaryNode>(
+          TokenType::PLUS, makeVar(Current), Offset, Dest);
+    }
+    blockOf[DU.replace(Product, std::move(Replacement))] = blockOf.at(Product);
+    changed = true;
+  }
+
+  /// @brief `i < n` on the back edge becomes `iv < n * k`, if a derived
+  /// `iv = i * k` exists for a constant k
+  void replaceExitTest(const std::string& Name, const BasicIV& IV,
+                       const Loop& L) {
+    auto* Init = dyn_cast<IRConstNode>(IV.init.get());
+    long long k = IV.constMultiplier;
+    auto* Branch = dyn_cast<IRBranchNode>(Latch->back());
+    if (!Init || !k || !Branch || !Branch->isConditional() ||
+        Branch->labelId != L.header->getLabel()->labelId)
+      return;
+    // the comparison is made by the branch, or computed into its condition
+    IRInstructionNode* Compare = Branch;
+    TokenType compareOp;
+    if (auto* JumpIfCmp = dyn_cast<IRJumpIfCmpNode>(Branch)) {
+      compareOp = JumpIfCmp->opType;
+    } else {
+      const std::string* CondName = getName(*Branch->operands().front());
+      auto* Binary =
+          CondName ? dyn_cast<IRBinaryNode>(DU.getDef(*CondName)) : nullptr;
+      if (!Binary || !nanocc::isComparison(Binary->opType) ||
+          !L.contains(blockOf.at(Binary)))
+        return;
+      Compare = Binary;
+      compareOp = Binary->opType;
+    }
+    const ValuePtr& SrcL = *Compare->operands()[0];
+    const ValuePtr& SrcR = *Compare->operands()[1];
+    bool ivOnLeft = getAffine(SrcL) != nullptr;
+    const Affine* Value = ivOnLeft ? getAffine(SrcL) : getAffine(SrcR);
+    ValuePtr Other = lookThroughCopy(ivOnLeft ? SrcR : SrcL);
+    auto* Bound = dyn_cast<IRConstNode>(Other.get());
+    if (!Value || Value->base != Name || !Bound ||
+        (Value->offset != 0 && Value->offset != IV.step))
+      return;
+
+    // stay in the loop while `iv stayOp bound`
+    TokenType stayOp =
+        ivOnLeft ? compareOp : nanocc::getSwappedComparison(compareOp);
+    if (isa<IRJumpIfZeroNode>(Branch))
+      stayOp = nanocc::getNegatedComparison(stayOp);
+    long long first = Init->IntVal + Value->offset;
+    auto Trips = nanocc::getTripCount(stayOp, first, IV.step, Bound->IntVal);
+    if (!Trips)
+      return;
+    long long last = first + (*Trips - 1) * IV.step;
+    for (long long val : {first, last}) {
+      if (!fitsInt(val) || !fitsInt(val * k))
+        return;
+    }
+    if (!fitsInt(Bound->IntVal * k))
+      return;
+
+    auto& [Current, Next] = IV.derived.at(std::to_string(k));
+    ValuePtr Scaled = makeVar(Value->offset == 0 ? Current : Next);
+    ValuePtr ScaledBound = std::make_shared<IRConstNode>(
+        static_cast<int>(Bound->IntVal * k));
+    TokenType opType =
+        k > 0 ? compareOp : nanocc::getSwappedComparison(compareOp);
+    ValuePtr NewL = ivOnLeft ? Scaled : ScaledBound;
+    ValuePtr NewR = ivOnLeft ? ScaledBound : Scaled;
+    std::unique_ptr<IRInstructionNode> Replacement;
+    if (Compare == Branch)
+      Replacement = std::make_unique<IRJumpIfCmpNode>(
+          opType, NewL, NewR, Branch->labelName, Branch->labelId);
+    else
+      Replacement = std::make_unique<IRBinaryNode>(
+          opType, NewL, NewR, cast<IRBinaryNode>(Compare)->valDest);
+    blockOf[DU.replace(Compare, std::move(Replacement))] = blockOf.at(Compare);
+    changed = true;
+  }
+
+  /// @brief Deletes a basic induction variable whose values only feed each
+  /// other. A store to a static variable is a use outside the cycle.
+  void removeIfUnused(const std::string& Name) {
+    std::vector<std::string> Members;
+    for (auto& [Value, A] : affines) {
+      if (A.base == Name)
+        Members.push_back(Value);
+    }
+    for (auto& Member : Members) {
+      for (auto& U : DU.getUses(Member)) {
+        IRValSlot Result = U.user->result();
+        if (!Result || !DefUseChains::isTracked(Result->get()))
+          return;
+        const std::string* UserName = getName(*Result);
+        if ( affines.find(*UserName) == affines.end() ||
+            affines.at(*UserName).base != Name)
+          return;
+      }
+    }
+    for (auto& Member : Members) {
+      if (IRInstructionNode* Def = DU.getDef(Member))
+        DU.erase(Def);
+    }
+    changed = true;
+  }
+};
+} // namespace
+
+namespace nanocc {
+/// @brief Replaces multiplications of induction variables by derived
+/// induction variables, rewrites exit tests to use them and deletes the
+/// induction variables nothing needs anymore.
+/// @return changed if any of that happened
+PassResult InductionVariableStrengthReduction(IRFunctionNode& IRFunc,
+                                              AnalysisManager& AM) {
+  const LoopInfo& LI = AM.getLoopInfo(IRFunc);
+  if (LI.empty())
+    return PassResult::unchanged();
+  insertLoopPreheaders(IRFunc, AM.getCFG(IRFunc), LI);
+  constructSSA(IRFunc);
+  bool changed = IVReducer(IRFunc).run();
+  destructSSA(IRFunc);
+  // nothing is preserved either way, the round trip renames and relabels
+  return {changed, PreservedAnalyses::none()};
+}
+} // namespace nanocc
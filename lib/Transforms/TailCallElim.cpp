@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "nanocc/IR/IR.hpp"
+#include "nanocc/Transforms/LoopUtils.hpp"
+#include "nanocc/Transforms/TailCallElim.hpp"
+#include "nanocc/Utils/Utils.hpp"
+
+/*
+Tail call elimination on the non-SSA instruction list. A call of the function
+to itself whose result is returned right away is the same as starting over
+with the arguments as parameters:
+    fact:                           acc.fact.0 = 1
+                                  tailrecurse.fact.1:
+      ...                             ...
+                                      acc.fact.0 = acc.fact.0 * n.0
+      tmp.3 = fact(tmp.2)     ->      n.0 = tmp.2
+      tmp.4 = n.0 * tmp.3             jump tailrecurse.fact.1
+      return tmp.4                    ...
+      ...                             acc.fact.2 = acc.fact.0 * tmp.5
+      return tmp.5                    return acc.fact.2
+The arguments are computed before any parameter changes, through a fresh
+variable for those reading another parameter. A result the function adds a
+value to or multiplies by before returning it is handled with an accumulator
+holding what the calls eliminated so far still had to do to it: every return
+left hands back its value combined with the accumulator. Both operations are
+associative and commutative under wrapping, the order the factors end up in
+doesn't matter. All accumulating calls must use the same one, calls using the
+other stay. Any other call whose result is returned is marked `tail`, codegen
+can leave the frame and jump to it when it needs no stack arguments.
+A result that gets to a `ret` through copies and jumps, the way an inlined
+body or a `return` in a branch leaves it, is first given a `ret` of its own
+right after the call; what it skipped is left to unreachable code elimination.
+*/
+
+namespace {
+using InstrList = std::list<std::unique_ptr<IRInstructionNode>>;
+
+/// @return true if `val` is the variable `var`, which isn't static
+bool isVariable(const IRValNode* val, const IRValNode* var) {
+  auto* Val = dyn_cast<IRVariableNode>(val);
+  auto* Var = dyn_cast<IRVariableNode>(var);
+  return Val && Var && Val->varName == Var->varName &&
+         !nanocc::hasStaticStorage(*Var);
+}
+
+/// @return true if `it` is a `ret` of `val`
+bool isReturnOf(InstrList::iterator it, const IRValNode* val) {
+  auto* Ret = dyn_cast<IRRetNode>(it->get());
+  return Ret && Ret->retValue && isVariable(Ret->retValue.get(), val);
+}
+
+/// @brief a recursive call and the `ret` of its result, maybe combined with
+/// `Other` by `opType` in between
+struct TailSite {
+  InstrList::iterator Call;
+  InstrList::iterator End; // after the `ret`
+  std::optional<TokenType> opType;
+  std::shared_ptr<IRValNode> Other;
+};
+
+class TailCallEliminator {
+  IRFunctionNode& IRFunc;
+  InstrList& Instructions;
+
+public:
+  explicit TailCallEliminator(IRFunctionNode& IRFunc)
+      : IRFunc(IRFunc), Instructions(IRFunc.IRInstructions) {}
+
+  /// @brief Gives the calls whose result reaches a `ret` only through copies
+  /// and jumps a `ret` of their own right after, and the same for the
+  /// result of `x + t` or `x * t` after a recursive call.
+  /// @return true if a `ret` was added
+  bool duplicateReturns() {
+    std::unordered_map<size_t, InstrList::iterator> Labels;
+    for (auto it = Instructions.begin(); it != Instructions.end(); ++it) {
+      if (auto* Label = dyn_cast<IRLabelNode>(it->get()))
+        Labels[Label->labelId] = it;
+    }
+    bool changed = false;
+    for (auto it = Instructions.begin(); it != Instructions.end(); ++it) {
+      auto* Call = dyn_cast<IRFunctionCallNode>(it->get());
+      if (!Call)
+        continue;
+      bool recursive = Call->funcName == IRFunc.funcName;
+      const IRValNode* Result = Call->returnDest.get();
+      auto Next = std::next(it);
+      if (Next == Instructions.end())
+        continue;
+      auto* Binary = dyn_cast<IRBinaryNode>(Next->get());
+      if (recursive && Binary && isAccumulation(*Binary, Result)) {
+        Next = std::next(Next);
+        Result = Binary->valDest.get();
+      } else if (!recursive && Call->arguments.size() > 6) {
+        continue; // codegen only jumps to callees taking them in registers
+      }
+      if (Next == Instructions.end() || isReturnOf(Next, Result) ||
+          !reachesReturn(Next, Result, Labels))
+        continue;
+      auto* Var = cast<IRVariableNode>(Result);
+      Instructions.insert(Next, std::make_unique<IRRetNode>(
+                                    std::make_shared<IRVariableNode>(
+                                        Var->varName)));
+      changed = true;
+    }
+    return changed;
+  }
+
+  /// @return true if a recursive call was eliminated
+  bool eliminateRecursion() {
+    std::vector<TailSite> Sites;
+    std::optional<TokenType> accOpType;
+    for (auto it = Instructions.begin(); it != Instructions.end(); ++it) {
+      auto Site = getTailSite(it);
+      if (!Site)
+        continue;
+      if (Site->opType && !accOpType)
+        accOpType = Site->opType;
+      if (Site->opType && Site->opType != accOpType)
+        continue;
+      Sites.push_back(*Site);
+    }
+    if (Sites.empty())
+      return false;
+
+    auto Entry = IRFunc.createLabel("tailrecurse");
+    std::shared_ptr<IRValNode> Acc;
+    if (accOpType)
+      Acc = std::make_shared<IRVariableNode>(IRFunc.createName("acc"));
+    for (auto& Site : Sites) {
+      if (Acc)
+        Instructions.insert(
+            Site.Call, std::make_unique<IRBinaryNode>(
+                           *accOpType, nanocc::cloneValue(Acc),
+                           nanocc::cloneValue(Site.Other),
+                           nanocc::cloneValue(Acc)));
+      assignParameters(Site.Call,
+                       cast<IRFunctionCallNode>(Site.Call->get())->arguments);
+      Instructions.insert(Site.Call, std::make_unique<IRJumpNode>(
+                                         Entry->labelName, Entry->labelId));
+      Instructions.erase(Site.Call, Site.End);
+    }
+    if (Acc) {
+      for (auto it = Instructions.begin(); it != Instructions.end(); ++it) {
+        auto* Ret = dyn_cast<IRRetNode>(it->get());
+        if (!Ret || !Ret->retValue)
+          continue;
+        auto Result =
+            std::make_shared<IRVariableNode>(IRFunc.createName("acc"));
+        Instructions.insert(it, std::make_unique<IRBinaryNode>(
+                                    *accOpType, nanocc::cloneValue(Acc),
+                                    std::move(Ret->retValue), Result));
+        Ret->retValue = nanocc::cloneValue(Result);
+      }
+    }
+    Instructions.push_front(std::move(Entry));
+    if (Acc) {
+      // what returning a value unchanged does to it
+      int identity = *accOpType == TokenType::STAR ? 1 : 0;
+      Instructions.push_front(std::make_unique<IRCopyNode>(
+          std::make_shared<IRConstNode>(identity), nanocc::cloneValue(Acc)));
+    }
+    return true;
+  }
+
+  /// @brief Marks the calls whose result is returned right after and that
+  /// pass all arguments in registers `tail`, and unmarks the others.
+  void markTailCalls() {
+    for (auto it = Instructions.begin(); it != Instructions.end(); ++it) {
+      auto* Call = dyn_cast<IRFunctionCallNode>(it->get());
+      if (!Call)
+        continue;
+      auto Next = std::next(it);
+      // six arguments go in registers
+      Call->tail = Next != Instructions.end() && Call->arguments.size() <= 6 &&
+                   isReturnOf(Next, Call->returnDest.get());
+    }
+  }
+
+private:
+  /// @return true if `Binary` is `x + t` or `x * t` with `x` not `t` and
+  /// not static, the call that set `t` may have changed a static variable
+  bool isAccumulation(const IRBinaryNode& Binary, const IRValNode* t) {
+    if (Binary.opType != TokenType::PLUS && Binary.opType != TokenType::STAR)
+      return false;
+    const IRValNode* Other = nullptr;
+    if (isVariable(Binary.valSrcL.get(), t))
+      Other = Binary.valSrcR.get();
+    else if (isVariable(Binary.valSrcR.get(), t))
+      Other = Binary.valSrcL.get();
+    return Other && !isVariable(Other, t) && !nanocc::hasStaticStorage(*Other);
+  }
+
+  /// @return true if control goes from `it` to a `ret` of `val` through
+  /// nothing but labels, jumps and copies of it to other local variables
+  bool reachesReturn(
+      InstrList::iterator it, const IRValNode* val,
+      const std::unordered_map<size_t, InstrList::iterator>& Labels) {
+    auto* Var = dyn_cast<IRVariableNode>(val);
+    if (!Var || nanocc::hasStaticStorage(*Var))
+      return false;
+    std::string varName = Var->varName;
+    // a loop of jumps never gets anywhere
+    for (size_t steps = 0; steps < Instructions.size(); steps++) {
+      if (it == Instructions.end())
+        return false;
+      IRInstructionNode* IRInstr = it->get();
+      if (auto* Ret = dyn_cast<IRRetNode>(IRInstr)) {
+        auto* Returned = dyn_cast<IRVariableNode>(Ret->retValue.get());
+        return Returned && Returned->varName == varName;
+      }
+      if (auto* Jump = dyn_cast<IRJumpNode>(IRInstr)) {
+        it = Labels.at(Jump->labelId);
+        continue;
+      }
+      if (auto* Copy = dyn_cast<IRCopyNode>(IRInstr)) {
+        auto* Src = dyn_cast<IRVariableNode>(Copy->ValSrc.get());
+        auto* Dest = cast<IRVariableNode>(Copy->ValDest.get());
+        if (!Src || Src->varName != varName ||
+            nanocc::hasStaticStorage(*Dest))
+          return false;
+        varName = Dest->varName;
+      } else if (!isa<IRLabelNode>(IRInstr)) {
+        return false;
+      }
+      ++it;
+    }
+    return false;
+  }
+
+  std::optional<TailSite> getTailSite(InstrList::iterator it) {
+    auto* Call = dyn_cast<IRFunctionCallNode>(it->get());
+    if (!Call || Call->funcName != IRFunc.funcName ||
+        Call->arguments.size() != IRFunc.parameters.size())
+      return std::nullopt;
+    const IRValNode* Result = Call->returnDest.get();
+    auto Next = std::next(it);
+    if (Next == Instructions.end())
+      return std::nullopt;
+    if (isReturnOf(Next, Result))
+      return TailSite{it, std::next(Next), std::nullopt, nullptr};
+
+    // `r = x op t; ret r`
+    auto* Binary = dyn_cast<IRBinaryNode>(Next->get());
+    auto After = std::next(Next);
+    if (!Binary || After == Instructions.end() ||
+        !isAccumulation(*Binary, Result) ||
+        !isReturnOf(After, Binary->valDest.get()))
+      return std::nullopt;
+    auto Other = isVariable(Binary->valSrcL.get(), Result) ? Binary->valSrcR
+                                                          : Binary->valSrcL;
+    return TailSite{it, std::next(After), Binary->opType, Other};
+  }
+
+  /// @brief Copies `Args` into the parameters in front of `Pos`, arguments
+  /// reading a parameter that may be overwritten go through a fresh variable.
+  void assignParameters(InstrList::iterator Pos,
+                        const std::vector<std::shared_ptr<IRValNode>>& Args) {
+    auto& Params = IRFunc.parameters;
+    auto isParameter = [&](const IRValNode* val) {
+      auto* Var = dyn_cast<IRVariableNode>(val);
+      return Var && std::find(Params.begin(), Params.end(), Var->varName) !=
+                        Params.end();
+    };
+    std::vector<std::shared_ptr<IRValNode>> Values;
+    for (size_t i = 0; i < Args.size(); i++) {
+      auto* Var = dyn_cast<IRVariableNode>(Args[i].get());
+      if (!isParameter(Args[i].get()) || Var->varName == Params[i]) {
+        Values.push_back(nanocc::cloneValue(Args[i]));
+        continue;
+      }
+      auto Temp =
+          std::make_shared<IRVariableNode>(IRFunc.createName("tailrecurse"));
+      Instructions.insert(Pos, std::make_unique<IRCopyNode>(
+                                   nanocc::cloneValue(Args[i]), Temp));
+      Values.push_back(nanocc::cloneValue(Temp));
+    }
+    for (size_t i = 0; i < Args.size(); i++) {
+      auto* Var = dyn_cast<IRVariableNode>(Values[i].get());
+      if (Var && Var->varName == Params[i])
+        continue; // passed on unchanged
+      auto Param = std::make_shared<IRVariableNode>(Params[i]);
+      Instructions.insert(Pos, std::make_unique<IRCopyNode>(
+                                   std::move(Values[i]), std::move(Param)));
+    }
+  }
+};
+} // namespace
+
+namespace nanocc {
+/// @return changed if a recursive call became a jump; marking calls `tail`
+/// doesn't count, no other pass looks at it
+PassResult TailCallElimination(IRFunctionNode& IRFunc, AnalysisManager&) {
+  if (IRFunc.inSSAForm)
+    return PassResult::unchanged();
+  TailCallEliminator Eliminator(IRFunc);
+  bool changed = Eliminator.duplicateReturns();
+  changed |= Eliminator.eliminateRecursion();
+  Eliminator.markTailCalls();
+  return changed ? PassResult::modified() : PassResult::unchanged();
+}
+} // namespace nanocc
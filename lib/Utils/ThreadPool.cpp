@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <exception>
+#include <thread>
+
+#include "nanocc/Utils/ThreadPool.hpp"
+
+ThreadPool::ThreadPool(unsigned numThreads) : numThreads(numThreads) {
+  if (this->numThreads == 0)
+    this->numThreads = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned i = 0; i < this->numThreads; i++) {
+    queues.push_back(std::make_unique<WorkQueue>());
+  }
+}
+
+bool ThreadPool::popOwn(unsigned worker, size_t& task) {
+  auto& Queue = *queues[worker];
+  std::lock_guard<std::mutex> guard(Queue.lock);
+  if (Queue.tasks.empty())
+    return false;
+  task = Queue.tasks.front();
+  Queue.tasks.pop_front();
+  return true;
+}
+
+// victims in a fixed order starting after the thief, so thieves spread out
+bool ThreadPool::steal(unsigned thief, size_t& task) {
+  for (unsigned i = 1; i < numThreads; i++) {
+    auto& Queue = *queues[(thief + i) % numThreads];
+    std::lock_guard<std::mutex> guard(Queue.lock);
+    if (Queue.tasks.empty())
+      continue;
+    task = Queue.tasks.back();
+    Queue.tasks.pop_back();
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::work(unsigned worker, const std::function<void(size_t)>& body,
+                      std::exception_ptr& error, std::mutex& errorLock) {
+  size_t task;
+  while (popOwn(worker, task) || steal(worker, task)) {
+    try {
+      body(task);
+    } catch (...) {
+      std::lock_guard<std::mutex> guard(errorLock);
+      if (!error)
+        error = std::current_exception();
+    }
+  }
+}
+
+void ThreadPool::parallelFor(size_t n,
+                             const std::function<void(size_t)>& body) {
+  // no threads for a single worker or a single task
+  if (numThreads == 1 || n <= 1) {
+    for (size_t i = 0; i < n; i++) {
+      body(i);
+    }
+    return;
+  }
+
+  for (unsigned w = 0; w < numThreads; w++) {
+    size_t begin = n * w / numThreads, end = n * (w + 1) / numThreads;
+    for (size_t i = begin; i < end; i++) {
+      queues[w]->tasks.push_back(i);
+    }
+  }
+
+  std::exception_ptr error;
+  std::mutex errorLock;
+  {
+    std::vector<std::jthread> workers;
+    for (unsigned w = 1; w < numThreads; w++) {
+      workers.emplace_back([&, w] { work(w, body, error, errorLock); });
+    }
+    work(0, body, error, errorLock);
+  } // joins the workers
+  if (error)
+    std::rethrow_exception(error);
+}
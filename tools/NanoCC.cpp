@@ -33,17 +33,9 @@ inline nanocc::OptFlags parseDevFlags(int argc, char* argv[], bool& debug) {
   nanocc::OptFlags optFlags;
   for (int i = 5; i < argc; i++) {
     std::string flag = argv[i];
-    if (flag == "-fopt-constfold") {
-      optFlags.optPasses.insert(nanocc::OptPass::ConstantFolding);
-    } else if (flag == "-fopt-unreach") {
-      optFlags.optPasses.insert(nanocc::OptPass::UnreachableCodeElim);
-    } else if (flag == "-fopt-copyprop") {
-      optFlags.optPasses.insert(nanocc::OptPass::CopyPropagation);
-    } else if (flag == "-fopt-dse") {
-      optFlags.optPasses.insert(nanocc::OptPass::DeadStoreElim);
-    } else if (flag == "-fdump") {
+    if (flag == "-fdump") {
       debug = true;
-    } else {
+    } else if (!nanocc::parseOptFlag(flag, optFlags)) {
       std::println("Warning: Unrecognized optimization flag '{}'", flag);
     }
   }
@@ -53,7 +45,11 @@ inline nanocc::OptFlags parseDevFlags(int argc, char* argv[], bool& debug) {
 // takes in only .c files and produces .s files
 // ./nanocc -S <filename>.c -o <asm_output_file>.s
 // ./nanocc -S <filename>.c -o <asm_output_file>.s -fopt-constfold
-// -fopt-copyprop -fopt-dse -fopt-unreach -fdump
+// -fopt-copyprop -fopt-dse -fopt-unreach -fopt-ssa -fopt-sccp -fopt-gvn
+// -fopt-instcombine -fopt-licm -fopt-unswitch -fopt-ivsr -fopt-unroll
+// -fopt-ifconvert -fopt-inline -fopt-tailcall -fopt-globaldce -fopt-budget=N
+// -fopt-threads=N -fopt-unroll-factor=N
+// -fdump
 int main(int argc, char* argv[]) {
   assert(std::string(argv[1]) == "-S" && std::string(argv[3]) == "-o" &&
          "Usage: ./nanocc -S <source_file.c> -o <asm_output_file.s> "
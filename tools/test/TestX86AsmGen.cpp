@@ -11,16 +11,7 @@
 static nanocc::OptFlags parseOptFlags(int argc, char* argv[]) {
   nanocc::OptFlags opt_flags;
   for (int i = 1; i < argc; i++) {
-    std::string flag = argv[i];
-    if (flag == "-fopt-constfold") {
-      opt_flags.optPasses.insert(nanocc::OptPass::ConstantFolding);
-    } else if (flag == "-fopt-unreach") {
-      opt_flags.optPasses.insert(nanocc::OptPass::UnreachableCodeElim);
-    } else if (flag == "-fopt-copyprop") {
-      opt_flags.optPasses.insert(nanocc::OptPass::CopyPropagation);
-    } else if (flag == "-fopt-dse") {
-      opt_flags.optPasses.insert(nanocc::OptPass::DeadStoreElim);
-    }
+    nanocc::parseOptFlag(argv[i], opt_flags);
   }
   return opt_flags;
 }